@@ -1124,6 +1124,20 @@ __do_page_fault(struct pt_regs *regs, unsigned long error_code)
 	if (error_code & PF_WRITE)
 		flags |= FAULT_FLAG_WRITE;
 
+	/*
+	 * Try to resolve a user fault without mmap_sem first, so that it
+	 * does not queue up behind an mmap() or munmap() in another thread.
+	 */
+	if (error_code & PF_USER) {
+		fault = handle_speculative_fault(mm, address, flags);
+		if (!(fault & VM_FAULT_RETRY)) {
+			tsk->min_flt++;
+			perf_sw_event(PERF_COUNT_SW_PAGE_FAULTS_MIN, 1,
+				      regs, address);
+			return;
+		}
+	}
+
 	/*
 	 * When running in the kernel we expect faults to occur only to
 	 * addresses in user space.  All other faults represent errors in
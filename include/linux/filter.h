@@ -19,6 +19,73 @@ struct compat_sock_fprog {
 };
 #endif
 
+/*
+ * Internal BPF: the instruction set socket and seccomp filters are
+ * translated into by sk_convert_filter() before they run in the
+ * interpreter.  It has ten 64-bit registers plus a read-only frame
+ * pointer, and function calls:
+ *
+ *   R0	   - return value of calls and of the program, classic A
+ *   R1-R5 - arguments to calls, clobbered by them
+ *   R6-R9 - preserved across calls: R6 holds the context, R7 classic X
+ *   R10   - frame pointer to MAX_BPF_STACK bytes of stack, where the
+ *	     classic scratch memory lives
+ *
+ * Internal programs are only ever generated by the kernel, from checked
+ * classic programs, so there is no verifier.
+ */
+
+/* Instruction classes */
+#define BPF_ALU64	0x07	/* ALU in 64-bit width */
+
+/* ld/ldx fields */
+#define BPF_DW		0x18	/* double word */
+#define BPF_XADD	0xc0	/* atomic add */
+
+/* alu/jmp fields */
+#define BPF_MOV		0xb0	/* mov reg to reg */
+#define BPF_ARSH	0xc0	/* sign extending arithmetic shift right */
+
+/* change endianness of a register */
+#define BPF_END		0xd0	/* flags for endianness conversion: */
+#define BPF_TO_LE	0x00	/* convert to little-endian */
+#define BPF_TO_BE	0x08	/* convert to big-endian */
+#define BPF_FROM_LE	BPF_TO_LE
+#define BPF_FROM_BE	BPF_TO_BE
+
+#define BPF_JNE		0x50	/* jump != */
+#define BPF_JSGT	0x60	/* signed '>' */
+#define BPF_JSGE	0x70	/* signed '>=' */
+#define BPF_CALL	0x80	/* function call */
+#define BPF_EXIT	0x90	/* function return */
+
+/* Registers */
+enum {
+	BPF_REG_0 = 0,
+	BPF_REG_1,
+	BPF_REG_2,
+	BPF_REG_3,
+	BPF_REG_4,
+	BPF_REG_5,
+	BPF_REG_6,
+	BPF_REG_7,
+	BPF_REG_8,
+	BPF_REG_9,
+	BPF_REG_10,
+	__MAX_BPF_REG,
+};
+
+#define MAX_BPF_REG	__MAX_BPF_REG
+#define MAX_BPF_STACK	512
+
+struct sock_filter_int {
+	__u8	code;		/* opcode */
+	__u8	a_reg:4;	/* dest register */
+	__u8	x_reg:4;	/* source register */
+	__s16	off;		/* signed offset */
+	__s32	imm;		/* signed immediate constant */
+};
+
 struct sk_buff;
 struct sock;
 
@@ -26,6 +93,8 @@ struct sk_filter
 {
 	atomic_t		refcnt;
 	unsigned int         	len;	/* Number of filter blocks */
+	/* internal translation run instead of insns, if not JITed */
+	struct sock_filter_int	*insnsi;
 	struct rcu_head		rcu;
 	unsigned int		(*bpf_func)(const struct sk_buff *skb,
 					    const struct sock_filter *filter);
@@ -44,10 +113,18 @@ static inline unsigned int sk_filter_size(unsigned int proglen)
 extern int sk_filter(struct sock *sk, struct sk_buff *skb);
 extern unsigned int sk_run_filter(const struct sk_buff *skb,
 				  const struct sock_filter *filter);
+extern unsigned int sk_run_filter_int(void *ctx,
+				      const struct sock_filter_int *insn);
+extern int sk_convert_filter(struct sock_filter *prog, int len,
+			     struct sock_filter_int *new_prog, int *new_len);
+extern struct sock_filter_int *sk_convert_filter_alloc(struct sock_filter *prog,
+							int len);
 extern int sk_unattached_filter_create(struct sk_filter **pfp,
 				       struct sock_fprog *fprog);
 extern void sk_unattached_filter_destroy(struct sk_filter *fp);
 extern int sk_attach_filter(struct sock_fprog *fprog, struct sock *sk);
+extern int sk_reuseport_attach_filter(struct sock_fprog *fprog,
+				      struct sock *sk);
 extern int sk_detach_filter(struct sock *sk);
 extern int sk_chk_filter(struct sock_filter *filter, unsigned int flen);
 extern int sk_get_filter(struct sock *sk, struct sock_filter __user *filter, unsigned len);
@@ -70,7 +147,6 @@ static inline void bpf_jit_dump(unsigned int flen, unsigned int proglen,
 		print_hex_dump(KERN_ERR, "JIT code: ", DUMP_PREFIX_OFFSET,
 			       16, 1, image, proglen, false);
 }
-#define SK_RUN_FILTER(FILTER, SKB) (*FILTER->bpf_func)(SKB, FILTER->insns)
 #else
 #include <linux/slab.h>
 static inline void bpf_jit_compile(struct sk_filter *fp)
@@ -80,9 +156,14 @@ static inline void bpf_jit_free(struct sk_filter *fp)
 {
 	kfree(fp);
 }
-#define SK_RUN_FILTER(FILTER, SKB) sk_run_filter(SKB, FILTER->insns)
 #endif
 
+/*
+ * bpf_func is the JIT image, the internal interpreter or, if the
+ * program could not be translated, sk_run_filter().
+ */
+#define SK_RUN_FILTER(FILTER, SKB) (*FILTER->bpf_func)(SKB, FILTER->insns)
+
 static inline int bpf_tell_extensions(void)
 {
 	return SKF_AD_MAX;
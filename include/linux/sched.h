@@ -449,6 +449,9 @@ static inline int get_dumpable(struct mm_struct *mm)
 #define MMF_HAS_UPROBES		19	/* has uprobes */
 #define MMF_RECALC_UPROBES	20	/* MMF_HAS_UPROBES can be wrong */
 
+#define MMF_FUTEX_PRIVATE_HASH	21	/* private futexes use mm->futex_hash */
+#define MMF_FUTEX_GLOBAL_HASH	22	/* private futexes used the global hash */
+
 #define MMF_INIT_MASK		(MMF_DUMPABLE_MASK | MMF_DUMP_FILTER_MASK)
 
 struct sighand_struct {
@@ -194,6 +194,18 @@ extern void set_timer_slack(struct timer_list *time, int slack_hz);
  */
 extern unsigned long get_next_timer_interrupt(unsigned long now);
 
+/*
+ * Per-CPU statistics of the timer softirq, shown in /proc/timer_list:
+ */
+struct timer_wheel_stats {
+	unsigned long	nr_runs;	/* softirq runs that processed the wheel */
+	unsigned long	nr_expired;	/* timer functions called */
+	u64		run_time;	/* total time spent, in ns */
+	u64		max_run_time;	/* longest single run, in ns */
+};
+
+extern void timer_wheel_get_stats(int cpu, struct timer_wheel_stats *stats);
+
 /*
  * Timer-statistics info:
  */
@@ -295,7 +295,7 @@ void fib_select_multipath(struct fib_result *res);
 
 /* Exported by fib_trie.c */
 void fib_trie_init(void);
-struct fib_table *fib_trie_table(u32 id);
+struct fib_table *fib_trie_table(struct net *net, u32 id);
 
 static inline void fib_combine_itag(u32 *itag, const struct fib_result *res)
 {
@@ -0,0 +1,33 @@
+#ifndef _SOCK_REUSEPORT_H
+#define _SOCK_REUSEPORT_H
+
+#include <linux/filter.h>
+#include <linux/skbuff.h>
+#include <linux/types.h>
+#include <net/sock.h>
+
+/*
+ * A reuseport group is the set of sockets bound to the same address and
+ * port with SO_REUSEPORT. It is shared by all of its members through
+ * sk->sk_reuseport_cb, and optionally carries a classic BPF program
+ * (SO_ATTACH_REUSEPORT_CBPF) whose return value is the index of the
+ * socket that should receive the packet.
+ */
+struct sock_reuseport {
+	struct rcu_head		rcu;
+
+	u16			max_socks;	/* length of socks */
+	u16			num_socks;	/* elements in socks */
+	struct sk_filter __rcu	*prog;		/* optional BPF sock selector */
+	struct sock		*socks[0];	/* array of sock pointers */
+};
+
+extern int reuseport_alloc(struct sock *sk);
+extern int reuseport_add_sock(struct sock *sk, struct sock *sk2);
+extern void reuseport_detach_sock(struct sock *sk);
+extern struct sock *reuseport_select_sock(struct sock *sk, u32 hash,
+					  struct sk_buff *skb, int hdr_len);
+extern struct sk_filter *reuseport_attach_prog(struct sock *sk,
+					       struct sk_filter *prog);
+
+#endif  /* _SOCK_REUSEPORT_H */
@@ -149,4 +149,15 @@
 
 #define PR_GET_TID_ADDRESS	40
 
+/*
+ * Give PROCESS_PRIVATE futexes a hash table of their own instead of the
+ * system-wide one.  arg2 is the number of buckets, a power of two, or 0
+ * to size it from the number of threads and CPUs when it is allocated
+ * on the first futex operation.  Must be done before the process makes
+ * its first private futex call.  PR_GET_FUTEX_HASH returns the number of
+ * buckets in use, or 0 while the global hash is used.
+ */
+#define PR_SET_FUTEX_HASH	41
+#define PR_GET_FUTEX_HASH	42
+
 #endif /* _LINUX_PRCTL_H */
@@ -0,0 +1,43 @@
+#ifndef _UAPI_TRACE_MMAP_H_
+#define _UAPI_TRACE_MMAP_H_
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+/*
+ * Memory mapped per cpu ring buffer, see per_cpu/cpuN/trace_pipe_raw.
+ *
+ * The first page of the mapping is the meta page described below, it is
+ * followed by nr_subbufs sub-buffers of subbuf_size bytes each. A
+ * sub-buffer has the layout given in events/header_page: a time stamp,
+ * a commit field and the event data.
+ *
+ * The consumer calls TRACE_MMAP_IOCTL_GET_READER to be handed the next
+ * chunk of data. The events are then in sub-buffer reader.id, from
+ * offset reader.read to reader.commit of the data area. The chunk is
+ * consumed from the kernel point of view and stays untouched by the
+ * writer until the next TRACE_MMAP_IOCTL_GET_READER.
+ */
+struct trace_buffer_meta {
+	__u32		meta_page_size;
+	__u32		meta_struct_len;
+
+	__u32		subbuf_size;
+	__u32		nr_subbufs;
+
+	struct {
+		__u64	lost_events;	/* overwritten before this chunk */
+		__u32	id;
+		__u32	read;
+		__u32	commit;
+		__u32	__reserved;
+	} reader;
+
+	__u64		entries;
+	__u64		overrun;
+	__u64		read;
+};
+
+#define TRACE_MMAP_IOCTL_GET_READER	_IO('R', 0x20)
+
+#endif /* _UAPI_TRACE_MMAP_H_ */
@@ -242,6 +242,23 @@ static unsigned long __read_mostly futex_hashsize;
 
 static struct futex_hash_bucket *futex_queues;
 
+/*
+ * A process that opted in with PR_SET_FUTEX_HASH hashes its
+ * PROCESS_PRIVATE futexes into a table of its own, allocated on the
+ * node of the thread that makes the first futex call, so it neither
+ * collides with other processes in futex_queues nor bounces buckets
+ * across nodes.  Shared futexes always use futex_queues, since their
+ * keys are not tied to one mm.
+ *
+ * The table is never resized or freed while the mm can still have
+ * futex keys: every private key holds a reference on mm_count, and the
+ * table is freed from __mmdrop().
+ */
+struct futex_private_hash {
+	unsigned long mask;
+	struct futex_hash_bucket queues[0];
+};
+
 static inline void futex_get_mm(union futex_key *key)
 {
 	atomic_inc(&key->private.mm->mm_count);
@@ -280,9 +297,123 @@ static struct futex_hash_bucket *hash_futex(union futex_key *key)
 	u32 hash = jhash2((u32*)&key->both.word,
 			  (sizeof(key->both.word)+sizeof(key->both.ptr))/4,
 			  key->both.offset);
+
+	if (!(key->both.offset & (FUT_OFF_INODE|FUT_OFF_MMSHARED))) {
+		struct futex_private_hash *fph;
+
+		fph = ACCESS_ONCE(key->private.mm->futex_hash);
+		if (fph)
+			return &fph->queues[hash & fph->mask];
+	}
 	return &futex_queues[hash & (futex_hashsize - 1)];
 }
 
+static int futex_private_hash_alloc(struct mm_struct *mm)
+{
+	struct futex_private_hash *fph;
+	unsigned long slots, i;
+
+	slots = mm->futex_hash_slots;
+	if (!slots) {
+		/*
+		 * The table cannot grow later, so size it for the larger
+		 * of the threads already running and the CPUs they could
+		 * run on.
+		 */
+		slots = max_t(unsigned long, current->signal->nr_threads,
+			      num_online_cpus());
+		slots = roundup_pow_of_two(4 * slots);
+		slots = clamp(slots, 16UL, futex_hashsize);
+	}
+
+	fph = kzalloc_node(sizeof(*fph) + slots * sizeof(fph->queues[0]),
+			   GFP_KERNEL, numa_node_id());
+	if (!fph)
+		return -ENOMEM;
+
+	fph->mask = slots - 1;
+	for (i = 0; i < slots; i++) {
+		plist_head_init(&fph->queues[i].chain);
+		spin_lock_init(&fph->queues[i].lock);
+	}
+
+	/* Another thread may have beaten us to it. */
+	if (cmpxchg(&mm->futex_hash, NULL, fph))
+		kfree(fph);
+	return 0;
+}
+
+/*
+ * Decide once per mm which hash its private futexes use.  Once a
+ * private futex has gone through futex_queues, PR_SET_FUTEX_HASH is
+ * refused, and once it succeeded the private table is allocated before
+ * any key is hashed, so waiters and wakers always agree on the table.
+ * Both bits are only set under mmap_sem.
+ */
+static int futex_private_hash_prepare(struct mm_struct *mm)
+{
+	int ret = 0;
+
+	if (likely(ACCESS_ONCE(mm->futex_hash) ||
+		   test_bit(MMF_FUTEX_GLOBAL_HASH, &mm->flags)))
+		return 0;
+
+	down_read(&mm->mmap_sem);
+	if (!test_bit(MMF_FUTEX_PRIVATE_HASH, &mm->flags))
+		set_bit(MMF_FUTEX_GLOBAL_HASH, &mm->flags);
+	up_read(&mm->mmap_sem);
+
+	if (test_bit(MMF_FUTEX_PRIVATE_HASH, &mm->flags))
+		ret = futex_private_hash_alloc(mm);
+	return ret;
+}
+
+/**
+ * futex_hash_set_slots - opt in to a process-private futex hash
+ * @slots:	number of buckets, or 0 to size the table when it is
+ *		allocated on the first private futex operation
+ *
+ * Implements PR_SET_FUTEX_HASH.  Returns -EBUSY if the process already
+ * made a private futex call or opted in before.
+ */
+int futex_hash_set_slots(unsigned long slots)
+{
+	struct mm_struct *mm = current->mm;
+	int ret = 0;
+
+	if (slots && (!is_power_of_2(slots) || slots < 2 ||
+		      slots > futex_hashsize))
+		return -EINVAL;
+
+	down_write(&mm->mmap_sem);
+	if (test_bit(MMF_FUTEX_GLOBAL_HASH, &mm->flags) ||
+	    test_bit(MMF_FUTEX_PRIVATE_HASH, &mm->flags)) {
+		ret = -EBUSY;
+	} else {
+		mm->futex_hash_slots = slots;
+		set_bit(MMF_FUTEX_PRIVATE_HASH, &mm->flags);
+	}
+	up_write(&mm->mmap_sem);
+
+	return ret;
+}
+
+/*
+ * Implements PR_GET_FUTEX_HASH: the number of buckets of the private
+ * hash, or 0 while private futexes are hashed into futex_queues.
+ */
+int futex_hash_get_slots(void)
+{
+	struct futex_private_hash *fph = ACCESS_ONCE(current->mm->futex_hash);
+
+	return fph ? fph->mask + 1 : 0;
+}
+
+void futex_hash_free(struct mm_struct *mm)
+{
+	kfree(mm->futex_hash);
+}
+
 /*
  * Return 1 if two futex_keys are equal, 0 otherwise.
  */
@@ -381,6 +512,10 @@ get_futex_key(u32 __user *uaddr, int fshared, union futex_key *key, int rw)
 	 *        but access_ok() should be faster than find_vma()
 	 */
 	if (!fshared) {
+		err = futex_private_hash_prepare(mm);
+		if (unlikely(err))
+			return err;
+
 		key->private.mm = mm;
 		key->private.address = address;
 		get_futex_key_refs(key);  /* implies MB (B) */
@@ -0,0 +1,705 @@
+/*
+ * Module-based torture test facility for locking
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * Writer threads (and, for the locks that have a shared mode, reader
+ * threads) hammer a single lock of the selected type, checking that
+ * mutual exclusion holds and recording per-thread acquisition counts
+ * and the longest time each thread waited for the lock.  The periodic
+ * and end-of-test statistics give the acquisition rate, the spread
+ * between the most and least successful thread, and the worst wait,
+ * so that changes to the lock implementations can be compared for
+ * throughput and fairness under contention.
+ *
+ * Based on kernel/rcu/torture.c.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/kthread.h>
+#include <linux/err.h>
+#include <linux/spinlock.h>
+#include <linux/rwlock.h>
+#include <linux/mutex.h>
+#include <linux/rwsem.h>
+#include <linux/smp.h>
+#include <linux/interrupt.h>
+#include <linux/sched.h>
+#include <linux/atomic.h>
+#include <linux/moduleparam.h>
+#include <linux/notifier.h>
+#include <linux/reboot.h>
+#include <linux/delay.h>
+#include <linux/random.h>
+#include <linux/slab.h>
+
+MODULE_LICENSE("GPL");
+
+MODULE_ALIAS("locktorture");
+#ifdef MODULE_PARAM_PREFIX
+#undef MODULE_PARAM_PREFIX
+#endif
+#define MODULE_PARAM_PREFIX "locktorture."
+
+static int long_hold_ms = 100;
+module_param(long_hold_ms, int, 0444);
+MODULE_PARM_DESC(long_hold_ms, "Occasional long hold time of sleeping locks (ms), 0 to disable");
+static int long_hold_us = 100;
+module_param(long_hold_us, int, 0444);
+MODULE_PARM_DESC(long_hold_us, "Occasional long hold time of spinning locks (us, at most 1000), 0 to disable");
+static int nreaders_stress = -1;
+module_param(nreaders_stress, int, 0444);
+MODULE_PARM_DESC(nreaders_stress, "Number of read-locking stress-test threads");
+static int nwriters_stress = -1;
+module_param(nwriters_stress, int, 0444);
+MODULE_PARM_DESC(nwriters_stress, "Number of write-locking stress-test threads");
+static int short_hold_us = 1;
+module_param(short_hold_us, int, 0444);
+MODULE_PARM_DESC(short_hold_us, "Hold time of every acquisition (us), 0 to disable");
+static int stat_interval = 60;
+module_param(stat_interval, int, 0644);
+MODULE_PARM_DESC(stat_interval, "Number of seconds between stats printk()s");
+static char *torture_type = "spin_lock";
+module_param(torture_type, charp, 0444);
+MODULE_PARM_DESC(torture_type,
+		 "Type of lock to torture (spin_lock, spin_lock_irq, rw_lock, rw_lock_irq, mutex_lock, rwsem_lock)");
+static bool verbose;
+module_param(verbose, bool, 0444);
+MODULE_PARM_DESC(verbose, "Enable verbose debugging printk()s");
+
+#define TORTURE_FLAG "-torture:"
+#define PRINTK_STRING(s) \
+	do { pr_alert("%s" TORTURE_FLAG s "\n", torture_type); } while (0)
+#define VERBOSE_PRINTK_STRING(s) \
+	do { if (verbose) pr_alert("%s" TORTURE_FLAG s "\n", torture_type); } while (0)
+#define VERBOSE_PRINTK_ERRSTRING(s) \
+	do { if (verbose) pr_alert("%s" TORTURE_FLAG "!!! " s "\n", torture_type); } while (0)
+
+static int nrealreaders_stress;
+static int nrealwriters_stress;
+static struct task_struct **reader_tasks;
+static struct task_struct **writer_tasks;
+static struct task_struct *stats_task;
+static unsigned long start_jiffies;
+
+/* Set while a writer holds the lock, count of readers holding it. */
+static bool lock_is_write_held;
+static atomic_t lock_is_read_held;
+
+struct lock_stress_stats {
+	long n_lock_fail;	/* Mutual exclusion violations seen. */
+	long n_lock_acquired;
+	u64 max_wait;		/* Longest wait for the lock, in ns. */
+};
+static struct lock_stress_stats *lwsa;	/* Writer statistics. */
+static struct lock_stress_stats *lrsa;	/* Reader statistics. */
+
+/* Mediate rmmod and system shutdown.  Concurrent rmmod & shutdown illegal! */
+
+#define FULLSTOP_DONTSTOP 0	/* Normal operation. */
+#define FULLSTOP_SHUTDOWN 1	/* System shutdown with locktorture running. */
+#define FULLSTOP_RMMOD    2	/* Normal rmmod of locktorture. */
+static int fullstop = FULLSTOP_RMMOD;
+/*
+ * Protect fullstop transitions and spawning of kthreads.
+ */
+static DEFINE_MUTEX(fullstop_mutex);
+
+/*
+ * Detect and respond to a system shutdown.
+ */
+static int
+locktorture_shutdown_notify(struct notifier_block *unused1,
+			    unsigned long unused2, void *unused3)
+{
+	mutex_lock(&fullstop_mutex);
+	if (fullstop == FULLSTOP_DONTSTOP)
+		fullstop = FULLSTOP_SHUTDOWN;
+	else
+		pr_warn(/* but going down anyway, so... */
+		       "Concurrent 'rmmod locktorture' and shutdown illegal!\n");
+	mutex_unlock(&fullstop_mutex);
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block locktorture_shutdown_nb = {
+	.notifier_call = locktorture_shutdown_notify,
+};
+
+/*
+ * Absorb kthreads into a kernel function that won't return, so that
+ * they won't ever access module text or data again.
+ */
+static void locktorture_shutdown_absorb(const char *title)
+{
+	if (ACCESS_ONCE(fullstop) == FULLSTOP_SHUTDOWN) {
+		pr_notice(
+		       "locktorture thread %s parking due to system shutdown\n",
+		       title);
+		schedule_timeout_uninterruptible(MAX_SCHEDULE_TIMEOUT);
+	}
+}
+
+/*
+ * Operations vector for selecting different types of locks.  The
+ * read-side operations are NULL for locks without a shared mode.
+ */
+struct lock_torture_ops {
+	void (*writelock)(void);
+	void (*writeunlock)(void);
+	void (*readlock)(void);
+	void (*readunlock)(void);
+	void (*delay)(void);
+	const char *name;
+};
+
+static struct lock_torture_ops *cur_ops;
+
+/*
+ * Hold the lock for short_hold_us on every acquisition and, about once
+ * per 2000 acquisitions per thread, for a long hold so that the other
+ * threads pile up behind it.
+ */
+static bool torture_long_hold(void)
+{
+	int nthreads = nrealwriters_stress + nrealreaders_stress;
+
+	return !(prandom_u32() % (nthreads * 2000));
+}
+
+/*
+ * Spinning locks may be held with interrupts off: keep their long hold
+ * short enough not to set off the soft lockup and RCU stall detectors.
+ */
+static void torture_spin_lock_delay(void)
+{
+	if (long_hold_us && torture_long_hold())
+		udelay(long_hold_us);
+	else if (short_hold_us)
+		udelay(short_hold_us);
+}
+
+static void torture_sleeping_lock_delay(void)
+{
+	if (long_hold_ms && torture_long_hold())
+		mdelay(long_hold_ms);
+	else if (short_hold_us)
+		udelay(short_hold_us);
+}
+
+static DEFINE_SPINLOCK(torture_spinlock);
+
+static void torture_spin_lock_write_lock(void)
+	__acquires(torture_spinlock)
+{
+	spin_lock(&torture_spinlock);
+}
+
+static void torture_spin_lock_write_unlock(void)
+	__releases(torture_spinlock)
+{
+	spin_unlock(&torture_spinlock);
+}
+
+static struct lock_torture_ops spin_lock_ops = {
+	.writelock	= torture_spin_lock_write_lock,
+	.writeunlock	= torture_spin_lock_write_unlock,
+	.delay		= torture_spin_lock_delay,
+	.name		= "spin_lock"
+};
+
+static void torture_spin_lock_write_lock_irq(void)
+	__acquires(torture_spinlock)
+{
+	spin_lock_irq(&torture_spinlock);
+}
+
+static void torture_spin_lock_write_unlock_irq(void)
+	__releases(torture_spinlock)
+{
+	spin_unlock_irq(&torture_spinlock);
+}
+
+static struct lock_torture_ops spin_lock_irq_ops = {
+	.writelock	= torture_spin_lock_write_lock_irq,
+	.writeunlock	= torture_spin_lock_write_unlock_irq,
+	.delay		= torture_spin_lock_delay,
+	.name		= "spin_lock_irq"
+};
+
+static DEFINE_RWLOCK(torture_rwlock);
+
+static void torture_rwlock_write_lock(void)
+	__acquires(torture_rwlock)
+{
+	write_lock(&torture_rwlock);
+}
+
+static void torture_rwlock_write_unlock(void)
+	__releases(torture_rwlock)
+{
+	write_unlock(&torture_rwlock);
+}
+
+static void torture_rwlock_read_lock(void)
+	__acquires(torture_rwlock)
+{
+	read_lock(&torture_rwlock);
+}
+
+static void torture_rwlock_read_unlock(void)
+	__releases(torture_rwlock)
+{
+	read_unlock(&torture_rwlock);
+}
+
+static struct lock_torture_ops rw_lock_ops = {
+	.writelock	= torture_rwlock_write_lock,
+	.writeunlock	= torture_rwlock_write_unlock,
+	.readlock	= torture_rwlock_read_lock,
+	.readunlock	= torture_rwlock_read_unlock,
+	.delay		= torture_spin_lock_delay,
+	.name		= "rw_lock"
+};
+
+static void torture_rwlock_write_lock_irq(void)
+	__acquires(torture_rwlock)
+{
+	write_lock_irq(&torture_rwlock);
+}
+
+static void torture_rwlock_write_unlock_irq(void)
+	__releases(torture_rwlock)
+{
+	write_unlock_irq(&torture_rwlock);
+}
+
+static void torture_rwlock_read_lock_irq(void)
+	__acquires(torture_rwlock)
+{
+	read_lock_irq(&torture_rwlock);
+}
+
+static void torture_rwlock_read_unlock_irq(void)
+	__releases(torture_rwlock)
+{
+	read_unlock_irq(&torture_rwlock);
+}
+
+static struct lock_torture_ops rw_lock_irq_ops = {
+	.writelock	= torture_rwlock_write_lock_irq,
+	.writeunlock	= torture_rwlock_write_unlock_irq,
+	.readlock	= torture_rwlock_read_lock_irq,
+	.readunlock	= torture_rwlock_read_unlock_irq,
+	.delay		= torture_spin_lock_delay,
+	.name		= "rw_lock_irq"
+};
+
+static DEFINE_MUTEX(torture_mutex);
+
+static void torture_mutex_lock(void)
+	__acquires(torture_mutex)
+{
+	mutex_lock(&torture_mutex);
+}
+
+static void torture_mutex_unlock(void)
+	__releases(torture_mutex)
+{
+	mutex_unlock(&torture_mutex);
+}
+
+static struct lock_torture_ops mutex_lock_ops = {
+	.writelock	= torture_mutex_lock,
+	.writeunlock	= torture_mutex_unlock,
+	.delay		= torture_sleeping_lock_delay,
+	.name		= "mutex_lock"
+};
+
+static DECLARE_RWSEM(torture_rwsem);
+
+static void torture_rwsem_down_write(void)
+	__acquires(torture_rwsem)
+{
+	down_write(&torture_rwsem);
+}
+
+static void torture_rwsem_up_write(void)
+	__releases(torture_rwsem)
+{
+	up_write(&torture_rwsem);
+}
+
+static void torture_rwsem_down_read(void)
+	__acquires(torture_rwsem)
+{
+	down_read(&torture_rwsem);
+}
+
+static void torture_rwsem_up_read(void)
+	__releases(torture_rwsem)
+{
+	up_read(&torture_rwsem);
+}
+
+static struct lock_torture_ops rwsem_lock_ops = {
+	.writelock	= torture_rwsem_down_write,
+	.writeunlock	= torture_rwsem_up_write,
+	.readlock	= torture_rwsem_down_read,
+	.readunlock	= torture_rwsem_up_read,
+	.delay		= torture_sleeping_lock_delay,
+	.name		= "rwsem_lock"
+};
+
+/*
+ * Lock torture writer kthread.  Repeatedly acquires and releases
+ * the lock, checking for duplicate acquisitions.
+ */
+static int lock_torture_writer(void *arg)
+{
+	struct lock_stress_stats *lwsp = arg;
+	u64 wait;
+
+	VERBOSE_PRINTK_STRING("lock_torture_writer task started");
+	set_user_nice(current, 19);
+
+	do {
+		if ((prandom_u32() & 0xfffff) == 0)
+			schedule_timeout_uninterruptible(1);
+		wait = local_clock();
+		cur_ops->writelock();
+		wait = local_clock() - wait;
+		if (WARN_ON_ONCE(lock_is_write_held) ||
+		    WARN_ON_ONCE(atomic_read(&lock_is_read_held)))
+			lwsp->n_lock_fail++;
+		lock_is_write_held = true;
+		lwsp->n_lock_acquired++;
+		if (wait > lwsp->max_wait)
+			lwsp->max_wait = wait;
+		cur_ops->delay();
+		lock_is_write_held = false;
+		cur_ops->writeunlock();
+		cond_resched();
+		locktorture_shutdown_absorb("lock_torture_writer");
+	} while (!kthread_should_stop() && fullstop == FULLSTOP_DONTSTOP);
+	VERBOSE_PRINTK_STRING("lock_torture_writer task stopping");
+	locktorture_shutdown_absorb("lock_torture_writer");
+	while (!kthread_should_stop())
+		schedule_timeout_uninterruptible(1);
+	return 0;
+}
+
+/*
+ * Lock torture reader kthread.  Repeatedly acquires and releases
+ * the lock for reading, checking that no writer holds it.
+ */
+static int lock_torture_reader(void *arg)
+{
+	struct lock_stress_stats *lrsp = arg;
+	u64 wait;
+
+	VERBOSE_PRINTK_STRING("lock_torture_reader task started");
+	set_user_nice(current, 19);
+
+	do {
+		if ((prandom_u32() & 0xfffff) == 0)
+			schedule_timeout_uninterruptible(1);
+		wait = local_clock();
+		cur_ops->readlock();
+		wait = local_clock() - wait;
+		atomic_inc(&lock_is_read_held);
+		if (WARN_ON_ONCE(lock_is_write_held))
+			lrsp->n_lock_fail++;
+		lrsp->n_lock_acquired++;
+		if (wait > lrsp->max_wait)
+			lrsp->max_wait = wait;
+		cur_ops->delay();
+		atomic_dec(&lock_is_read_held);
+		cur_ops->readunlock();
+		cond_resched();
+		locktorture_shutdown_absorb("lock_torture_reader");
+	} while (!kthread_should_stop() && fullstop == FULLSTOP_DONTSTOP);
+	VERBOSE_PRINTK_STRING("lock_torture_reader task stopping");
+	locktorture_shutdown_absorb("lock_torture_reader");
+	while (!kthread_should_stop())
+		schedule_timeout_uninterruptible(1);
+	return 0;
+}
+
+/*
+ * Print one line of statistics for the writers or the readers: total
+ * and per-second acquisitions, the least and most successful thread
+ * and the spread between them as a percentage of the most successful,
+ * the worst wait seen by any thread and the number of mutual-exclusion
+ * violations.  Returns the number of violations.
+ */
+static long __torture_print_stats(struct lock_stress_stats *statp, int n,
+				  bool write, unsigned int elapsed_ms)
+{
+	long min = LONG_MAX, max = 0, sum = 0, fail = 0;
+	u64 max_wait = 0;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		long acquired = ACCESS_ONCE(statp[i].n_lock_acquired);
+
+		sum += acquired;
+		min = min(min, acquired);
+		max = max(max, acquired);
+		fail += ACCESS_ONCE(statp[i].n_lock_fail);
+		max_wait = max(max_wait, ACCESS_ONCE(statp[i].max_wait));
+	}
+
+	pr_alert("%s" TORTURE_FLAG
+		 " %s%s:  Total: %ld  Acq/s: %llu  Min: %ld  Max: %ld  Spread: %ld%%  Max wait: %llu us  Fail: %ld\n",
+		 torture_type, fail ? "!!! " : "",
+		 write ? "Writes" : "Reads ", sum,
+		 div_u64((u64)sum * MSEC_PER_SEC, max(elapsed_ms, 1U)),
+		 min, max, max ? (max - min) * 100 / max : 0,
+		 div_u64(max_wait, NSEC_PER_USEC), fail);
+	return fail;
+}
+
+/*
+ * Print torture statistics.  Caller must ensure that there is only one
+ * call to this function at a given time, which holds because only the
+ * stats kthread prints until lock_torture_cleanup() has stopped it.
+ * Returns the number of mutual-exclusion violations seen so far.
+ */
+static long lock_torture_stats_print(void)
+{
+	unsigned int elapsed_ms = jiffies_to_msecs(jiffies - start_jiffies);
+	long fail = 0;
+
+	if (nrealwriters_stress)
+		fail += __torture_print_stats(lwsa, nrealwriters_stress, true,
+					      elapsed_ms);
+	if (nrealreaders_stress)
+		fail += __torture_print_stats(lrsa, nrealreaders_stress,
+					      false, elapsed_ms);
+	if (fail)
+		WARN_ON_ONCE(1);
+	return fail;
+}
+
+/*
+ * Periodically prints torture statistics, if periodic statistics printing
+ * was specified via the stat_interval module parameter.
+ */
+static int lock_torture_stats(void *arg)
+{
+	VERBOSE_PRINTK_STRING("lock_torture_stats task started");
+	do {
+		schedule_timeout_interruptible(stat_interval * HZ);
+		lock_torture_stats_print();
+		locktorture_shutdown_absorb("lock_torture_stats");
+	} while (!kthread_should_stop());
+	VERBOSE_PRINTK_STRING("lock_torture_stats task stopping");
+	return 0;
+}
+
+static inline void
+lock_torture_print_module_parms(struct lock_torture_ops *cur_ops,
+				const char *tag)
+{
+	pr_alert("%s" TORTURE_FLAG
+		 "--- %s: nwriters_stress=%d nreaders_stress=%d "
+		 "short_hold_us=%d long_hold_us=%d long_hold_ms=%d "
+		 "stat_interval=%d verbose=%d\n",
+		 torture_type, tag, nrealwriters_stress, nrealreaders_stress,
+		 short_hold_us, long_hold_us, long_hold_ms, stat_interval,
+		 verbose);
+}
+
+static void lock_torture_cleanup(void)
+{
+	long fail;
+	int i;
+
+	mutex_lock(&fullstop_mutex);
+	if (fullstop == FULLSTOP_SHUTDOWN) {
+		pr_warn(/* but going down anyway, so... */
+		       "Concurrent 'rmmod locktorture' and shutdown illegal!\n");
+		mutex_unlock(&fullstop_mutex);
+		schedule_timeout_uninterruptible(10);
+		return;
+	}
+	fullstop = FULLSTOP_RMMOD;
+	mutex_unlock(&fullstop_mutex);
+	unregister_reboot_notifier(&locktorture_shutdown_nb);
+
+	if (writer_tasks) {
+		for (i = 0; i < nrealwriters_stress; i++) {
+			if (writer_tasks[i]) {
+				VERBOSE_PRINTK_STRING(
+					"Stopping lock_torture_writer task");
+				kthread_stop(writer_tasks[i]);
+			}
+			writer_tasks[i] = NULL;
+		}
+		kfree(writer_tasks);
+		writer_tasks = NULL;
+	}
+
+	if (reader_tasks) {
+		for (i = 0; i < nrealreaders_stress; i++) {
+			if (reader_tasks[i]) {
+				VERBOSE_PRINTK_STRING(
+					"Stopping lock_torture_reader task");
+				kthread_stop(reader_tasks[i]);
+			}
+			reader_tasks[i] = NULL;
+		}
+		kfree(reader_tasks);
+		reader_tasks = NULL;
+	}
+
+	if (stats_task) {
+		VERBOSE_PRINTK_STRING("Stopping lock_torture_stats task");
+		kthread_stop(stats_task);
+	}
+	stats_task = NULL;
+
+	fail = 0;
+	if (lwsa && lrsa)
+		fail = lock_torture_stats_print(); /* -After- the stats thread is stopped! */
+
+	if (fail)
+		lock_torture_print_module_parms(cur_ops, "End of test: FAILURE");
+	else
+		lock_torture_print_module_parms(cur_ops, "End of test: SUCCESS");
+
+	kfree(lwsa);
+	lwsa = NULL;
+	kfree(lrsa);
+	lrsa = NULL;
+}
+
+static int __init lock_torture_init(void)
+{
+	int i;
+	int firsterr = 0;
+	static struct lock_torture_ops *torture_ops[] = {
+		&spin_lock_ops, &spin_lock_irq_ops,
+		&rw_lock_ops, &rw_lock_irq_ops,
+		&mutex_lock_ops, &rwsem_lock_ops,
+	};
+
+	mutex_lock(&fullstop_mutex);
+
+	/* Process args and tell the world that the torturer is on the job. */
+	for (i = 0; i < ARRAY_SIZE(torture_ops); i++) {
+		cur_ops = torture_ops[i];
+		if (strcmp(torture_type, cur_ops->name) == 0)
+			break;
+	}
+	if (i == ARRAY_SIZE(torture_ops)) {
+		pr_alert("lock-torture: invalid torture type: \"%s\"\n",
+			 torture_type);
+		pr_alert("lock-torture types:");
+		for (i = 0; i < ARRAY_SIZE(torture_ops); i++)
+			pr_alert(" %s", torture_ops[i]->name);
+		pr_alert("\n");
+		mutex_unlock(&fullstop_mutex);
+		return -EINVAL;
+	}
+
+	if (nwriters_stress >= 0)
+		nrealwriters_stress = nwriters_stress;
+	else
+		nrealwriters_stress = 2 * num_online_cpus();
+	if (!cur_ops->readlock) {
+		if (nreaders_stress > 0)
+			pr_alert("lock-torture: %s has no read side, nreaders_stress ignored.\n",
+				 cur_ops->name);
+		nrealreaders_stress = 0;
+	} else if (nreaders_stress >= 0) {
+		nrealreaders_stress = nreaders_stress;
+	} else {
+		nrealreaders_stress = num_online_cpus();
+	}
+	if (nrealwriters_stress + nrealreaders_stress == 0) {
+		pr_alert("lock-torture: no stress-test threads requested.\n");
+		mutex_unlock(&fullstop_mutex);
+		return -EINVAL;
+	}
+	if (short_hold_us < 0)
+		short_hold_us = 0;
+	if (long_hold_ms < 0)
+		long_hold_ms = 0;
+	long_hold_us = clamp(long_hold_us, 0, 1000);
+	lock_torture_print_module_parms(cur_ops, "Start of test");
+	fullstop = FULLSTOP_DONTSTOP;
+
+	/* Initialize the statistics so that each run gets its own numbers. */
+
+	lock_is_write_held = false;
+	atomic_set(&lock_is_read_held, 0);
+	lwsa = kcalloc(max(nrealwriters_stress, 1), sizeof(*lwsa), GFP_KERNEL);
+	lrsa = kcalloc(max(nrealreaders_stress, 1), sizeof(*lrsa), GFP_KERNEL);
+	writer_tasks = kcalloc(max(nrealwriters_stress, 1),
+			       sizeof(writer_tasks[0]), GFP_KERNEL);
+	reader_tasks = kcalloc(max(nrealreaders_stress, 1),
+			       sizeof(reader_tasks[0]), GFP_KERNEL);
+	if (!lwsa || !lrsa || !writer_tasks || !reader_tasks) {
+		VERBOSE_PRINTK_ERRSTRING("out of memory");
+		firsterr = -ENOMEM;
+		goto unwind;
+	}
+	start_jiffies = jiffies;
+
+	/* Start up the kthreads. */
+
+	for (i = 0; i < nrealwriters_stress; i++) {
+		VERBOSE_PRINTK_STRING("Creating lock_torture_writer task");
+		writer_tasks[i] = kthread_run(lock_torture_writer, &lwsa[i],
+					      "lock_torture_writer");
+		if (IS_ERR(writer_tasks[i])) {
+			firsterr = PTR_ERR(writer_tasks[i]);
+			VERBOSE_PRINTK_ERRSTRING("Failed to create writer");
+			writer_tasks[i] = NULL;
+			goto unwind;
+		}
+	}
+	for (i = 0; i < nrealreaders_stress; i++) {
+		VERBOSE_PRINTK_STRING("Creating lock_torture_reader task");
+		reader_tasks[i] = kthread_run(lock_torture_reader, &lrsa[i],
+					      "lock_torture_reader");
+		if (IS_ERR(reader_tasks[i])) {
+			firsterr = PTR_ERR(reader_tasks[i]);
+			VERBOSE_PRINTK_ERRSTRING("Failed to create reader");
+			reader_tasks[i] = NULL;
+			goto unwind;
+		}
+	}
+	if (stat_interval > 0) {
+		VERBOSE_PRINTK_STRING("Creating lock_torture_stats task");
+		stats_task = kthread_run(lock_torture_stats, NULL,
+					 "lock_torture_stats");
+		if (IS_ERR(stats_task)) {
+			firsterr = PTR_ERR(stats_task);
+			VERBOSE_PRINTK_ERRSTRING("Failed to create stats");
+			stats_task = NULL;
+			goto unwind;
+		}
+	}
+	register_reboot_notifier(&locktorture_shutdown_nb);
+	mutex_unlock(&fullstop_mutex);
+	return 0;
+
+unwind:
+	mutex_unlock(&fullstop_mutex);
+	lock_torture_cleanup();
+	return firsterr;
+}
+
+module_init(lock_torture_init);
+module_exit(lock_torture_cleanup);
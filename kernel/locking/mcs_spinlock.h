@@ -0,0 +1,33 @@
+/*
+ * MCS lock defines
+ *
+ * This file contains the main data structure and API definitions of MCS lock.
+ *
+ * The MCS lock (proposed by Mellor-Crummey and Scott) is a simple spin-lock
+ * with the desirable properties of being fair, and with each cpu trying
+ * to acquire the lock spinning on a local variable.
+ * It avoids expensive cache bouncings that common test-and-set spin-lock
+ * implementations incur.
+ *
+ * The mutex and rwsem optimistic spinners queue up on an MCS lock so that
+ * only one of them at a time spins on the lock owner.
+ */
+#ifndef __LINUX_MCS_SPINLOCK_H
+#define __LINUX_MCS_SPINLOCK_H
+
+struct mcs_spinlock {
+	struct mcs_spinlock *next;
+	int locked; /* 1 if lock acquired */
+};
+
+/*
+ * The nodes live on the stack of the spinning task, the lock itself is a
+ * single pointer to the tail of the queue. The functions are not inlined
+ * so that perf can correctly account for the time spent in them.
+ */
+extern void mcs_spin_lock(struct mcs_spinlock **lock,
+			  struct mcs_spinlock *node);
+extern void mcs_spin_unlock(struct mcs_spinlock **lock,
+			    struct mcs_spinlock *node);
+
+#endif /* __LINUX_MCS_SPINLOCK_H */
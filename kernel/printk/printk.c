@@ -45,6 +45,7 @@
 #include <linux/poll.h>
 #include <linux/irq_work.h>
 #include <linux/utsname.h>
+#include <linux/kthread.h>
 
 #include <asm/uaccess.h>
 
@@ -797,6 +798,30 @@ module_param(ignore_loglevel, bool, S_IRUGO | S_IWUSR);
 MODULE_PARM_DESC(ignore_loglevel, "ignore loglevel setting, to"
 	"print all kernel messages to the console.");
 
+/*
+ * In asynchronous mode printk() only stores messages in the log buffer
+ * and printk_kthread does the console output, so that a flood of
+ * messages on a slow console cannot stall the cpu that prints them.
+ * Until the kthread runs, and whenever an oops or a panic is in
+ * progress, printk() prints synchronously as before.
+ */
+static bool __read_mostly printk_sync;
+
+module_param_named(synchronous, printk_sync, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(synchronous, "print console messages from the caller "
+	"of printk() instead of from the printk kthread.");
+
+static struct task_struct *printk_kthread;
+static bool printk_kthread_need_flush;
+
+static void wake_up_printk_kthread(void);
+
+static inline bool printk_want_sync(void)
+{
+	return printk_sync || !printk_kthread || oops_in_progress ||
+	       system_state != SYSTEM_RUNNING;
+}
+
 #ifdef CONFIG_BOOT_PRINTK_DELAY
 
 static int boot_delay; /* msecs delay after each printk during bootup */
@@ -1611,6 +1636,14 @@ asmlinkage int vprintk_emit(int facility, int level,
 	}
 	printed_len += text_len;
 
+	if (!printk_want_sync()) {
+		/* leave console output to printk_kthread */
+		logbuf_cpu = UINT_MAX;
+		raw_spin_unlock(&logbuf_lock);
+		wake_up_printk_kthread();
+		goto out_lockdep;
+	}
+
 	/*
 	 * Try to acquire and then immediately release the console semaphore.
 	 * The release will print out buffers and wake up /dev/kmsg and syslog()
@@ -1622,6 +1655,7 @@ asmlinkage int vprintk_emit(int facility, int level,
 	if (console_trylock_for_printk(this_cpu))
 		console_unlock();
 
+out_lockdep:
 	lockdep_on();
 out_restore_irqs:
 	local_irq_restore(flags);
@@ -2015,13 +2049,19 @@ void console_unlock(void)
 	static u64 seen_seq;
 	unsigned long flags;
 	bool wake_klogd = false;
-	bool retry;
+	bool do_cond_resched, retry;
 
 	if (console_suspended) {
 		up(&console_sem);
 		return;
 	}
 
+	/*
+	 * Console drivers are called with interrupts disabled, so only
+	 * reschedule between records, and only if console_lock() was taken
+	 * from sleepable context (as the printk kthread does).
+	 */
+	do_cond_resched = console_may_schedule;
 	console_may_schedule = 0;
 
 	/* flush buffered message fragment immediately to console */
@@ -2078,6 +2118,9 @@ skip:
 		call_console_drivers(level, text, len);
 		start_critical_timings();
 		local_irq_restore(flags);
+
+		if (do_cond_resched)
+			cond_resched();
 	}
 	console_locked = 0;
 	mutex_release(&console_lock_dep_map, 1, _RET_IP_);
@@ -2437,6 +2480,7 @@ late_initcall(printk_late_init);
 
 #define PRINTK_PENDING_WAKEUP	0x01
 #define PRINTK_PENDING_SCHED	0x02
+#define PRINTK_PENDING_OUTPUT	0x04
 
 static DEFINE_PER_CPU(int, printk_pending);
 static DEFINE_PER_CPU(char [PRINTK_BUF_SIZE], printk_sched_buf);
@@ -2452,6 +2496,11 @@ static void wake_up_klogd_work_func(struct irq_work *irq_work)
 
 	if (pending & PRINTK_PENDING_WAKEUP)
 		wake_up_interruptible(&log_wait);
+
+	if (pending & PRINTK_PENDING_OUTPUT) {
+		ACCESS_ONCE(printk_kthread_need_flush) = true;
+		wake_up_process(printk_kthread);
+	}
 }
 
 static DEFINE_PER_CPU(struct irq_work, wake_up_klogd_work) = {
@@ -2469,6 +2518,57 @@ void wake_up_klogd(void)
 	preempt_enable();
 }
 
+/*
+ * printk() may be called with scheduler locks held, so the kthread is
+ * woken from irq_work rather than directly.  Called with irqs disabled.
+ */
+static void wake_up_printk_kthread(void)
+{
+	__this_cpu_or(printk_pending, PRINTK_PENDING_OUTPUT);
+	irq_work_queue(&__get_cpu_var(wake_up_klogd_work));
+}
+
+static int printk_kthread_func(void *data)
+{
+	while (1) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (!ACCESS_ONCE(printk_kthread_need_flush))
+			schedule();
+		__set_current_state(TASK_RUNNING);
+
+		/*
+		 * Clear the flag before flushing: anything stored after this
+		 * point is either printed by the console_unlock() below or
+		 * wakes us up again.
+		 */
+		ACCESS_ONCE(printk_kthread_need_flush) = false;
+		smp_mb();
+
+		console_lock();
+		console_unlock();
+	}
+
+	return 0;
+}
+
+static int __init init_printk_kthread(void)
+{
+	struct task_struct *thread;
+
+	if (printk_sync)
+		return 0;
+
+	thread = kthread_run(printk_kthread_func, NULL, "printk");
+	if (IS_ERR(thread)) {
+		pr_err("printk: unable to create printing thread\n");
+		return PTR_ERR(thread);
+	}
+
+	printk_kthread = thread;
+	return 0;
+}
+late_initcall(init_printk_kthread);
+
 int printk_sched(const char *fmt, ...)
 {
 	unsigned long flags;
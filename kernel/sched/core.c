@@ -7652,6 +7652,43 @@ static u64 cpu_shares_read_u64(struct cgroup_subsys_state *css,
 	return (u64) scale_load_down(tg->shares);
 }
 
+#ifdef CONFIG_SMP
+static int cpu_gang_write_u64(struct cgroup_subsys_state *css,
+			      struct cftype *cftype, u64 gang)
+{
+	return sched_group_set_gang(css_tg(css), gang);
+}
+
+static u64 cpu_gang_read_u64(struct cgroup_subsys_state *css,
+			     struct cftype *cft)
+{
+	return css_tg(css)->gang;
+}
+
+static int cpu_gang_stat_show(struct seq_file *sf, void *v)
+{
+	struct task_group *tg = css_tg(seq_css(sf));
+	u64 kicks = 0, hits = 0, misses = 0;
+	int i;
+
+	if (tg->gang_stat) {
+		for_each_possible_cpu(i) {
+			struct gang_stat *gs = per_cpu_ptr(tg->gang_stat, i);
+
+			kicks += gs->kicks;
+			hits += gs->hits;
+			misses += gs->misses;
+		}
+	}
+
+	seq_printf(sf, "kicks %llu\n", kicks);
+	seq_printf(sf, "hits %llu\n", hits);
+	seq_printf(sf, "misses %llu\n", misses);
+
+	return 0;
+}
+#endif
+
 #ifdef CONFIG_CFS_BANDWIDTH
 static DEFINE_MUTEX(cfs_constraints_mutex);
 
@@ -7925,6 +7962,19 @@ static struct cftype cpu_files[] = {
 		.read_u64 = cpu_shares_read_u64,
 		.write_u64 = cpu_shares_write_u64,
 	},
+#ifdef CONFIG_SMP
+	{
+		.name = "gang",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.read_u64 = cpu_gang_read_u64,
+		.write_u64 = cpu_gang_write_u64,
+	},
+	{
+		.name = "gang_stat",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = cpu_gang_stat_show,
+	},
+#endif
 #endif
 #ifdef CONFIG_CFS_BANDWIDTH
 	{
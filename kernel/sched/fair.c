@@ -4492,15 +4492,137 @@ preempt:
 		set_last_buddy(se);
 }
 
+#if defined(CONFIG_FAIR_GROUP_SCHED) && defined(CONFIG_SMP)
+/*
+ * Gang scheduling.
+ *
+ * When a cpu switches to a task of a group that has cpu.gang set, it
+ * asks the other cpus of its LLC domain that have runnable tasks of
+ * that group, but are running something else, to reschedule with the
+ * group as their next buddy.  The buddy is only picked if that is not
+ * too unfair (see pick_next_entity()), so this lines up the time slices
+ * of the group's tasks without giving the group more cpu time.  This
+ * helps threads that spin on or IPI each other, such as the vcpus of an
+ * SMP guest, which suffer badly when a lock holder is preempted.
+ */
+static inline bool task_in_gang(struct task_struct *p, struct task_group *tg)
+{
+	return p->sched_class == &fair_sched_class &&
+	       cfs_rq_of(&p->se)->tg == tg;
+}
+
+static void gang_kick_siblings(struct rq *rq, struct task_group *tg)
+{
+	struct gang_stat *gs = per_cpu_ptr(tg->gang_stat, cpu_of(rq));
+	struct sched_domain *sd;
+	int cpu = cpu_of(rq), i;
+
+	rcu_read_lock();
+	sd = rcu_dereference(per_cpu(sd_llc, cpu));
+	if (!sd)
+		goto unlock;
+
+	for_each_cpu(i, sched_domain_span(sd)) {
+		struct cfs_rq *cfs_rq = tg->cfs_rq[i];
+
+		if (i == cpu)
+			continue;
+
+		/* Unlocked, this is only a hint. */
+		if (!ACCESS_ONCE(cfs_rq->h_nr_running) ||
+		    ACCESS_ONCE(cfs_rq->curr) || cfs_rq_throttled(cfs_rq))
+			continue;
+
+		ACCESS_ONCE(cpu_rq(i)->gang_tg) = tg;
+		resched_cpu(i);
+		gs->kicks++;
+	}
+unlock:
+	rcu_read_unlock();
+}
+
+/*
+ * Consume a gang hint left by a sibling cpu and make the group our next
+ * buddy.  Must be called under rcu_read_lock(): the group is only freed
+ * a grace period after unregister_fair_sched_group() cleared the hints.
+ */
+static struct task_group *gang_pick_prepare(struct rq *rq)
+{
+	struct task_group *tg;
+	struct sched_entity *se;
+
+	if (likely(!ACCESS_ONCE(rq->gang_tg)))
+		return NULL;
+
+	tg = xchg(&rq->gang_tg, NULL);
+	if (!tg)
+		return NULL;
+
+	se = tg->se[cpu_of(rq)];
+	if (se->on_rq && !throttled_hierarchy(cfs_rq_of(se)))
+		set_next_buddy(se);
+
+	return tg;
+}
+
+static void gang_pick_account(struct rq *rq, struct task_group *tg,
+			      struct task_struct *p)
+{
+	struct gang_stat *gs = per_cpu_ptr(tg->gang_stat, cpu_of(rq));
+	struct sched_entity *gse = tg->se[cpu_of(rq)];
+	struct sched_entity *se = &p->se;
+
+	for_each_sched_entity(se) {
+		if (se == gse) {
+			gs->hits++;
+			return;
+		}
+	}
+	gs->misses++;
+}
+
+static void gang_pick_done(struct rq *rq, struct task_struct *p)
+{
+	struct task_group *tg = cfs_rq_of(&p->se)->tg;
+
+	/* rq->curr is still the task we switch away from */
+	if (unlikely(tg->gang) && !task_in_gang(rq->curr, tg))
+		gang_kick_siblings(rq, tg);
+}
+
+int sched_group_set_gang(struct task_group *tg, int gang)
+{
+	/* The root group is not a gang. */
+	if (!tg->se[0])
+		return -EINVAL;
+
+	ACCESS_ONCE(tg->gang) = !!gang;
+	return 0;
+}
+#else
+static inline struct task_group *gang_pick_prepare(struct rq *rq)
+{
+	return NULL;
+}
+
+static inline void gang_pick_account(struct rq *rq, struct task_group *tg,
+				     struct task_struct *p) { }
+static inline void gang_pick_done(struct rq *rq, struct task_struct *p) { }
+#endif
+
 static struct task_struct *pick_next_task_fair(struct rq *rq)
 {
 	struct task_struct *p;
 	struct cfs_rq *cfs_rq = &rq->cfs;
 	struct sched_entity *se;
+	struct task_group *gang;
 
 	if (!cfs_rq->nr_running)
 		return NULL;
 
+	rcu_read_lock();
+	gang = gang_pick_prepare(rq);
+
 	do {
 		se = pick_next_entity(cfs_rq);
 		set_next_entity(cfs_rq, se);
@@ -4508,6 +4630,12 @@ static struct task_struct *pick_next_task_fair(struct rq *rq)
 	} while (cfs_rq);
 
 	p = task_of(se);
+	if (gang)
+		gang_pick_account(rq, gang, p);
+	rcu_read_unlock();
+
+	gang_pick_done(rq, p);
+
 	if (hrtick_enabled(rq))
 		hrtick_start_fair(rq, p);
 
@@ -7144,6 +7272,9 @@ void free_fair_sched_group(struct task_group *tg)
 
 	kfree(tg->cfs_rq);
 	kfree(tg->se);
+#ifdef CONFIG_SMP
+	free_percpu(tg->gang_stat);
+#endif
 }
 
 int alloc_fair_sched_group(struct task_group *tg, struct task_group *parent)
@@ -7160,6 +7291,11 @@ int alloc_fair_sched_group(struct task_group *tg, struct task_group *parent)
 		goto err;
 
 	tg->shares = NICE_0_LOAD;
+#ifdef CONFIG_SMP
+	tg->gang_stat = alloc_percpu(struct gang_stat);
+	if (!tg->gang_stat)
+		goto err;
+#endif
 
 	init_cfs_bandwidth(tg_cfs_bandwidth(tg));
 
@@ -7191,6 +7327,11 @@ void unregister_fair_sched_group(struct task_group *tg, int cpu)
 	struct rq *rq = cpu_rq(cpu);
 	unsigned long flags;
 
+#ifdef CONFIG_SMP
+	/* drop any gang hint for us, see gang_pick_prepare() */
+	cmpxchg(&rq->gang_tg, tg, NULL);
+#endif
+
 	/*
 	* Only empty task groups can be destroyed; so we can speculatively
 	* check on_list without danger of it being re-added.
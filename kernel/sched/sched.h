@@ -229,6 +229,10 @@ struct task_group {
 #ifdef	CONFIG_SMP
 	atomic_long_t load_avg;
 	atomic_t runnable_avg;
+
+	/* co-schedule this group's tasks across the LLC (cpu.gang) */
+	int gang;
+	struct gang_stat __percpu *gang_stat;
 #endif
 #endif
 
@@ -253,6 +257,18 @@ struct task_group {
 	struct cfs_bandwidth cfs_bandwidth;
 };
 
+#if defined(CONFIG_FAIR_GROUP_SCHED) && defined(CONFIG_SMP)
+/*
+ * Gang scheduling statistics, per cpu.  Each cpu only updates its own
+ * slot, under its rq->lock.
+ */
+struct gang_stat {
+	u64 kicks;	/* sibling cpus asked to switch to the group */
+	u64 hits;	/* ... which then picked a task of the group */
+	u64 misses;	/* ... which picked something else */
+};
+#endif
+
 #ifdef CONFIG_FAIR_GROUP_SCHED
 #define ROOT_TASK_GROUP_LOAD	NICE_0_LOAD
 
@@ -315,6 +331,9 @@ extern void sched_move_task(struct task_struct *tsk);
 
 #ifdef CONFIG_FAIR_GROUP_SCHED
 extern int sched_group_set_shares(struct task_group *tg, unsigned long shares);
+#ifdef CONFIG_SMP
+extern int sched_group_set_gang(struct task_group *tg, int gang);
+#endif
 #endif
 
 #else /* CONFIG_CGROUP_SCHED */
@@ -559,6 +578,10 @@ struct rq {
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	/* list of leaf cfs_rq on this cpu: */
 	struct list_head leaf_cfs_rq_list;
+#ifdef CONFIG_SMP
+	/* gang group a sibling cpu asked us to run next, see fair.c */
+	struct task_group *gang_tg;
+#endif
 #endif /* CONFIG_FAIR_GROUP_SCHED */
 
 #ifdef CONFIG_RT_GROUP_SCHED
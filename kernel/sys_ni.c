@@ -209,3 +209,9 @@ cond_syscall(compat_sys_open_by_handle_at);
 
 /* compare kernel pointers */
 cond_syscall(sys_kcmp);
+
+/* user-space memory barriers */
+cond_syscall(sys_membarrier);
+
+/* user-space page fault handling */
+cond_syscall(sys_userfaultfd);
@@ -135,6 +135,24 @@ print_base(struct seq_file *m, struct hrtimer_clock_base *base, u64 now)
 	print_active_timers(m, base, now);
 }
 
+static void print_timer_wheel(struct seq_file *m, int cpu)
+{
+	struct timer_wheel_stats stats;
+
+	timer_wheel_get_stats(cpu, &stats);
+	SEQ_printf(m, " timer wheel:\n");
+#define P(x) \
+	SEQ_printf(m, "  .%-15s: %Lu\n", #x, (unsigned long long)(stats.x))
+#define P_ns(x) \
+	SEQ_printf(m, "  .%-15s: %Lu nsecs\n", #x, (unsigned long long)(stats.x))
+	P(nr_runs);
+	P(nr_expired);
+	P_ns(run_time);
+	P_ns(max_run_time);
+#undef P
+#undef P_ns
+}
+
 static void print_cpu(struct seq_file *m, int cpu, u64 now)
 {
 	struct hrtimer_cpu_base *cpu_base = &per_cpu(hrtimer_bases, cpu);
@@ -193,6 +211,7 @@ static void print_cpu(struct seq_file *m, int cpu, u64 now)
 
 #undef P
 #undef P_ns
+	print_timer_wheel(m, cpu);
 	SEQ_printf(m, "\n");
 }
 
@@ -256,7 +275,7 @@ static void timer_list_show_tickdevices_header(struct seq_file *m)
 
 static inline void timer_list_header(struct seq_file *m, u64 now)
 {
-	SEQ_printf(m, "Timer List Version: v0.7\n");
+	SEQ_printf(m, "Timer List Version: v0.8\n");
 	SEQ_printf(m, "HRTIMER_MAX_CLOCK_BASES: %d\n", HRTIMER_MAX_CLOCK_BASES);
 	SEQ_printf(m, "now at %Ld nsecs\n", (unsigned long long)now);
 	SEQ_printf(m, "\n");
@@ -24,6 +24,8 @@
 #include <linux/list.h>
 #include <linux/cpu.h>
 #include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/trace_mmap.h>
 
 #include <asm/local.h>
 
@@ -356,6 +358,7 @@ struct buffer_page {
 	unsigned	 read;		/* index for next read */
 	local_t		 entries;	/* entries on this page */
 	unsigned long	 real_end;	/* real end of data */
+	unsigned	 id;		/* index in the user mapping */
 	struct buffer_data_page *page;	/* Actual data page */
 };
 
@@ -489,6 +492,11 @@ struct ring_buffer_per_cpu {
 	struct completion		update_done;
 
 	struct rb_irq_work		irq_work;
+
+	/* user space mapping, see ring_buffer_map() */
+	unsigned int			mapped;
+	struct trace_buffer_meta	*meta_page;
+	unsigned long			*subbuf_ids;	/* id to data page */
 };
 
 struct ring_buffer {
@@ -1238,6 +1246,12 @@ static void rb_free_cpu_buffer(struct ring_buffer_per_cpu *cpu_buffer)
 
 	free_buffer_page(cpu_buffer->reader_page);
 
+	/* pages still mapped by user space hold their own reference */
+	if (cpu_buffer->meta_page) {
+		free_page((unsigned long)cpu_buffer->meta_page);
+		kfree(cpu_buffer->subbuf_ids);
+	}
+
 	rb_head_page_deactivate(cpu_buffer);
 
 	if (head) {
@@ -1651,6 +1665,16 @@ int ring_buffer_resize(struct ring_buffer *buffer, unsigned long size,
 	/* prevent another thread from changing buffer sizes */
 	mutex_lock(&buffer->mutex);
 
+	/* The pages of a memory mapped buffer must stay where they are */
+	for_each_buffer_cpu(buffer, cpu) {
+		if (cpu_id != RING_BUFFER_ALL_CPUS && cpu != cpu_id)
+			continue;
+		if (buffer->buffers[cpu]->mapped) {
+			mutex_unlock(&buffer->mutex);
+			return -EBUSY;
+		}
+	}
+
 	if (cpu_id == RING_BUFFER_ALL_CPUS) {
 		/* calculate the pages to update */
 		for_each_buffer_cpu(buffer, cpu) {
@@ -4312,6 +4336,10 @@ int ring_buffer_swap_cpu(struct ring_buffer *buffer_a,
 	if (atomic_read(&cpu_buffer_b->record_disabled))
 		goto out;
 
+	ret = -EBUSY;
+	if (cpu_buffer_a->mapped || cpu_buffer_b->mapped)
+		goto out;
+
 	/*
 	 * We can't do a synchronize_sched here because this
 	 * function can be called in atomic context.
@@ -4422,7 +4450,8 @@ EXPORT_SYMBOL_GPL(ring_buffer_free_read_page);
  *
  * Returns:
  *  >=0 if data has been transferred, returns the offset of consumed data.
- *  <0 if no data has been transferred.
+ *  <0 if no data has been transferred, -EBUSY if the cpu buffer is
+ *  memory mapped by user space.
  */
 int ring_buffer_read_page(struct ring_buffer *buffer,
 			  void **data_page, size_t len, int cpu, int full)
@@ -4459,6 +4488,12 @@ int ring_buffer_read_page(struct ring_buffer *buffer,
 
 	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
 
+	/* Swapping out pages would pull them from under the user mapping */
+	if (cpu_buffer->mapped) {
+		ret = -EBUSY;
+		goto out_unlock;
+	}
+
 	reader = rb_get_reader_page(cpu_buffer);
 	if (!reader)
 		goto out_unlock;
@@ -4588,6 +4623,295 @@ int ring_buffer_read_page(struct ring_buffer *buffer,
 }
 EXPORT_SYMBOL_GPL(ring_buffer_read_page);
 
+/*
+ * Number the sub-buffers for the user mapping, the reader page gets id 0
+ * and the pages of the ring follow in list order. The reader page is
+ * swapped with ring pages later on, but the set of pages does not change
+ * while the buffer is mapped, so neither do the ids.
+ */
+static void rb_setup_ids_meta_page(struct ring_buffer_per_cpu *cpu_buffer,
+				   unsigned long *subbuf_ids)
+{
+	struct trace_buffer_meta *meta = cpu_buffer->meta_page;
+	struct buffer_page *first, *bpage;
+	unsigned id = 0;
+
+	subbuf_ids[id] = (unsigned long)cpu_buffer->reader_page->page;
+	cpu_buffer->reader_page->id = id++;
+
+	first = bpage = list_entry(cpu_buffer->pages, struct buffer_page, list);
+	do {
+		if (RB_WARN_ON(cpu_buffer, id > cpu_buffer->nr_pages))
+			break;
+		subbuf_ids[id] = (unsigned long)bpage->page;
+		bpage->id = id++;
+		rb_inc_page(cpu_buffer, &bpage);
+	} while (bpage != first);
+
+	cpu_buffer->subbuf_ids = subbuf_ids;
+
+	meta->meta_page_size = PAGE_SIZE;
+	meta->meta_struct_len = sizeof(*meta);
+	meta->subbuf_size = PAGE_SIZE;
+	meta->nr_subbufs = cpu_buffer->nr_pages + 1;
+	meta->reader.id = cpu_buffer->reader_page->id;
+	meta->reader.read = cpu_buffer->reader_page->read;
+	meta->reader.commit = cpu_buffer->reader_page->read;
+}
+
+/* Page @pgoff of the mapping: the meta page, then the sub-buffers by id */
+static void *rb_map_page_addr(struct ring_buffer_per_cpu *cpu_buffer,
+			      unsigned long pgoff)
+{
+	if (!pgoff)
+		return cpu_buffer->meta_page;
+	if (pgoff > cpu_buffer->nr_pages + 1)
+		return NULL;
+	return (void *)cpu_buffer->subbuf_ids[pgoff - 1];
+}
+
+static int rb_map_pages(struct ring_buffer_per_cpu *cpu_buffer,
+			struct vm_area_struct *vma)
+{
+	unsigned long addr = vma->vm_start;
+	unsigned long pgoff = vma->vm_pgoff;
+	unsigned long nr_pages = vma_pages(vma);
+	void *page;
+	int ret;
+
+	if (pgoff + nr_pages > cpu_buffer->nr_pages + 2)
+		return -EINVAL;
+
+	for (; nr_pages; nr_pages--, pgoff++, addr += PAGE_SIZE) {
+		page = rb_map_page_addr(cpu_buffer, pgoff);
+		ret = vm_insert_page(vma, addr, virt_to_page(page));
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+/* Drop one mapping reference, called with buffer->mutex held */
+static void rb_unmap(struct ring_buffer_per_cpu *cpu_buffer)
+{
+	struct trace_buffer_meta *meta;
+	unsigned long *subbuf_ids;
+	unsigned long flags;
+
+	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+	if (--cpu_buffer->mapped) {
+		raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+		return;
+	}
+	meta = cpu_buffer->meta_page;
+	subbuf_ids = cpu_buffer->subbuf_ids;
+	cpu_buffer->meta_page = NULL;
+	cpu_buffer->subbuf_ids = NULL;
+	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+
+	free_page((unsigned long)meta);
+	kfree(subbuf_ids);
+}
+
+/**
+ * ring_buffer_map - map a cpu buffer for a lockless consumer
+ * @buffer: the buffer the cpu buffer belongs to
+ * @cpu: the cpu buffer to map
+ * @vma: the user space mapping to fill, or NULL
+ *
+ * Takes a mapping reference on the cpu buffer and, if @vma is given,
+ * inserts the pages into it: the meta page (struct trace_buffer_meta)
+ * first and then every sub-buffer in id order. A NULL @vma only takes
+ * the reference, for in kernel consumers and for split user mappings.
+ *
+ * While a cpu buffer is mapped it can not be resized or swapped, and
+ * ring_buffer_read_page() will not take pages out of it.
+ *
+ * Returns 0 on success and < 0 on failure.
+ */
+int ring_buffer_map(struct ring_buffer *buffer, int cpu,
+		    struct vm_area_struct *vma)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	struct trace_buffer_meta *meta = NULL;
+	unsigned long *subbuf_ids = NULL;
+	unsigned long flags;
+	int ret = 0;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return -EINVAL;
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	/* keeps the pages stable against ring_buffer_resize() */
+	mutex_lock(&buffer->mutex);
+
+	if (!cpu_buffer->mapped) {
+		meta = (void *)get_zeroed_page(GFP_KERNEL);
+		subbuf_ids = kcalloc(cpu_buffer->nr_pages + 1,
+				     sizeof(*subbuf_ids), GFP_KERNEL);
+		if (!meta || !subbuf_ids) {
+			free_page((unsigned long)meta);
+			kfree(subbuf_ids);
+			ret = -ENOMEM;
+			goto out;
+		}
+	}
+
+	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+	if (!cpu_buffer->mapped) {
+		cpu_buffer->meta_page = meta;
+		rb_setup_ids_meta_page(cpu_buffer, subbuf_ids);
+	}
+	cpu_buffer->mapped++;
+	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+
+	if (vma) {
+		ret = rb_map_pages(cpu_buffer, vma);
+		if (ret)
+			rb_unmap(cpu_buffer);
+	}
+ out:
+	mutex_unlock(&buffer->mutex);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(ring_buffer_map);
+
+/**
+ * ring_buffer_unmap - drop a reference taken by ring_buffer_map()
+ * @buffer: the buffer the cpu buffer belongs to
+ * @cpu: the mapped cpu buffer
+ *
+ * The meta page is released with the last reference. Pages still in
+ * a user space mapping stay allocated until they are unmapped.
+ */
+int ring_buffer_unmap(struct ring_buffer *buffer, int cpu)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	int ret = 0;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return -EINVAL;
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	mutex_lock(&buffer->mutex);
+	if (cpu_buffer->mapped)
+		rb_unmap(cpu_buffer);
+	else
+		ret = -ENODEV;
+	mutex_unlock(&buffer->mutex);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(ring_buffer_unmap);
+
+/**
+ * ring_buffer_map_page - kernel address of a page of the mapping
+ * @buffer: the buffer the cpu buffer belongs to
+ * @cpu: the mapped cpu buffer
+ * @pgoff: 0 for the meta page, id + 1 for a sub-buffer
+ *
+ * For in kernel consumers that hold a reference from ring_buffer_map().
+ */
+void *ring_buffer_map_page(struct ring_buffer *buffer, int cpu,
+			   unsigned long pgoff)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return NULL;
+
+	cpu_buffer = buffer->buffers[cpu];
+	if (WARN_ON_ONCE(!cpu_buffer->mapped))
+		return NULL;
+
+	return rb_map_page_addr(cpu_buffer, pgoff);
+}
+EXPORT_SYMBOL_GPL(ring_buffer_map_page);
+
+/**
+ * ring_buffer_map_get_reader - hand the next chunk to a mapped consumer
+ * @buffer: the buffer the cpu buffer belongs to
+ * @cpu: the mapped cpu buffer
+ *
+ * The consumer is done with what it was handed before. If the reader
+ * page has been read completely, the next page is swapped in from the
+ * ring. Everything committed on the reader page is then consumed at once
+ * and published in the meta page as reader.id, reader.read and
+ * reader.commit. The consumer walks the events in place, without a copy
+ * and without taking the reader_lock for each event; the writer never
+ * touches the consumed part of the reader page.
+ *
+ * Returns 0 if a chunk was handed out, -EAGAIN if the cpu buffer is
+ * empty and -ENODEV if it is not mapped.
+ */
+int ring_buffer_map_get_reader(struct ring_buffer *buffer, int cpu)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	struct trace_buffer_meta *meta;
+	struct buffer_page *reader;
+	unsigned long lost_events = 0;
+	unsigned int read, commit;
+	unsigned long flags;
+	int ret = -EAGAIN;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return -EINVAL;
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+
+	if (!cpu_buffer->mapped) {
+		ret = -ENODEV;
+		goto out_unlock;
+	}
+
+	reader = rb_get_reader_page(cpu_buffer);
+	if (!reader) {
+		reader = cpu_buffer->reader_page;
+		read = commit = reader->read;
+		goto out_update;
+	}
+
+	read = reader->read;
+	commit = rb_page_commit(reader);
+
+	if (!read && reader != cpu_buffer->commit_page) {
+		/* the writer is off this page, consume all of it */
+		cpu_buffer->read += rb_page_entries(reader);
+		cpu_buffer->read_bytes += BUF_PAGE_SIZE;
+		reader->read = commit;
+	} else {
+		/* only account up to what was committed so far */
+		while (reader->read < commit)
+			rb_advance_reader(cpu_buffer);
+	}
+
+	lost_events = cpu_buffer->lost_events;
+	cpu_buffer->lost_events = 0;
+	ret = 0;
+
+ out_update:
+	meta = cpu_buffer->meta_page;
+	meta->reader.lost_events = lost_events;
+	meta->reader.id = reader->id;
+	meta->reader.read = read;
+	meta->reader.commit = commit;
+	meta->entries = local_read(&cpu_buffer->entries);
+	meta->overrun = local_read(&cpu_buffer->overrun);
+	meta->read = cpu_buffer->read;
+
+ out_unlock:
+	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(ring_buffer_map_get_reader);
+
 #ifdef CONFIG_HOTPLUG_CPU
 static int rb_cpu_notify(struct notifier_block *self,
 			 unsigned long action, void *hcpu)
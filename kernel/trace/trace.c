@@ -38,6 +38,7 @@
 #include <linux/poll.h>
 #include <linux/nmi.h>
 #include <linux/fs.h>
+#include <linux/trace_mmap.h>
 #include <linux/sched/rt.h>
 
 #include "trace.h"
@@ -559,6 +560,12 @@ void tracing_snapshot(void)
 		return;
 	}
 
+	if (tr->mapped) {
+		internal_trace_puts("*** BUFFER MEMORY MAPPED ***\n");
+		internal_trace_puts("*** Can not use snapshot (sorry) ***\n");
+		return;
+	}
+
 	local_irq_save(flags);
 	update_max_tr(tr, current, smp_processor_id());
 	local_irq_restore(flags);
@@ -1038,6 +1045,12 @@ update_max_tr(struct trace_array *tr, struct task_struct *tsk, int cpu)
 
 	arch_spin_lock(&ftrace_max_lock);
 
+	/* The pages of a memory mapped buffer must stay in trace_buffer */
+	if (tr->mapped) {
+		arch_spin_unlock(&ftrace_max_lock);
+		return;
+	}
+
 	buf = tr->trace_buffer.buffer;
 	tr->trace_buffer.buffer = tr->max_buffer.buffer;
 	tr->max_buffer.buffer = buf;
@@ -1071,6 +1084,11 @@ update_max_tr_single(struct trace_array *tr, struct task_struct *tsk, int cpu)
 
 	arch_spin_lock(&ftrace_max_lock);
 
+	if (tr->mapped) {
+		arch_spin_unlock(&ftrace_max_lock);
+		return;
+	}
+
 	ret = ring_buffer_swap_cpu(tr->max_buffer.buffer, tr->trace_buffer.buffer, cpu);
 
 	if (ret == -EBUSY) {
@@ -3900,6 +3918,14 @@ static int tracing_set_tracer(const char *buf)
 	if (t == tr->current_trace)
 		goto out;
 
+#ifdef CONFIG_TRACER_MAX_TRACE
+	/* A latency tracer would swap the mapped buffers away */
+	if (t->use_max_tr && tr->mapped) {
+		ret = -EBUSY;
+		goto out;
+	}
+#endif
+
 	trace_branch_disable();
 
 	tr->current_trace->enabled = false;
@@ -4841,6 +4867,10 @@ tracing_snapshot_write(struct file *filp, const char __user *ubuf, size_t cnt,
 			break;
 		}
 #endif
+		if (tr->mapped) {
+			ret = -EBUSY;
+			break;
+		}
 		if (!tr->allocated_snapshot) {
 			ret = alloc_snapshot(tr);
 			if (ret < 0)
@@ -5090,6 +5120,11 @@ tracing_buffers_read(struct file *filp, char __user *ubuf,
 	trace_access_unlock(iter->cpu_file);
 
 	if (ret < 0) {
+		/* the cpu buffer is memory mapped, read it from there */
+		if (ret == -EBUSY) {
+			size = ret;
+			goto out_unlock;
+		}
 		if (trace_empty(iter)) {
 			if ((filp->f_flags & O_NONBLOCK)) {
 				size = -EAGAIN;
@@ -5252,6 +5287,7 @@ tracing_buffers_splice_read(struct file *file, loff_t *ppos,
 	}
 
  again:
+	ret = 0;
 	trace_access_lock(iter->cpu_file);
 	entries = ring_buffer_entries_cpu(iter->trace_buffer->buffer, iter->cpu_file);
 
@@ -5276,6 +5312,8 @@ tracing_buffers_splice_read(struct file *file, loff_t *ppos,
 		if (r < 0) {
 			ring_buffer_free_read_page(ref->buffer, ref->page);
 			kfree(ref);
+			if (r == -EBUSY)
+				ret = r;
 			break;
 		}
 
@@ -5304,6 +5342,9 @@ tracing_buffers_splice_read(struct file *file, loff_t *ppos,
 
 	/* did we read anything? */
 	if (!spd.nr_pages) {
+		/* the cpu buffer is memory mapped, read it from there */
+		if (ret == -EBUSY)
+			goto out;
 		if ((file->f_flags & O_NONBLOCK) || (flags & SPLICE_F_NONBLOCK)) {
 			ret = -EAGAIN;
 			goto out;
@@ -5326,12 +5367,126 @@ out:
 	return ret;
 }
 
+/*
+ * update_max_tr() and update_max_tr_single() check tr->mapped under
+ * ftrace_max_lock, so once it is raised the buffers stay where they are.
+ */
+static int tracing_get_mapped(struct trace_array *tr, bool excl)
+{
+#ifdef CONFIG_TRACER_MAX_TRACE
+	int ret = 0;
+
+	local_irq_disable();
+	arch_spin_lock(&ftrace_max_lock);
+	if (excl && tr->current_trace->use_max_tr)
+		ret = -EBUSY;
+	else
+		tr->mapped++;
+	arch_spin_unlock(&ftrace_max_lock);
+	local_irq_enable();
+
+	return ret;
+#else
+	return 0;
+#endif
+}
+
+static void tracing_put_mapped(struct trace_array *tr)
+{
+#ifdef CONFIG_TRACER_MAX_TRACE
+	local_irq_disable();
+	arch_spin_lock(&ftrace_max_lock);
+	WARN_ON(!tr->mapped--);
+	arch_spin_unlock(&ftrace_max_lock);
+	local_irq_enable();
+#endif
+}
+
+/* called when a mapping is split, the pages are in place already */
+static void tracing_buffers_mmap_open(struct vm_area_struct *vma)
+{
+	struct ftrace_buffer_info *info = vma->vm_file->private_data;
+	struct trace_iterator *iter = &info->iter;
+
+	tracing_get_mapped(iter->tr, false);
+	WARN_ON(ring_buffer_map(iter->trace_buffer->buffer,
+				iter->cpu_file, NULL));
+}
+
+static void tracing_buffers_mmap_close(struct vm_area_struct *vma)
+{
+	struct ftrace_buffer_info *info = vma->vm_file->private_data;
+	struct trace_iterator *iter = &info->iter;
+
+	WARN_ON(ring_buffer_unmap(iter->trace_buffer->buffer, iter->cpu_file));
+	tracing_put_mapped(iter->tr);
+}
+
+static const struct vm_operations_struct tracing_buffers_vmops = {
+	.open		= tracing_buffers_mmap_open,
+	.close		= tracing_buffers_mmap_close,
+};
+
+/*
+ * Map the cpu buffer read only, see include/uapi/linux/trace_mmap.h for
+ * the layout. The consumer moves on with TRACE_MMAP_IOCTL_GET_READER.
+ */
+static int tracing_buffers_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct ftrace_buffer_info *info = filp->private_data;
+	struct trace_iterator *iter = &info->iter;
+	int ret;
+
+	if (vma->vm_flags & (VM_WRITE | VM_EXEC) ||
+	    !(vma->vm_flags & VM_MAYSHARE))
+		return -EPERM;
+
+	vma->vm_flags &= ~VM_MAYWRITE;
+	vma->vm_flags |= VM_DONTCOPY | VM_DONTEXPAND | VM_DONTDUMP;
+	vma->vm_ops = &tracing_buffers_vmops;
+
+	ret = tracing_get_mapped(iter->tr, true);
+	if (ret)
+		return ret;
+
+	ret = ring_buffer_map(iter->trace_buffer->buffer, iter->cpu_file, vma);
+	if (ret)
+		tracing_put_mapped(iter->tr);
+
+	return ret;
+}
+
+static long tracing_buffers_ioctl(struct file *file, unsigned int cmd,
+				  unsigned long arg)
+{
+	struct ftrace_buffer_info *info = file->private_data;
+	struct trace_iterator *iter = &info->iter;
+	int ret;
+
+	if (cmd != TRACE_MMAP_IOCTL_GET_READER)
+		return -ENOTTY;
+
+	for (;;) {
+		ret = ring_buffer_map_get_reader(iter->trace_buffer->buffer,
+						 iter->cpu_file);
+		if (ret != -EAGAIN || (file->f_flags & O_NONBLOCK))
+			return ret;
+
+		iter->trace->wait_pipe(iter);
+		if (signal_pending(current))
+			return -EINTR;
+	}
+}
+
 static const struct file_operations tracing_buffers_fops = {
 	.open		= tracing_buffers_open,
 	.read		= tracing_buffers_read,
 	.poll		= tracing_buffers_poll,
 	.release	= tracing_buffers_release,
 	.splice_read	= tracing_buffers_splice_read,
+	.mmap		= tracing_buffers_mmap,
+	.unlocked_ioctl	= tracing_buffers_ioctl,
+	.compat_ioctl	= tracing_buffers_ioctl,
 	.llseek		= no_llseek,
 };
 
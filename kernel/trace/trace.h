@@ -189,6 +189,8 @@ struct trace_array {
 	 */
 	struct trace_buffer	max_buffer;
 	bool			allocated_snapshot;
+	/* memory mapped cpu buffers, these must not be swapped */
+	unsigned int		mapped;
 #endif
 	int			buffer_disabled;
 #ifdef CONFIG_FTRACE_SYSCALLS
@@ -607,6 +609,46 @@ void update_max_tr_single(struct trace_array *tr,
 			  struct task_struct *tsk, int cpu);
 #endif /* CONFIG_TRACER_MAX_TRACE */
 
+enum latency_hist_type {
+	LATENCY_HIST_IRQSOFF,
+	LATENCY_HIST_PREEMPTOFF,
+	LATENCY_HIST_PREEMPTIRQSOFF,
+	LATENCY_HIST_WAKEUP,
+	LATENCY_HIST_MAX,
+};
+
+#ifdef CONFIG_LATENCY_HIST
+extern struct static_key latency_hist_critical_key;
+
+void __latency_hist_irqs_off(void);
+void __latency_hist_irqs_on(void);
+void __latency_hist_preempt_off(void);
+void __latency_hist_preempt_on(void);
+void __latency_hist_start_timings(void);
+void __latency_hist_stop_timings(void);
+
+/*
+ * Called from the irqsoff and preemptoff hooks whatever the current
+ * tracer is; a static key keeps them cheap until a histogram is enabled.
+ */
+#define DEFINE_LATENCY_HIST_HOOK(name)					\
+static inline void latency_hist_##name(void)				\
+{									\
+	if (static_key_false(&latency_hist_critical_key))		\
+		__latency_hist_##name();				\
+}
+#else
+#define DEFINE_LATENCY_HIST_HOOK(name)					\
+static inline void latency_hist_##name(void) { }
+#endif
+
+DEFINE_LATENCY_HIST_HOOK(irqs_off)
+DEFINE_LATENCY_HIST_HOOK(irqs_on)
+DEFINE_LATENCY_HIST_HOOK(preempt_off)
+DEFINE_LATENCY_HIST_HOOK(preempt_on)
+DEFINE_LATENCY_HIST_HOOK(start_timings)
+DEFINE_LATENCY_HIST_HOOK(stop_timings)
+
 #ifdef CONFIG_STACKTRACE
 void ftrace_trace_stack(struct ring_buffer *buffer, unsigned long flags,
 			int skip, int pc);
@@ -1063,6 +1105,27 @@ struct event_trigger_data {
 	struct list_head		list;
 };
 
+extern void trigger_data_free(struct event_trigger_data *data);
+extern int event_trigger_init(struct event_trigger_ops *ops,
+			      struct event_trigger_data *data);
+extern int set_trigger_filter(char *filter_str,
+			      struct event_trigger_data *trigger_data,
+			      struct ftrace_event_file *file);
+extern int register_trigger(char *glob, struct event_trigger_ops *ops,
+			    struct event_trigger_data *data,
+			    struct ftrace_event_file *file);
+extern void unregister_trigger(char *glob, struct event_trigger_ops *ops,
+			       struct event_trigger_data *test,
+			       struct ftrace_event_file *file);
+extern int register_event_command(struct event_command *cmd);
+
+#ifdef CONFIG_HIST_TRIGGERS
+extern int register_trigger_hist_cmd(void);
+extern const struct file_operations event_hist_fops;
+#else
+static inline int register_trigger_hist_cmd(void) { return 0; }
+#endif
+
 /**
  * struct event_trigger_ops - callbacks for trace event triggers
  *
@@ -1075,7 +1138,9 @@ struct event_trigger_data {
  * @func: The trigger 'probe' function called when the triggering
  *	event occurs.  The data passed into this callback is the data
  *	that was supplied to the event_command @reg() function that
- *	registered the trigger (see struct event_command).
+ *	registered the trigger (see struct event_command).  @rec is
+ *	the event record when the trigger is invoked after the event
+ *	fields have been assigned, NULL otherwise.
  *
  * @init: An optional initialization function called for the trigger
  *	when the trigger is registered (via the event_command reg()
@@ -1100,7 +1165,8 @@ struct event_trigger_data {
  *	(see trace_event_triggers.c).
  */
 struct event_trigger_ops {
-	void			(*func)(struct event_trigger_data *data);
+	void			(*func)(struct event_trigger_data *data,
+					void *rec);
 	int			(*init)(struct event_trigger_ops *ops,
 					struct event_trigger_data *data);
 	void			(*free)(struct event_trigger_ops *ops,
@@ -1124,8 +1190,8 @@ struct event_trigger_ops {
  * The data members in this structure provide per-event command data
  * for various event commands.
  *
- * All the data members below, except for @post_trigger, must be set
- * for each event command.
+ * All the data members below, except for @post_trigger and
+ * @needs_rec, must be set for each event command.
  *
  * @name: The unique name that identifies the event command.  This is
  *	the name used when setting triggers via trigger files.
@@ -1163,6 +1229,12 @@ struct event_trigger_ops {
  *	itself logs to the trace buffer, this flag should be set,
  *	otherwise it can be left unspecified.
  *
+ * @needs_rec: A flag that says whether or not this command needs
+ *	the event record passed to its trigger function.  Setting it
+ *	makes the trigger run only once the event fields have been
+ *	assigned, the same way a trigger with a filter does, so the
+ *	@func() probe always sees a non-NULL record.
+ *
  * All the methods below, except for @set_filter(), must be
  * implemented.
  *
@@ -1203,6 +1275,7 @@ struct event_command {
 	char			*name;
 	enum event_trigger_type	trigger_type;
 	bool			post_trigger;
+	bool			needs_rec;
 	int			(*func)(struct event_command *cmd_ops,
 					struct ftrace_event_file *file,
 					char *glob, char *cmd, char *params);
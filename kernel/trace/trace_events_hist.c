@@ -0,0 +1,962 @@
+/*
+ * trace_events_hist - trace event hist triggers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * A 'hist' trigger aggregates the events it is attached to into an
+ * in-kernel hash table instead of streaming them through the ring
+ * buffer.  Each table entry is identified by the values of one or more
+ * event fields (the keys) and accumulates a hit count plus the sums of
+ * zero or more numeric fields (the values):
+ *
+ *   echo 'hist:keys=common_pid:vals=bytes_req:sort=hitcount.descending' > \
+ *	events/kmem/kmalloc/trigger
+ *   cat events/kmem/kmalloc/hist
+ *
+ * The table is sized when the trigger is created and all of its entries
+ * are preallocated, so an event hit never allocates memory and never
+ * takes a lock: new keys claim a slot with cmpxchg() and the counters
+ * are updated with atomic64 operations.  Once the table is full, hits
+ * on keys that are not already present are counted as dropped.
+ */
+
+#include <linux/module.h>
+#include <linux/kallsyms.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/jhash.h>
+#include <linux/sort.h>
+#include <linux/log2.h>
+
+#include "trace.h"
+
+#define HIST_KEYS_MAX		3
+#define HIST_VALS_MAX		3
+#define HIST_KEY_STR_LEN	64
+#define HIST_KEY_SIZE_MAX	(HIST_KEYS_MAX * HIST_KEY_STR_LEN)
+
+#define HIST_MAP_BITS_DEFAULT	11
+#define HIST_MAP_BITS_MIN	7
+#define HIST_MAP_BITS_MAX	17
+
+enum hist_field_flags {
+	HIST_FIELD_KEY		= 1,
+	HIST_FIELD_STRING	= 2,
+	HIST_FIELD_HEX		= 4,
+	HIST_FIELD_SYM		= 8,
+};
+
+struct hist_field {
+	struct ftrace_event_field	*field;
+	unsigned long			flags;
+	/* where a key lives in the compound key, and how much room it takes */
+	unsigned int			offset;
+	unsigned int			size;
+};
+
+/*
+ * A table entry.  Keys are laid out one after the other in @key, each
+ * at its hist_field @offset; numeric keys are stored as u64.
+ */
+struct hist_elt {
+	atomic64_t			hitcount;
+	atomic64_t			sums[HIST_VALS_MAX];
+	u64				key[0];
+};
+
+struct hist_map_entry {
+	u32				key;	/* hash of the compound key, 0 if free */
+	struct hist_elt			*val;
+};
+
+struct hist_trigger_attrs {
+	char				*keys_str;
+	char				*vals_str;
+	char				*sort_key_str;
+	bool				pause;
+	bool				cont;
+	bool				clear;
+	unsigned int			map_bits;
+};
+
+struct hist_trigger_data {
+	struct hist_field		keys[HIST_KEYS_MAX];
+	unsigned int			n_keys;
+	struct hist_field		vals[HIST_VALS_MAX];
+	unsigned int			n_vals;
+	/* NULL sorts on hitcount */
+	struct hist_field		*sort_field;
+	bool				sort_descending;
+	unsigned int			key_size;
+	unsigned int			elt_size;
+	struct hist_trigger_attrs	*attrs;
+	bool				paused;
+
+	unsigned int			map_bits;
+	unsigned int			max_elts;
+	struct hist_map_entry		*map;
+	void				*elts;
+	atomic_t			next_elt;
+	atomic64_t			drops;
+};
+
+static bool hist_field_is_string(struct ftrace_event_field *field)
+{
+	return field->filter_type == FILTER_STATIC_STRING ||
+	       field->filter_type == FILTER_DYN_STRING ||
+	       field->filter_type == FILTER_PTR_STRING;
+}
+
+static u64 hist_field_u64(struct ftrace_event_field *field, void *rec)
+{
+	void *addr = rec + field->offset;
+
+	switch (field->size) {
+	case 1:
+		return field->is_signed ? (u64)*(s8 *)addr : *(u8 *)addr;
+	case 2:
+		return field->is_signed ? (u64)*(s16 *)addr : *(u16 *)addr;
+	case 4:
+		return field->is_signed ? (u64)*(s32 *)addr : *(u32 *)addr;
+	case 8:
+		return *(u64 *)addr;
+	}
+
+	return 0;
+}
+
+static void hist_field_string(struct ftrace_event_field *field, void *rec,
+			      char *buf, unsigned int size)
+{
+	const char *str;
+	unsigned int len = size - 1;
+
+	switch (field->filter_type) {
+	case FILTER_DYN_STRING: {
+		u32 loc = *(u32 *)(rec + field->offset);
+
+		str = rec + (loc & 0xffff);
+		len = min(len, loc >> 16);
+		break;
+	}
+	case FILTER_PTR_STRING:
+		str = *(const char **)(rec + field->offset);
+		if (!str)
+			return;
+		break;
+	default:
+		str = rec + field->offset;
+		len = min_t(unsigned int, len, field->size);
+		break;
+	}
+
+	/* buf is zeroed by the caller, so it stays NUL-terminated */
+	strncpy(buf, str, len);
+}
+
+static inline struct hist_elt *
+hist_elt_at(struct hist_trigger_data *hist_data, unsigned int idx)
+{
+	return hist_data->elts + idx * hist_data->elt_size;
+}
+
+static struct hist_elt *hist_get_free_elt(struct hist_trigger_data *hist_data)
+{
+	int idx = atomic_inc_return(&hist_data->next_elt) - 1;
+
+	if (idx >= hist_data->max_elts) {
+		atomic_set(&hist_data->next_elt, hist_data->max_elts);
+		return NULL;
+	}
+
+	return hist_elt_at(hist_data, idx);
+}
+
+/*
+ * Find the entry for @key, claiming a new one if it isn't in the table
+ * yet.  The table has twice as many slots as there are entries so that
+ * linear probing stays short.  A slot is claimed by installing the key
+ * hash with cmpxchg(), after which its entry pointer is published; a
+ * reader that finds a matching hash with no entry yet (it is being
+ * installed on another CPU) moves on, which can at worst leave a key
+ * split over two entries.
+ */
+static struct hist_elt *
+hist_map_insert(struct hist_trigger_data *hist_data, void *key)
+{
+	unsigned int map_size = hist_data->max_elts * 2;
+	unsigned int key_size = hist_data->key_size;
+	struct hist_map_entry *entry;
+	struct hist_elt *elt;
+	u32 hash, test, idx, dup_try = 0;
+
+	hash = jhash(key, key_size, 0);
+	if (!hash)
+		hash = 1;
+	idx = hash & (map_size - 1);
+
+	while (dup_try++ < map_size) {
+		entry = &hist_data->map[idx];
+		test = ACCESS_ONCE(entry->key);
+
+		if (test == hash) {
+			elt = ACCESS_ONCE(entry->val);
+			if (elt && !memcmp(elt->key, key, key_size))
+				return elt;
+		} else if (!test && !cmpxchg(&entry->key, 0, hash)) {
+			elt = hist_get_free_elt(hist_data);
+			if (!elt)
+				break;
+			memcpy(elt->key, key, key_size);
+			/* make the key visible before the entry is */
+			smp_wmb();
+			entry->val = elt;
+			return elt;
+		}
+
+		idx = (idx + 1) & (map_size - 1);
+	}
+
+	atomic64_inc(&hist_data->drops);
+	return NULL;
+}
+
+static void hist_map_clear(struct hist_trigger_data *hist_data)
+{
+	memset(hist_data->map, 0,
+	       sizeof(*hist_data->map) * hist_data->max_elts * 2);
+	memset(hist_data->elts, 0,
+	       hist_data->elt_size * hist_data->max_elts);
+	atomic_set(&hist_data->next_elt, 0);
+	atomic64_set(&hist_data->drops, 0);
+}
+
+static void
+event_hist_trigger(struct event_trigger_data *data, void *rec)
+{
+	struct hist_trigger_data *hist_data = data->private_data;
+	u64 compound_key[HIST_KEY_SIZE_MAX / sizeof(u64)];
+	struct hist_field *key;
+	struct hist_elt *elt;
+	unsigned int i;
+
+	if (unlikely(ACCESS_ONCE(hist_data->paused)))
+		return;
+
+	memset(compound_key, 0, hist_data->key_size);
+	for (i = 0; i < hist_data->n_keys; i++) {
+		void *k;
+
+		key = &hist_data->keys[i];
+		k = (void *)compound_key + key->offset;
+		if (key->flags & HIST_FIELD_STRING)
+			hist_field_string(key->field, rec, k, key->size);
+		else
+			*(u64 *)k = hist_field_u64(key->field, rec);
+	}
+
+	elt = hist_map_insert(hist_data, compound_key);
+	if (!elt)
+		return;
+
+	atomic64_inc(&elt->hitcount);
+	for (i = 0; i < hist_data->n_vals; i++)
+		atomic64_add(hist_field_u64(hist_data->vals[i].field, rec),
+			     &elt->sums[i]);
+}
+
+static void destroy_hist_trigger_attrs(struct hist_trigger_attrs *attrs)
+{
+	if (!attrs)
+		return;
+
+	kfree(attrs->keys_str);
+	kfree(attrs->vals_str);
+	kfree(attrs->sort_key_str);
+	kfree(attrs);
+}
+
+static int parse_hist_map_bits(struct hist_trigger_attrs *attrs, char *str)
+{
+	unsigned int size;
+	int ret;
+
+	ret = kstrtouint(str, 0, &size);
+	if (ret)
+		return ret;
+
+	if (!size)
+		return -EINVAL;
+
+	attrs->map_bits = ilog2(roundup_pow_of_two(size));
+	if (attrs->map_bits < HIST_MAP_BITS_MIN ||
+	    attrs->map_bits > HIST_MAP_BITS_MAX)
+		return -EINVAL;
+
+	return 0;
+}
+
+static struct hist_trigger_attrs *parse_hist_trigger_attrs(char *trigger_str)
+{
+	struct hist_trigger_attrs *attrs;
+	char **dst;
+	int ret = 0;
+
+	attrs = kzalloc(sizeof(*attrs), GFP_KERNEL);
+	if (!attrs)
+		return ERR_PTR(-ENOMEM);
+
+	while (trigger_str) {
+		char *str = strsep(&trigger_str, ":");
+
+		if (!strncmp(str, "keys=", 5) || !strncmp(str, "key=", 4))
+			dst = &attrs->keys_str;
+		else if (!strncmp(str, "vals=", 5) || !strncmp(str, "val=", 4))
+			dst = &attrs->vals_str;
+		else if (!strncmp(str, "sort=", 5))
+			dst = &attrs->sort_key_str;
+		else if (!strncmp(str, "size=", 5)) {
+			ret = parse_hist_map_bits(attrs, str + 5);
+			if (ret)
+				goto free;
+			continue;
+		} else if (!strcmp(str, "pause")) {
+			attrs->pause = true;
+			continue;
+		} else if (!strcmp(str, "cont") || !strcmp(str, "continue")) {
+			attrs->cont = true;
+			continue;
+		} else if (!strcmp(str, "clear")) {
+			attrs->clear = true;
+			continue;
+		} else {
+			ret = -EINVAL;
+			goto free;
+		}
+
+		if (*dst) {
+			ret = -EINVAL;
+			goto free;
+		}
+		*dst = kstrdup(strchr(str, '=') + 1, GFP_KERNEL);
+		if (!*dst) {
+			ret = -ENOMEM;
+			goto free;
+		}
+	}
+
+	if (!attrs->map_bits)
+		attrs->map_bits = HIST_MAP_BITS_DEFAULT;
+
+	return attrs;
+ free:
+	destroy_hist_trigger_attrs(attrs);
+	return ERR_PTR(ret);
+}
+
+static int create_hist_field(struct hist_field *hist_field,
+			     struct ftrace_event_call *call,
+			     char *field_str, bool key)
+{
+	char *field_name = strsep(&field_str, ".");
+	struct ftrace_event_field *field;
+
+	field = trace_find_event_field(call, field_name);
+	if (!field)
+		return -EINVAL;
+
+	hist_field->field = field;
+
+	if (!key) {
+		/* only numeric fields can be summed, and they take no modifiers */
+		if (field_str || hist_field_is_string(field))
+			return -EINVAL;
+		return 0;
+	}
+
+	hist_field->flags = HIST_FIELD_KEY;
+	if (hist_field_is_string(field)) {
+		if (field_str)
+			return -EINVAL;
+		hist_field->flags |= HIST_FIELD_STRING;
+		if (field->filter_type == FILTER_STATIC_STRING)
+			hist_field->size = ALIGN(min(field->size, HIST_KEY_STR_LEN),
+						 sizeof(u64));
+		else
+			hist_field->size = HIST_KEY_STR_LEN;
+		return 0;
+	}
+
+	if (field->size > sizeof(u64))
+		return -EINVAL;
+
+	if (field_str) {
+		if (!strcmp(field_str, "hex"))
+			hist_field->flags |= HIST_FIELD_HEX;
+		else if (!strcmp(field_str, "sym"))
+			hist_field->flags |= HIST_FIELD_SYM;
+		else
+			return -EINVAL;
+	}
+	hist_field->size = sizeof(u64);
+
+	return 0;
+}
+
+static int create_key_fields(struct hist_trigger_data *hist_data,
+			     struct ftrace_event_call *call)
+{
+	char *fields_str = hist_data->attrs->keys_str;
+	char *field_str;
+	int ret;
+
+	if (!fields_str)
+		return -EINVAL;
+
+	while ((field_str = strsep(&fields_str, ",")) != NULL) {
+		struct hist_field *key;
+
+		if (hist_data->n_keys == HIST_KEYS_MAX)
+			return -EINVAL;
+
+		key = &hist_data->keys[hist_data->n_keys];
+		ret = create_hist_field(key, call, field_str, true);
+		if (ret)
+			return ret;
+
+		key->offset = hist_data->key_size;
+		hist_data->key_size += key->size;
+		hist_data->n_keys++;
+	}
+
+	return 0;
+}
+
+static int create_val_fields(struct hist_trigger_data *hist_data,
+			     struct ftrace_event_call *call)
+{
+	char *fields_str = hist_data->attrs->vals_str;
+	char *field_str;
+	int ret;
+
+	while (fields_str && (field_str = strsep(&fields_str, ",")) != NULL) {
+		/* hitcount is always there */
+		if (!strcmp(field_str, "hitcount"))
+			continue;
+
+		if (hist_data->n_vals == HIST_VALS_MAX)
+			return -EINVAL;
+
+		ret = create_hist_field(&hist_data->vals[hist_data->n_vals],
+					call, field_str, false);
+		if (ret)
+			return ret;
+		hist_data->n_vals++;
+	}
+
+	return 0;
+}
+
+static int create_sort_key(struct hist_trigger_data *hist_data)
+{
+	char *str = hist_data->attrs->sort_key_str;
+	char *field_name, *order;
+	unsigned int i;
+
+	if (!str)
+		return 0;
+
+	field_name = strsep(&str, ".");
+	order = str;
+
+	if (order) {
+		if (!strcmp(order, "descending"))
+			hist_data->sort_descending = true;
+		else if (strcmp(order, "ascending"))
+			return -EINVAL;
+	}
+
+	if (!strcmp(field_name, "hitcount"))
+		return 0;
+
+	for (i = 0; i < hist_data->n_vals; i++) {
+		if (!strcmp(field_name, hist_data->vals[i].field->name)) {
+			hist_data->sort_field = &hist_data->vals[i];
+			return 0;
+		}
+	}
+
+	for (i = 0; i < hist_data->n_keys; i++) {
+		if (!strcmp(field_name, hist_data->keys[i].field->name)) {
+			hist_data->sort_field = &hist_data->keys[i];
+			return 0;
+		}
+	}
+
+	return -EINVAL;
+}
+
+static void destroy_hist_data(struct hist_trigger_data *hist_data)
+{
+	destroy_hist_trigger_attrs(hist_data->attrs);
+	vfree(hist_data->map);
+	vfree(hist_data->elts);
+	kfree(hist_data);
+}
+
+static struct hist_trigger_data *
+create_hist_data(struct hist_trigger_attrs *attrs,
+		 struct ftrace_event_file *file)
+{
+	struct ftrace_event_call *call = file->event_call;
+	struct hist_trigger_data *hist_data;
+	int ret;
+
+	hist_data = kzalloc(sizeof(*hist_data), GFP_KERNEL);
+	if (!hist_data)
+		return ERR_PTR(-ENOMEM);
+
+	/* parsing splits the attrs strings in place, they are freed with us */
+	hist_data->attrs = attrs;
+
+	ret = create_key_fields(hist_data, call);
+	if (!ret)
+		ret = create_val_fields(hist_data, call);
+	if (!ret)
+		ret = create_sort_key(hist_data);
+	if (ret)
+		goto free;
+
+	hist_data->paused = attrs->pause;
+	hist_data->map_bits = attrs->map_bits;
+	hist_data->max_elts = 1 << attrs->map_bits;
+	hist_data->elt_size = sizeof(struct hist_elt) + hist_data->key_size;
+
+	ret = -ENOMEM;
+	hist_data->map = vzalloc(sizeof(*hist_data->map) *
+				 hist_data->max_elts * 2);
+	if (!hist_data->map)
+		goto free;
+
+	hist_data->elts = vzalloc(hist_data->elt_size * hist_data->max_elts);
+	if (!hist_data->elts)
+		goto free;
+
+	return hist_data;
+ free:
+	hist_data->attrs = NULL;
+	destroy_hist_data(hist_data);
+	return ERR_PTR(ret);
+}
+
+static const char *hist_field_name(struct hist_field *hist_field)
+{
+	return hist_field->field->name;
+}
+
+static void hist_field_print(struct seq_file *m, struct hist_field *hist_field)
+{
+	seq_printf(m, "%s", hist_field_name(hist_field));
+	if (hist_field->flags & HIST_FIELD_HEX)
+		seq_puts(m, ".hex");
+	else if (hist_field->flags & HIST_FIELD_SYM)
+		seq_puts(m, ".sym");
+}
+
+static int
+event_hist_trigger_print(struct seq_file *m, struct event_trigger_ops *ops,
+			 struct event_trigger_data *data)
+{
+	struct hist_trigger_data *hist_data = data->private_data;
+	unsigned int i;
+
+	seq_puts(m, "hist:keys=");
+	for (i = 0; i < hist_data->n_keys; i++) {
+		if (i)
+			seq_putc(m, ',');
+		hist_field_print(m, &hist_data->keys[i]);
+	}
+
+	seq_puts(m, ":vals=hitcount");
+	for (i = 0; i < hist_data->n_vals; i++) {
+		seq_putc(m, ',');
+		hist_field_print(m, &hist_data->vals[i]);
+	}
+
+	seq_printf(m, ":sort=%s", hist_data->sort_field ?
+		   hist_field_name(hist_data->sort_field) : "hitcount");
+	if (hist_data->sort_descending)
+		seq_puts(m, ".descending");
+
+	seq_printf(m, ":size=%u", hist_data->max_elts);
+
+	if (data->filter_str)
+		seq_printf(m, " if %s", data->filter_str);
+
+	seq_puts(m, hist_data->paused ? " [paused]\n" : " [active]\n");
+
+	return 0;
+}
+
+static void
+event_hist_trigger_free(struct event_trigger_ops *ops,
+			struct event_trigger_data *data)
+{
+	struct hist_trigger_data *hist_data = data->private_data;
+
+	if (WARN_ON_ONCE(data->ref <= 0))
+		return;
+
+	data->ref--;
+	if (!data->ref) {
+		/* waits for the trigger to stop running before freeing data */
+		trigger_data_free(data);
+		destroy_hist_data(hist_data);
+	}
+}
+
+static struct event_trigger_ops event_hist_trigger_ops = {
+	.func			= event_hist_trigger,
+	.print			= event_hist_trigger_print,
+	.init			= event_trigger_init,
+	.free			= event_hist_trigger_free,
+};
+
+static struct event_trigger_ops *
+event_hist_get_trigger_ops(char *cmd, char *param)
+{
+	return &event_hist_trigger_ops;
+}
+
+static struct event_trigger_data *
+find_hist_trigger(struct ftrace_event_file *file)
+{
+	struct event_trigger_data *data;
+
+	list_for_each_entry_rcu(data, &file->triggers, list) {
+		if (data->cmd_ops->trigger_type == ETT_EVENT_HIST)
+			return data;
+	}
+
+	return NULL;
+}
+
+/*
+ * 'pause', 'cont' and 'clear' act on the hist trigger already set on
+ * the event rather than creating a new one.
+ */
+static int hist_trigger_control(struct event_trigger_data *data,
+				struct hist_trigger_attrs *attrs)
+{
+	struct hist_trigger_data *hist_data = data->private_data;
+
+	if (attrs->clear) {
+		bool paused = hist_data->paused;
+
+		hist_data->paused = true;
+		/* make sure no hit is still updating the table */
+		synchronize_sched();
+		hist_map_clear(hist_data);
+		hist_data->paused = paused;
+	}
+
+	if (attrs->pause)
+		hist_data->paused = true;
+	else if (attrs->cont)
+		hist_data->paused = false;
+
+	return 0;
+}
+
+static int
+event_hist_trigger_func(struct event_command *cmd_ops,
+			struct ftrace_event_file *file,
+			char *glob, char *cmd, char *param)
+{
+	struct event_trigger_data *trigger_data, *existing;
+	struct hist_trigger_data *hist_data = NULL;
+	struct hist_trigger_attrs *attrs;
+	struct event_trigger_ops *trigger_ops;
+	char *trigger;
+	int ret;
+
+	if (!param)
+		return -EINVAL;
+
+	/* separate the trigger from the filter (k:v [if filter]) */
+	trigger = strsep(&param, " \t");
+	if (!trigger)
+		return -EINVAL;
+
+	attrs = parse_hist_trigger_attrs(trigger);
+	if (IS_ERR(attrs))
+		return PTR_ERR(attrs);
+
+	existing = find_hist_trigger(file);
+	if (glob[0] != '!' && (attrs->clear || attrs->cont ||
+			       (attrs->pause && existing))) {
+		ret = existing ? hist_trigger_control(existing, attrs) : -ENOENT;
+		destroy_hist_trigger_attrs(attrs);
+		return ret;
+	}
+
+	trigger_ops = cmd_ops->get_trigger_ops(cmd, trigger);
+
+	ret = -ENOMEM;
+	trigger_data = kzalloc(sizeof(*trigger_data), GFP_KERNEL);
+	if (!trigger_data)
+		goto out_free_attrs;
+
+	trigger_data->count = -1;
+	trigger_data->ops = trigger_ops;
+	trigger_data->cmd_ops = cmd_ops;
+	INIT_LIST_HEAD(&trigger_data->list);
+
+	if (glob[0] == '!') {
+		cmd_ops->unreg(glob+1, trigger_ops, trigger_data, file);
+		kfree(trigger_data);
+		ret = 0;
+		goto out_free_attrs;
+	}
+
+	hist_data = create_hist_data(attrs, file);
+	if (IS_ERR(hist_data)) {
+		kfree(trigger_data);
+		ret = PTR_ERR(hist_data);
+		goto out_free_attrs;
+	}
+	trigger_data->private_data = hist_data;
+
+	if (param && cmd_ops->set_filter) {
+		ret = cmd_ops->set_filter(param, trigger_data, file);
+		if (ret < 0)
+			goto out_free;
+	}
+
+	ret = cmd_ops->reg(glob, trigger_ops, trigger_data, file);
+	if (!ret) {
+		ret = -ENOENT;
+		goto out_free;
+	} else if (ret < 0)
+		goto out_free;
+
+	return 0;
+ out_free:
+	if (cmd_ops->set_filter)
+		cmd_ops->set_filter(NULL, trigger_data, NULL);
+	kfree(trigger_data);
+	destroy_hist_data(hist_data);
+	return ret;
+ out_free_attrs:
+	destroy_hist_trigger_attrs(attrs);
+	return ret;
+}
+
+static struct event_command trigger_hist_cmd = {
+	.name			= "hist",
+	.trigger_type		= ETT_EVENT_HIST,
+	.needs_rec		= true,
+	.func			= event_hist_trigger_func,
+	.reg			= register_trigger,
+	.unreg			= unregister_trigger,
+	.get_trigger_ops	= event_hist_get_trigger_ops,
+	.set_filter		= set_trigger_filter,
+};
+
+__init int register_trigger_hist_cmd(void)
+{
+	int ret;
+
+	ret = register_event_command(&trigger_hist_cmd);
+	WARN_ON(ret < 0);
+
+	return ret;
+}
+
+/* Reading the hist file */
+
+struct hist_sort_entry {
+	struct hist_elt			*elt;
+	const char			*str;
+	u64				val;
+};
+
+static int cmp_hist_sort_entry(const void *a, const void *b)
+{
+	const struct hist_sort_entry *ea = a, *eb = b;
+
+	if (ea->str)
+		return strcmp(ea->str, eb->str);
+
+	if (ea->val == eb->val)
+		return 0;
+
+	return ea->val < eb->val ? -1 : 1;
+}
+
+static void hist_sort_entry_init(struct hist_trigger_data *hist_data,
+				 struct hist_sort_entry *entry,
+				 struct hist_elt *elt)
+{
+	struct hist_field *sort_field = hist_data->sort_field;
+	void *key;
+
+	entry->elt = elt;
+	entry->str = NULL;
+
+	if (!sort_field) {
+		entry->val = atomic64_read(&elt->hitcount);
+		return;
+	}
+
+	if (!(sort_field->flags & HIST_FIELD_KEY)) {
+		entry->val = atomic64_read(&elt->sums[sort_field -
+						      hist_data->vals]);
+		return;
+	}
+
+	key = (void *)elt->key + sort_field->offset;
+	if (sort_field->flags & HIST_FIELD_STRING) {
+		entry->str = key;
+		return;
+	}
+
+	entry->val = *(u64 *)key;
+	/* bias signed keys so that they order correctly as unsigned */
+	if (sort_field->field->is_signed)
+		entry->val ^= 1ULL << 63;
+}
+
+static void hist_key_print(struct seq_file *m, struct hist_field *key,
+			   struct hist_elt *elt)
+{
+	void *k = (void *)elt->key + key->offset;
+	u64 uval;
+
+	seq_printf(m, "%s: ", hist_field_name(key));
+
+	if (key->flags & HIST_FIELD_STRING) {
+		seq_printf(m, "%-16s", (char *)k);
+		return;
+	}
+
+	uval = *(u64 *)k;
+	if (key->flags & HIST_FIELD_HEX)
+		seq_printf(m, "%llx", uval);
+	else if (key->flags & HIST_FIELD_SYM)
+		seq_printf(m, "[%016llx] %-45pS", uval, (void *)(long)uval);
+	else if (key->field->is_signed)
+		seq_printf(m, "%10lld", (s64)uval);
+	else
+		seq_printf(m, "%10llu", uval);
+}
+
+static void hist_elt_print(struct seq_file *m,
+			   struct hist_trigger_data *hist_data,
+			   struct hist_elt *elt)
+{
+	unsigned int i;
+
+	seq_puts(m, "{ ");
+	for (i = 0; i < hist_data->n_keys; i++) {
+		if (i)
+			seq_puts(m, ", ");
+		hist_key_print(m, &hist_data->keys[i], elt);
+	}
+	seq_puts(m, " }");
+
+	seq_printf(m, " hitcount: %10llu",
+		   (u64)atomic64_read(&elt->hitcount));
+	for (i = 0; i < hist_data->n_vals; i++)
+		seq_printf(m, "  %s: %10llu", hist_field_name(&hist_data->vals[i]),
+			   (u64)atomic64_read(&elt->sums[i]));
+	seq_putc(m, '\n');
+}
+
+static int hist_show_data(struct seq_file *m, struct event_trigger_data *data)
+{
+	struct hist_trigger_data *hist_data = data->private_data;
+	struct hist_sort_entry *entries;
+	unsigned int i, n_entries;
+	u64 hits = 0;
+
+	n_entries = min_t(unsigned int, atomic_read(&hist_data->next_elt),
+			  hist_data->max_elts);
+
+	entries = vmalloc(sizeof(*entries) * max(n_entries, 1U));
+	if (!entries)
+		return -ENOMEM;
+
+	for (i = 0; i < n_entries; i++)
+		hist_sort_entry_init(hist_data, &entries[i],
+				     hist_elt_at(hist_data, i));
+
+	sort(entries, n_entries, sizeof(*entries), cmp_hist_sort_entry, NULL);
+
+	seq_puts(m, "# trigger info: ");
+	data->ops->print(m, data->ops, data);
+	seq_putc(m, '\n');
+
+	for (i = 0; i < n_entries; i++) {
+		struct hist_elt *elt;
+
+		elt = entries[hist_data->sort_descending ?
+			      n_entries - i - 1 : i].elt;
+		hits += atomic64_read(&elt->hitcount);
+		hist_elt_print(m, hist_data, elt);
+	}
+
+	seq_puts(m, "\nTotals:\n");
+	seq_printf(m, "    Hits: %llu\n", hits);
+	seq_printf(m, "    Entries: %u\n", n_entries);
+	seq_printf(m, "    Dropped: %llu\n",
+		   (u64)atomic64_read(&hist_data->drops));
+
+	vfree(entries);
+
+	return 0;
+}
+
+static int hist_show(struct seq_file *m, void *v)
+{
+	struct event_trigger_data *data;
+	struct ftrace_event_file *event_file;
+	int ret = 0;
+
+	mutex_lock(&event_mutex);
+
+	event_file = event_file_data(m->private);
+	if (unlikely(!event_file)) {
+		ret = -ENODEV;
+		goto out_unlock;
+	}
+
+	data = find_hist_trigger(event_file);
+	if (data)
+		ret = hist_show_data(m, data);
+ out_unlock:
+	mutex_unlock(&event_mutex);
+
+	return ret;
+}
+
+static int event_hist_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, hist_show, file);
+}
+
+const struct file_operations event_hist_fops = {
+	.open = event_hist_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
@@ -0,0 +1,556 @@
+/*
+ * Latency histograms for irqs-off, preempt-off and wakeup latencies
+ *
+ * The latency tracers only keep the trace of the single worst latency
+ * seen, and only while they are the current tracer.  The histograms here
+ * are fed from the same irqs/preempt on/off hooks and from the sched
+ * tracepoints, whatever the current tracer is, and account every latency
+ * in a per-cpu log2 histogram, so the distribution can be watched over
+ * long runs:
+ *
+ *   tracing/latency_hist/<type>/enable		write 1 to start measuring
+ *   tracing/latency_hist/<type>/total		all cpus together
+ *   tracing/latency_hist/<type>/cpuN		a single cpu
+ *   tracing/latency_hist/reset			write to clear all histograms
+ *
+ * Bucket 0 counts latencies below 1 usec, bucket n (n > 0) those in
+ * [2^(n-1), 2^n) usecs, and the last bucket everything above.  Latencies
+ * are taken with trace_clock_local(), in nanoseconds.
+ *
+ * The wakeup histogram follows, per cpu, the highest priority task woken
+ * up there since the last one was scheduled in, as the wakeup tracer does
+ * for the whole system.
+ */
+#include <linux/debugfs.h>
+#include <linux/percpu.h>
+#include <linux/seq_file.h>
+#include <linux/log2.h>
+#include <linux/fs.h>
+#include <linux/trace_clock.h>
+#include <linux/uaccess.h>
+#include <trace/events/sched.h>
+
+#include "trace.h"
+
+#define LATENCY_HIST_BUCKETS	32
+
+struct latency_hist {
+	unsigned long		buckets[LATENCY_HIST_BUCKETS];
+	unsigned long		samples;
+	u64			total;
+	u64			max;
+};
+
+static DEFINE_PER_CPU(struct latency_hist [LATENCY_HIST_MAX], latency_hists);
+
+static const char *latency_hist_names[LATENCY_HIST_MAX] = {
+	[LATENCY_HIST_IRQSOFF]		= "irqsoff",
+	[LATENCY_HIST_PREEMPTOFF]	= "preemptoff",
+	[LATENCY_HIST_PREEMPTIRQSOFF]	= "preemptirqsoff",
+	[LATENCY_HIST_WAKEUP]		= "wakeup",
+};
+
+/* Start of the section being timed, 0 when none is */
+struct critical_times {
+	u64			irqsoff;
+	u64			preemptoff;
+	u64			preemptirqsoff;
+};
+
+static DEFINE_PER_CPU(struct critical_times, critical_times);
+
+struct wakeup_start {
+	arch_spinlock_t		lock;
+	struct task_struct	*task;
+	u64			start;
+};
+
+static DEFINE_PER_CPU(struct wakeup_start, wakeup_starts) = {
+	.lock = (arch_spinlock_t)__ARCH_SPIN_LOCK_UNLOCKED,
+};
+
+static bool latency_hist_enabled[LATENCY_HIST_MAX] __read_mostly;
+static DEFINE_MUTEX(latency_hist_enable_lock);
+
+struct static_key latency_hist_critical_key = STATIC_KEY_INIT_FALSE;
+
+/* Called with preemption disabled, on the cpu the latency was measured on */
+static void latency_hist_add(enum latency_hist_type type, u64 delta)
+{
+	struct latency_hist *hist = this_cpu_ptr(&latency_hists[type]);
+	u64 usecs = div_u64(delta, NSEC_PER_USEC);
+	int idx;
+
+	idx = usecs ? ilog2(usecs) + 1 : 0;
+	if (idx >= LATENCY_HIST_BUCKETS)
+		idx = LATENCY_HIST_BUCKETS - 1;
+
+	hist->buckets[idx]++;
+	hist->samples++;
+	hist->total += delta;
+	if (delta > hist->max)
+		hist->max = delta;
+}
+
+static inline void
+critical_start(u64 *start, enum latency_hist_type type, u64 now)
+{
+	if (latency_hist_enabled[type] && !*start)
+		*start = now;
+}
+
+static inline void
+critical_stop(u64 *start, enum latency_hist_type type, u64 now)
+{
+	if (*start) {
+		latency_hist_add(type, now - *start);
+		*start = 0;
+	}
+}
+
+/*
+ * The irqs on/off hooks run with interrupts disabled.  The preempt ones
+ * do not, so they disable them around the update of critical_times,
+ * without going through the irqs hooks again.  A section is counted in
+ * preemptirqsoff from the first of irqs or preemption going off to the
+ * last of them coming back on.
+ */
+void __latency_hist_irqs_off(void)
+{
+	struct critical_times *cs = this_cpu_ptr(&critical_times);
+	u64 now = trace_clock_local();
+
+	critical_start(&cs->irqsoff, LATENCY_HIST_IRQSOFF, now);
+	critical_start(&cs->preemptirqsoff, LATENCY_HIST_PREEMPTIRQSOFF, now);
+}
+
+void __latency_hist_irqs_on(void)
+{
+	struct critical_times *cs = this_cpu_ptr(&critical_times);
+	u64 now = trace_clock_local();
+
+	critical_stop(&cs->irqsoff, LATENCY_HIST_IRQSOFF, now);
+	if (!preempt_count())
+		critical_stop(&cs->preemptirqsoff,
+			      LATENCY_HIST_PREEMPTIRQSOFF, now);
+}
+
+void __latency_hist_preempt_off(void)
+{
+	struct critical_times *cs;
+	unsigned long flags;
+	u64 now;
+
+	raw_local_irq_save(flags);
+	cs = this_cpu_ptr(&critical_times);
+	now = trace_clock_local();
+	critical_start(&cs->preemptoff, LATENCY_HIST_PREEMPTOFF, now);
+	critical_start(&cs->preemptirqsoff, LATENCY_HIST_PREEMPTIRQSOFF, now);
+	raw_local_irq_restore(flags);
+}
+
+void __latency_hist_preempt_on(void)
+{
+	struct critical_times *cs;
+	unsigned long flags;
+	u64 now;
+
+	raw_local_irq_save(flags);
+	cs = this_cpu_ptr(&critical_times);
+	now = trace_clock_local();
+	critical_stop(&cs->preemptoff, LATENCY_HIST_PREEMPTOFF, now);
+	if (!raw_irqs_disabled_flags(flags))
+		critical_stop(&cs->preemptirqsoff,
+			      LATENCY_HIST_PREEMPTIRQSOFF, now);
+	raw_local_irq_restore(flags);
+}
+
+/* Idle stops the timings around the wait, which is no latency */
+void __latency_hist_stop_timings(void)
+{
+	struct critical_times *cs;
+	unsigned long flags;
+
+	raw_local_irq_save(flags);
+	cs = this_cpu_ptr(&critical_times);
+	memset(cs, 0, sizeof(*cs));
+	raw_local_irq_restore(flags);
+}
+
+void __latency_hist_start_timings(void)
+{
+	struct critical_times *cs;
+	unsigned long flags;
+	u64 now;
+
+	raw_local_irq_save(flags);
+	cs = this_cpu_ptr(&critical_times);
+	now = trace_clock_local();
+	if (raw_irqs_disabled_flags(flags))
+		critical_start(&cs->irqsoff, LATENCY_HIST_IRQSOFF, now);
+	if (preempt_count())
+		critical_start(&cs->preemptoff, LATENCY_HIST_PREEMPTOFF, now);
+	critical_start(&cs->preemptirqsoff, LATENCY_HIST_PREEMPTIRQSOFF, now);
+	raw_local_irq_restore(flags);
+}
+
+static void wakeup_start_reset(struct wakeup_start *ws)
+{
+	if (ws->task)
+		put_task_struct(ws->task);
+	ws->task = NULL;
+}
+
+static void probe_hist_wakeup(void *ignore, struct task_struct *p, int success)
+{
+	struct wakeup_start *ws;
+	unsigned long flags;
+
+	if (!success)
+		return;
+
+	ws = per_cpu_ptr(&wakeup_starts, task_cpu(p));
+	local_irq_save(flags);
+	arch_spin_lock(&ws->lock);
+	if (!ws->task || p->prio < ws->task->prio) {
+		wakeup_start_reset(ws);
+		get_task_struct(p);
+		ws->task = p;
+		ws->start = trace_clock_local();
+	}
+	arch_spin_unlock(&ws->lock);
+	local_irq_restore(flags);
+}
+
+/* A task woken up here and run elsewhere is not followed any further */
+static void
+probe_hist_migrate_task(void *ignore, struct task_struct *p, int cpu)
+{
+	struct wakeup_start *ws = per_cpu_ptr(&wakeup_starts, task_cpu(p));
+	unsigned long flags;
+
+	if (ACCESS_ONCE(ws->task) != p)
+		return;
+
+	local_irq_save(flags);
+	arch_spin_lock(&ws->lock);
+	if (ws->task == p)
+		wakeup_start_reset(ws);
+	arch_spin_unlock(&ws->lock);
+	local_irq_restore(flags);
+}
+
+static void probe_hist_sched_switch(void *ignore, struct task_struct *prev,
+				    struct task_struct *next)
+{
+	struct wakeup_start *ws = this_cpu_ptr(&wakeup_starts);
+	unsigned long flags;
+
+	if (ACCESS_ONCE(ws->task) != next)
+		return;
+
+	local_irq_save(flags);
+	arch_spin_lock(&ws->lock);
+	if (ws->task == next) {
+		latency_hist_add(LATENCY_HIST_WAKEUP,
+				 trace_clock_local() - ws->start);
+		wakeup_start_reset(ws);
+	}
+	arch_spin_unlock(&ws->lock);
+	local_irq_restore(flags);
+}
+
+static int wakeup_hist_register(void)
+{
+	int ret;
+
+	ret = register_trace_sched_wakeup(probe_hist_wakeup, NULL);
+	if (ret)
+		return ret;
+	ret = register_trace_sched_wakeup_new(probe_hist_wakeup, NULL);
+	if (ret)
+		goto fail_wakeup;
+	ret = register_trace_sched_migrate_task(probe_hist_migrate_task, NULL);
+	if (ret)
+		goto fail_wakeup_new;
+	ret = register_trace_sched_switch(probe_hist_sched_switch, NULL);
+	if (ret)
+		goto fail_migrate;
+	return 0;
+
+fail_migrate:
+	unregister_trace_sched_migrate_task(probe_hist_migrate_task, NULL);
+fail_wakeup_new:
+	unregister_trace_sched_wakeup_new(probe_hist_wakeup, NULL);
+fail_wakeup:
+	unregister_trace_sched_wakeup(probe_hist_wakeup, NULL);
+	return ret;
+}
+
+static void wakeup_hist_unregister(void)
+{
+	struct wakeup_start *ws;
+	unsigned long flags;
+	int cpu;
+
+	unregister_trace_sched_switch(probe_hist_sched_switch, NULL);
+	unregister_trace_sched_migrate_task(probe_hist_migrate_task, NULL);
+	unregister_trace_sched_wakeup_new(probe_hist_wakeup, NULL);
+	unregister_trace_sched_wakeup(probe_hist_wakeup, NULL);
+	tracepoint_synchronize_unregister();
+
+	for_each_possible_cpu(cpu) {
+		ws = per_cpu_ptr(&wakeup_starts, cpu);
+		local_irq_save(flags);
+		arch_spin_lock(&ws->lock);
+		wakeup_start_reset(ws);
+		arch_spin_unlock(&ws->lock);
+		local_irq_restore(flags);
+	}
+}
+
+/* Sections started before the histogram was last disabled are stale */
+static void critical_start_reset_cpu(void *unused)
+{
+	memset(this_cpu_ptr(&critical_times), 0,
+	       sizeof(struct critical_times));
+}
+
+static int latency_hist_set_enabled(enum latency_hist_type type, bool enable)
+{
+	int ret = 0;
+
+	mutex_lock(&latency_hist_enable_lock);
+	if (latency_hist_enabled[type] == enable)
+		goto out;
+
+	if (type == LATENCY_HIST_WAKEUP) {
+		if (enable)
+			ret = wakeup_hist_register();
+		else
+			wakeup_hist_unregister();
+		if (!ret)
+			latency_hist_enabled[type] = enable;
+		goto out;
+	}
+
+	if (enable) {
+		get_online_cpus();
+		on_each_cpu(critical_start_reset_cpu, NULL, 1);
+		put_online_cpus();
+		latency_hist_enabled[type] = true;
+		static_key_slow_inc(&latency_hist_critical_key);
+	} else {
+		latency_hist_enabled[type] = false;
+		static_key_slow_dec(&latency_hist_critical_key);
+	}
+out:
+	mutex_unlock(&latency_hist_enable_lock);
+	return ret;
+}
+
+static ssize_t
+latency_hist_enable_read(struct file *filp, char __user *ubuf,
+			 size_t cnt, loff_t *ppos)
+{
+	long type = (long)filp->private_data;
+	char buf[4];
+	int r;
+
+	r = sprintf(buf, "%d\n", latency_hist_enabled[type]);
+	return simple_read_from_buffer(ubuf, cnt, ppos, buf, r);
+}
+
+static ssize_t
+latency_hist_enable_write(struct file *filp, const char __user *ubuf,
+			  size_t cnt, loff_t *ppos)
+{
+	long type = (long)filp->private_data;
+	unsigned long val;
+	int ret;
+
+	ret = kstrtoul_from_user(ubuf, cnt, 10, &val);
+	if (ret)
+		return ret;
+
+	ret = latency_hist_set_enabled(type, !!val);
+	if (ret)
+		return ret;
+
+	*ppos += cnt;
+	return cnt;
+}
+
+static const struct file_operations latency_hist_enable_fops = {
+	.open		= tracing_open_generic,
+	.read		= latency_hist_enable_read,
+	.write		= latency_hist_enable_write,
+	.llseek		= generic_file_llseek,
+};
+
+/* The irqs and preempt hooks only exist with the matching tracer built */
+static bool latency_hist_supported(enum latency_hist_type type)
+{
+	switch (type) {
+	case LATENCY_HIST_IRQSOFF:
+		return IS_ENABLED(CONFIG_IRQSOFF_TRACER);
+	case LATENCY_HIST_PREEMPTOFF:
+		return IS_ENABLED(CONFIG_PREEMPT_TRACER);
+	case LATENCY_HIST_PREEMPTIRQSOFF:
+		return IS_ENABLED(CONFIG_IRQSOFF_TRACER) &&
+		       IS_ENABLED(CONFIG_PREEMPT_TRACER);
+	default:
+		return true;
+	}
+}
+
+/* The seq_file private data: type in the low byte, cpu + 1 above, 0 for all */
+#define HIST_ALL_CPUS		0
+#define hist_priv(type, cpu)	((void *)(long)(((cpu) << 8) | (type)))
+#define hist_priv_type(p)	((long)(p) & 0xff)
+#define hist_priv_cpu(p)	((long)(p) >> 8)
+
+static void latency_hist_sum(struct latency_hist *sum, int type, int cpu)
+{
+	struct latency_hist *hist;
+	int i;
+
+	hist = per_cpu_ptr(&latency_hists[type], cpu);
+	for (i = 0; i < LATENCY_HIST_BUCKETS; i++)
+		sum->buckets[i] += ACCESS_ONCE(hist->buckets[i]);
+	sum->samples += ACCESS_ONCE(hist->samples);
+	sum->total += hist->total;
+	sum->max = max(sum->max, hist->max);
+}
+
+static int latency_hist_show(struct seq_file *m, void *v)
+{
+	int type = hist_priv_type(m->private);
+	int cpu = hist_priv_cpu(m->private);
+	struct latency_hist sum;
+	int i, last = 0;
+
+	memset(&sum, 0, sizeof(sum));
+	if (cpu == HIST_ALL_CPUS) {
+		for_each_possible_cpu(i)
+			latency_hist_sum(&sum, type, i);
+	} else {
+		latency_hist_sum(&sum, type, cpu - 1);
+	}
+
+	for (i = 0; i < LATENCY_HIST_BUCKETS; i++) {
+		if (sum.buckets[i])
+			last = i;
+	}
+
+	seq_printf(m, "# %s latency", latency_hist_names[type]);
+	if (cpu != HIST_ALL_CPUS)
+		seq_printf(m, ", cpu %d", cpu - 1);
+	seq_printf(m, "\n# samples: %lu\n", sum.samples);
+	seq_printf(m, "# avg: %llu usecs\n", sum.samples ?
+		   div_u64(div64_u64(sum.total, sum.samples), NSEC_PER_USEC) : 0);
+	seq_printf(m, "# max: %llu usecs\n", div_u64(sum.max, NSEC_PER_USEC));
+	seq_puts(m, "#\n#       usecs             count\n");
+
+	for (i = 0; i <= last; i++) {
+		unsigned long from = i ? 1UL << (i - 1) : 0;
+
+		if (i == LATENCY_HIST_BUCKETS - 1)
+			seq_printf(m, "%10lu -     inf %10lu\n",
+				   from, sum.buckets[i]);
+		else
+			seq_printf(m, "%10lu - %7lu %10lu\n",
+				   from, 1UL << i, sum.buckets[i]);
+	}
+
+	return 0;
+}
+
+static int latency_hist_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, latency_hist_show, inode->i_private);
+}
+
+static const struct file_operations latency_hist_fops = {
+	.open		= latency_hist_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void latency_hist_reset_cpu(void *unused)
+{
+	memset(this_cpu_ptr(latency_hists), 0, sizeof(latency_hists));
+}
+
+static ssize_t
+latency_hist_reset_write(struct file *filp, const char __user *ubuf,
+			 size_t cnt, loff_t *ppos)
+{
+	int cpu;
+
+	/* offline cpus don't account, clear them from here */
+	get_online_cpus();
+	for_each_possible_cpu(cpu) {
+		if (!cpu_online(cpu))
+			memset(per_cpu_ptr(latency_hists, cpu), 0,
+			       sizeof(latency_hists));
+	}
+	on_each_cpu(latency_hist_reset_cpu, NULL, 1);
+	put_online_cpus();
+
+	*ppos += cnt;
+	return cnt;
+}
+
+static const struct file_operations latency_hist_reset_fops = {
+	.open		= tracing_open_generic,
+	.write		= latency_hist_reset_write,
+	.llseek		= generic_file_llseek,
+};
+
+static __init int latency_hist_init(void)
+{
+	struct dentry *d_tracer, *d_hist, *d_type;
+	char name[16];
+	int type, cpu;
+
+	d_tracer = tracing_init_dentry();
+	if (!d_tracer)
+		return 0;
+
+	d_hist = debugfs_create_dir("latency_hist", d_tracer);
+	if (!d_hist) {
+		pr_warning("Could not create debugfs 'latency_hist' entry\n");
+		return 0;
+	}
+
+	trace_create_file("reset", 0200, d_hist, NULL,
+			  &latency_hist_reset_fops);
+
+	for (type = 0; type < LATENCY_HIST_MAX; type++) {
+		if (!latency_hist_supported(type))
+			continue;
+
+		d_type = debugfs_create_dir(latency_hist_names[type], d_hist);
+		if (!d_type)
+			continue;
+
+		trace_create_file("enable", 0644, d_type, (void *)(long)type,
+				  &latency_hist_enable_fops);
+
+		trace_create_file("total", 0444, d_type,
+				  hist_priv(type, HIST_ALL_CPUS),
+				  &latency_hist_fops);
+
+		for_each_possible_cpu(cpu) {
+			snprintf(name, sizeof(name), "cpu%d", cpu);
+			trace_create_file(name, 0444, d_type,
+					  hist_priv(type, cpu + 1),
+					  &latency_hist_fops);
+		}
+	}
+
+	return 0;
+}
+fs_initcall(latency_hist_init);
@@ -0,0 +1,341 @@
+/*
+ * Testsuite and micro-benchmark for the socket filter interpreter.
+ *
+ * Every program is loaded through sk_unattached_filter_create(), so it is
+ * checked and translated exactly like a filter attached from user space,
+ * run once against a synthetic packet to verify its result, and then
+ * timed through sk_run_filter() directly, through sk_run_filter_int() on
+ * its sk_convert_filter() translation and through SK_RUN_FILTER() (the
+ * JIT when one is enabled, else the internal interpreter).
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/filter.h>
+#include <linux/skbuff.h>
+#include <linux/netdevice.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <linux/in.h>
+#include <linux/ktime.h>
+#include <linux/slab.h>
+
+static unsigned int runs = 1000000;
+module_param(runs, uint, 0444);
+MODULE_PARM_DESC(runs, "Number of timed runs per program");
+
+#define MAX_INSNS	32
+
+struct bpf_test {
+	const char *descr;
+	struct sock_filter insns[MAX_INSNS];
+	unsigned int len;
+	/* instructions executed on the test packet, for the per-insn cost */
+	unsigned int executed;
+	u32 result;
+};
+
+/* Ethernet + IPv4 + TCP header, from port 0x1234 to port 22 */
+static const u8 test_pkt[] = {
+	0x00, 0x11, 0x22, 0x33, 0x44, 0x55,
+	0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb,
+	0x08, 0x00,
+	0x45, 0x00, 0x00, 0x28, 0x00, 0x00, 0x00, 0x00,
+	0x40, 0x06, 0x00, 0x00, 0x0a, 0x00, 0x00, 0x01,
+	0x0a, 0x00, 0x00, 0x02,
+	0x12, 0x34, 0x00, 0x16, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x50, 0x02, 0x20, 0x00,
+	0x00, 0x00, 0x00, 0x00,
+};
+
+static struct bpf_test tests[] = {
+	{
+		"tcpdump 'tcp port 22'",
+		{
+			BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 12),
+			BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ETH_P_IPV6, 0, 6),
+			BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 20),
+			BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_TCP, 0, 15),
+			BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 54),
+			BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 22, 12, 0),
+			BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 56),
+			BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 22, 10, 11),
+			BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ETH_P_IP, 0, 10),
+			BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 23),
+			BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_TCP, 0, 8),
+			BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 20),
+			BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 0x1fff, 6, 0),
+			BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, 14),
+			BPF_STMT(BPF_LD | BPF_H | BPF_IND, 14),
+			BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 22, 2, 0),
+			BPF_STMT(BPF_LD | BPF_H | BPF_IND, 16),
+			BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 22, 0, 1),
+			BPF_STMT(BPF_RET | BPF_K, 0xffff),
+			BPF_STMT(BPF_RET | BPF_K, 0),
+		},
+		20, 13, 0xffff,
+	},
+	{
+		"ALU chain",
+		{
+			BPF_STMT(BPF_LD | BPF_IMM, 1),
+			BPF_STMT(BPF_ALU | BPF_ADD | BPF_K, 2),
+			BPF_STMT(BPF_ALU | BPF_MUL | BPF_K, 3),
+			BPF_STMT(BPF_ALU | BPF_SUB | BPF_K, 1),
+			BPF_STMT(BPF_ALU | BPF_LSH | BPF_K, 4),
+			BPF_STMT(BPF_ALU | BPF_RSH | BPF_K, 1),
+			BPF_STMT(BPF_ALU | BPF_OR | BPF_K, 1),
+			BPF_STMT(BPF_ALU | BPF_AND | BPF_K, 0x3f),
+			BPF_STMT(BPF_ALU | BPF_XOR | BPF_K, 0xff),
+			BPF_STMT(BPF_ALU | BPF_DIV | BPF_K, 2),
+			BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, 100),
+			BPF_STMT(BPF_ALU | BPF_NEG, 0),
+			BPF_STMT(BPF_MISC | BPF_TAX, 0),
+			BPF_STMT(BPF_MISC | BPF_TXA, 0),
+			BPF_STMT(BPF_RET | BPF_A, 0),
+		},
+		15, 15, -27U,
+	},
+	{
+		"scratch memory",
+		{
+			BPF_STMT(BPF_LD | BPF_IMM, 10),
+			BPF_STMT(BPF_ST, 0),
+			BPF_STMT(BPF_LDX | BPF_MEM, 0),
+			BPF_STMT(BPF_LD | BPF_IMM, 5),
+			BPF_STMT(BPF_ALU | BPF_ADD | BPF_X, 0),
+			BPF_STMT(BPF_ST, 1),
+			BPF_STMT(BPF_LD | BPF_MEM, 0),
+			BPF_STMT(BPF_LDX | BPF_MEM, 1),
+			BPF_STMT(BPF_ALU | BPF_SUB | BPF_X, 0),
+			BPF_STMT(BPF_RET | BPF_A, 0),
+		},
+		10, 10, -5U,
+	},
+	{
+		"ancillary protocol and length",
+		{
+			BPF_STMT(BPF_LD | BPF_H | BPF_ABS,
+				 SKF_AD_OFF + SKF_AD_PROTOCOL),
+			BPF_STMT(BPF_MISC | BPF_TAX, 0),
+			BPF_STMT(BPF_LD | BPF_W | BPF_LEN, 0),
+			BPF_STMT(BPF_ALU | BPF_ADD | BPF_X, 0),
+			BPF_STMT(BPF_RET | BPF_A, 0),
+		},
+		5, 5, ETH_P_IP + sizeof(test_pkt),
+	},
+	{
+		"out of bounds load",
+		{
+			BPF_STMT(BPF_LD | BPF_W | BPF_ABS, 1000),
+			BPF_STMT(BPF_RET | BPF_K, 1),
+		},
+		2, 1, 0,
+	},
+	{
+		"negative immediate compare",
+		{
+			BPF_STMT(BPF_LD | BPF_IMM, 0xfffffffe),
+			BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0xfffffffe, 0, 2),
+			BPF_JUMP(BPF_JMP | BPF_JGT | BPF_K, 0xfffffffd, 0, 1),
+			BPF_STMT(BPF_RET | BPF_K, 1),
+			BPF_STMT(BPF_RET | BPF_K, 2),
+		},
+		5, 4, 1,
+	},
+	{
+		"jump if false",
+		{
+			BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 12),
+			BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ETH_P_IP, 0, 1),
+			BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, ETH_P_IP, 1, 2),
+			BPF_STMT(BPF_RET | BPF_K, 1),
+			BPF_STMT(BPF_RET | BPF_K, 2),
+			BPF_STMT(BPF_RET | BPF_K, 3),
+		},
+		6, 4, 2,
+	},
+	{
+		"ancillary ifindex without device",
+		{
+			BPF_STMT(BPF_LD | BPF_IMM, 1),
+			BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+				 SKF_AD_OFF + SKF_AD_IFINDEX),
+			BPF_STMT(BPF_RET | BPF_K, 1),
+		},
+		3, 2, 0,
+	},
+	{
+		"ancillary pkttype and vlan",
+		{
+			BPF_STMT(BPF_LD | BPF_B | BPF_ABS,
+				 SKF_AD_OFF + SKF_AD_PKTTYPE),
+			BPF_STMT(BPF_MISC | BPF_TAX, 0),
+			BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+				 SKF_AD_OFF + SKF_AD_VLAN_TAG_PRESENT),
+			BPF_STMT(BPF_ALU | BPF_ADD | BPF_X, 0),
+			BPF_STMT(BPF_ALU | BPF_ADD | BPF_K, 10),
+			BPF_STMT(BPF_RET | BPF_A, 0),
+		},
+		6, 6, PACKET_OTHERHOST + 10,
+	},
+};
+
+static struct sk_buff *populate_skb(void)
+{
+	struct sk_buff *skb;
+
+	skb = alloc_skb(sizeof(test_pkt), GFP_KERNEL);
+	if (!skb)
+		return NULL;
+
+	memcpy(skb_put(skb, sizeof(test_pkt)), test_pkt, sizeof(test_pkt));
+	skb_reset_mac_header(skb);
+	skb_set_network_header(skb, ETH_HLEN);
+	skb->protocol = htons(ETH_P_IP);
+	skb->pkt_type = PACKET_OTHERHOST;
+
+	return skb;
+}
+
+enum run_mode {
+	RUN_CLASSIC,
+	RUN_INTERNAL,
+	RUN_SK_RUN_FILTER,
+};
+
+static u64 time_filter(struct sk_filter *fp, struct sock_filter_int *insnsi,
+		       struct sk_buff *skb, enum run_mode mode)
+{
+	ktime_t start, end;
+	unsigned int i;
+
+	start = ktime_get();
+	switch (mode) {
+	case RUN_CLASSIC:
+		for (i = 0; i < runs; i++)
+			sk_run_filter(skb, fp->insns);
+		break;
+	case RUN_INTERNAL:
+		for (i = 0; i < runs; i++)
+			sk_run_filter_int(skb, insnsi);
+		break;
+	case RUN_SK_RUN_FILTER:
+		for (i = 0; i < runs; i++)
+			SK_RUN_FILTER(fp, skb);
+		break;
+	}
+	end = ktime_get();
+
+	return ktime_to_ns(ktime_sub(end, start));
+}
+
+static int run_one(struct bpf_test *t, struct sk_buff *skb)
+{
+	struct sock_fprog fprog = {
+		.len = t->len,
+		.filter = t->insns,
+	};
+	struct sock_filter_int *insnsi;
+	u64 interp, internal, native;
+	struct sk_filter *fp;
+	u32 ret;
+	int err;
+
+	err = sk_unattached_filter_create(&fp, &fprog);
+	if (err) {
+		pr_err("%s: filter rejected: %d\n", t->descr, err);
+		return err;
+	}
+
+	ret = sk_run_filter(skb, fp->insns);
+	if (ret != t->result) {
+		pr_err("%s: returned %u, expected %u\n",
+		       t->descr, ret, t->result);
+		err = -EINVAL;
+		goto out;
+	}
+
+	/* the filter keeps its own translation only when not JITed */
+	insnsi = sk_convert_filter_alloc(fp->insns, fp->len);
+	if (!insnsi) {
+		pr_err("%s: translation failed\n", t->descr);
+		err = -EINVAL;
+		goto out;
+	}
+
+	ret = sk_run_filter_int(skb, insnsi);
+	if (ret != t->result) {
+		pr_err("%s: internal returned %u, expected %u\n",
+		       t->descr, ret, t->result);
+		err = -EINVAL;
+		goto out_int;
+	}
+
+	ret = SK_RUN_FILTER(fp, skb);
+	if (ret != t->result) {
+		pr_err("%s: SK_RUN_FILTER returned %u, expected %u\n",
+		       t->descr, ret, t->result);
+		err = -EINVAL;
+		goto out_int;
+	}
+
+	interp = time_filter(fp, insnsi, skb, RUN_CLASSIC);
+	internal = time_filter(fp, insnsi, skb, RUN_INTERNAL);
+	native = time_filter(fp, insnsi, skb, RUN_SK_RUN_FILTER);
+
+	/* per-instruction cost in picoseconds, runs are a few ns each */
+	pr_info("%-32s %2u insns: classic %4llu ns/run %5llu ps/insn, internal %4llu ns/run, SK_RUN_FILTER %4llu ns/run\n",
+		t->descr, t->executed, div_u64(interp, runs),
+		div64_u64(interp * 1000, (u64)runs * t->executed),
+		div_u64(internal, runs), div_u64(native, runs));
+out_int:
+	kfree(insnsi);
+out:
+	sk_unattached_filter_destroy(fp);
+	return err;
+}
+
+static int __init test_bpf_init(void)
+{
+	struct sk_buff *skb;
+	int i, err = 0, failed = 0;
+
+	if (!runs)
+		return -EINVAL;
+
+	skb = populate_skb();
+	if (!skb)
+		return -ENOMEM;
+
+	for (i = 0; i < ARRAY_SIZE(tests); i++) {
+		if (run_one(&tests[i], skb))
+			failed++;
+		cond_resched();
+	}
+
+	kfree_skb(skb);
+
+	if (failed) {
+		pr_err("%d of %zu tests FAILED\n", failed, ARRAY_SIZE(tests));
+		err = -EINVAL;
+	} else {
+		pr_info("all %zu tests passed\n", ARRAY_SIZE(tests));
+	}
+
+	return err;
+}
+
+static void __exit test_bpf_exit(void)
+{
+}
+
+module_init(test_bpf_init);
+module_exit(test_bpf_exit);
+MODULE_LICENSE("GPL");
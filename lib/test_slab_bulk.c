@@ -0,0 +1,127 @@
+/*
+ * Micro-benchmark for the slab bulk allocation API.
+ *
+ * For a range of batch sizes, objects are allocated and freed from a
+ * dedicated cache, once one at a time with kmem_cache_alloc() and
+ * kmem_cache_free(), and once per batch with kmem_cache_alloc_bulk()
+ * and kmem_cache_free_bulk().  The average cost of an alloc+free pair
+ * is reported for both.  Batches larger than the per cpu slab exercise
+ * the refill slowpath as well.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/ktime.h>
+
+static unsigned int loops = 100000;
+module_param(loops, uint, 0444);
+MODULE_PARM_DESC(loops, "Number of timed batches per batch size");
+
+static unsigned int obj_size = 256;
+module_param(obj_size, uint, 0444);
+MODULE_PARM_DESC(obj_size, "Object size in bytes");
+
+static const unsigned int bulk_sizes[] = {
+	1, 2, 4, 8, 16, 30, 32, 64, 128, 158, 250,
+};
+
+#define MAX_BULK	250
+
+static u64 time_single(struct kmem_cache *s, void **objs, unsigned int nr)
+{
+	ktime_t start, end;
+	unsigned int i, j;
+
+	start = ktime_get();
+	for (i = 0; i < loops; i++) {
+		for (j = 0; j < nr; j++) {
+			objs[j] = kmem_cache_alloc(s, GFP_KERNEL);
+			if (!objs[j])
+				goto fail;
+		}
+		for (j = 0; j < nr; j++)
+			kmem_cache_free(s, objs[j]);
+	}
+	end = ktime_get();
+
+	return ktime_to_ns(ktime_sub(end, start));
+
+fail:
+	while (j--)
+		kmem_cache_free(s, objs[j]);
+	return 0;
+}
+
+static u64 time_bulk(struct kmem_cache *s, void **objs, unsigned int nr)
+{
+	ktime_t start, end;
+	unsigned int i;
+
+	start = ktime_get();
+	for (i = 0; i < loops; i++) {
+		if (!kmem_cache_alloc_bulk(s, GFP_KERNEL, nr, objs))
+			return 0;
+		kmem_cache_free_bulk(s, nr, objs);
+	}
+	end = ktime_get();
+
+	return ktime_to_ns(ktime_sub(end, start));
+}
+
+static int __init test_slab_bulk_init(void)
+{
+	struct kmem_cache *s;
+	void **objs;
+	u64 single, bulk;
+	int i, err = 0;
+
+	if (!loops || !obj_size)
+		return -EINVAL;
+
+	objs = kcalloc(MAX_BULK, sizeof(void *), GFP_KERNEL);
+	if (!objs)
+		return -ENOMEM;
+
+	s = kmem_cache_create("test_slab_bulk", obj_size, 0, 0, NULL);
+	if (!s) {
+		err = -ENOMEM;
+		goto out_free;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(bulk_sizes); i++) {
+		unsigned int nr = bulk_sizes[i];
+
+		single = time_single(s, objs, nr);
+		bulk = time_bulk(s, objs, nr);
+		if (!single || !bulk) {
+			pr_err("bulk %3u: allocation failed\n", nr);
+			err = -ENOMEM;
+			break;
+		}
+
+		pr_info("bulk %3u: single %4llu ns/obj, bulk %4llu ns/obj\n",
+			nr, div64_u64(single, (u64)loops * nr),
+			div64_u64(bulk, (u64)loops * nr));
+		cond_resched();
+	}
+
+	kmem_cache_destroy(s);
+out_free:
+	kfree(objs);
+	return err;
+}
+
+static void __exit test_slab_bulk_exit(void)
+{
+}
+
+module_init(test_slab_bulk_init);
+module_exit(test_slab_bulk_exit);
+MODULE_LICENSE("GPL");
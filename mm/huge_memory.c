@@ -21,6 +21,8 @@
 #include <linux/pagemap.h>
 #include <linux/migrate.h>
 #include <linux/hashtable.h>
+#include <linux/userfaultfd_k.h>
+#include <linux/shmem_fs.h>
 
 #include <asm/tlb.h>
 #include <asm/pgalloc.h>
@@ -405,6 +407,9 @@ static struct attribute *hugepage_attr[] = {
 	&enabled_attr.attr,
 	&defrag_attr.attr,
 	&use_zero_page_attr.attr,
+#ifdef CONFIG_TRANSPARENT_HUGE_PAGECACHE
+	&shmem_enabled_attr.attr,
+#endif
 #ifdef CONFIG_DEBUG_VM
 	&debug_cow_attr.attr,
 #endif
@@ -796,6 +801,9 @@ int do_huge_pmd_anonymous_page(struct mm_struct *mm, struct vm_area_struct *vma,
 		return VM_FAULT_OOM;
 	if (unlikely(khugepaged_enter(vma)))
 		return VM_FAULT_OOM;
+	/* Let handle_pte_fault() deliver the missing page to userland */
+	if (userfaultfd_missing(vma))
+		return VM_FAULT_FALLBACK;
 	if (!(flags & FAULT_FLAG_WRITE) &&
 			transparent_hugepage_use_zero_page()) {
 		spinlock_t *ptl;
@@ -843,6 +851,43 @@ int do_huge_pmd_anonymous_page(struct mm_struct *mm, struct vm_area_struct *vma,
 	return 0;
 }
 
+/*
+ * Map a locked huge page of the page cache with a huge pmd.  No page
+ * table is deposited: the pmd is just cleared to split it.  On success
+ * the caller's reference to the page is taken over by the mapping;
+ * VM_FAULT_NOPAGE means the pmd got populated from under us.
+ */
+int do_set_pmd(struct vm_area_struct *vma, unsigned long address,
+	       pmd_t *pmd, struct page *page)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	unsigned long haddr = address & HPAGE_PMD_MASK;
+	spinlock_t *ptl;
+	pmd_t entry;
+
+	VM_BUG_ON_PAGE(!PageTransHuge(page), page);
+	VM_BUG_ON_PAGE(!PageLocked(page), page);
+
+	entry = mk_huge_pmd(page, vma->vm_page_prot);
+	/* shared mappings are not copied on write: map it writable */
+	if (vma->vm_flags & VM_WRITE)
+		entry = pmd_mkwrite(pmd_mkdirty(entry));
+
+	ptl = pmd_lock(mm, pmd);
+	if (unlikely(!pmd_none(*pmd))) {
+		spin_unlock(ptl);
+		return VM_FAULT_NOPAGE;
+	}
+	page_add_file_rmap(page);
+	add_mm_counter(mm, MM_FILEPAGES, HPAGE_PMD_NR);
+	set_pmd_at(mm, haddr, pmd, entry);
+	update_mmu_cache_pmd(vma, haddr, pmd);
+	spin_unlock(ptl);
+
+	count_vm_event(THP_FILE_MAPPED);
+	return 0;
+}
+
 int copy_huge_pmd(struct mm_struct *dst_mm, struct mm_struct *src_mm,
 		  pmd_t *dst_pmd, pmd_t *src_pmd, unsigned long addr,
 		  struct vm_area_struct *vma)
@@ -900,6 +945,12 @@ int copy_huge_pmd(struct mm_struct *dst_mm, struct mm_struct *src_mm,
 	}
 	src_page = pmd_page(pmd);
 	VM_BUG_ON_PAGE(!PageHead(src_page), src_page);
+	if (!PageAnon(src_page)) {
+		/* page cache is not copied: the child faults it in */
+		pte_free(dst_mm, pgtable);
+		ret = 0;
+		goto out_unlock;
+	}
 	get_page(src_page);
 	page_dup_rmap(src_page);
 	add_mm_counter(dst_mm, MM_ANONPAGES, HPAGE_PMD_NR);
@@ -1420,7 +1471,7 @@ int zap_huge_pmd(struct mmu_gather *tlb, struct vm_area_struct *vma,
 
 	if (__pmd_trans_huge_lock(pmd, vma, &ptl) == 1) {
 		struct page *page;
-		pgtable_t pgtable;
+		pgtable_t pgtable = NULL;
 		pmd_t orig_pmd;
 		/*
 		 * For architectures like ppc64 we look at deposited pgtable
@@ -1430,22 +1481,37 @@ int zap_huge_pmd(struct mmu_gather *tlb, struct vm_area_struct *vma,
 		 */
 		orig_pmd = pmdp_get_and_clear(tlb->mm, addr, pmd);
 		tlb_remove_pmd_tlb_entry(tlb, pmd, addr);
-		pgtable = pgtable_trans_huge_withdraw(tlb->mm, pmd);
 		if (is_huge_zero_pmd(orig_pmd)) {
+			pgtable = pgtable_trans_huge_withdraw(tlb->mm, pmd);
 			atomic_long_dec(&tlb->mm->nr_ptes);
 			spin_unlock(ptl);
 			put_huge_zero_page();
 		} else {
 			page = pmd_page(orig_pmd);
+			if (PageAnon(page)) {
+				pgtable = pgtable_trans_huge_withdraw(tlb->mm,
+								      pmd);
+				add_mm_counter(tlb->mm, MM_ANONPAGES,
+					       -HPAGE_PMD_NR);
+				atomic_long_dec(&tlb->mm->nr_ptes);
+			} else {
+				/* No page table is deposited for page cache */
+				if (pmd_dirty(orig_pmd))
+					set_page_dirty(page);
+				if (pmd_young(orig_pmd) &&
+				    likely(!(vma->vm_flags & VM_SEQ_READ)))
+					mark_page_accessed(page);
+				add_mm_counter(tlb->mm, MM_FILEPAGES,
+					       -HPAGE_PMD_NR);
+			}
 			page_remove_rmap(page);
 			VM_BUG_ON_PAGE(page_mapcount(page) < 0, page);
-			add_mm_counter(tlb->mm, MM_ANONPAGES, -HPAGE_PMD_NR);
 			VM_BUG_ON_PAGE(!PageHead(page), page);
-			atomic_long_dec(&tlb->mm->nr_ptes);
 			spin_unlock(ptl);
 			tlb_remove_page(tlb, page);
 		}
-		pte_free(tlb->mm, pgtable);
+		if (pgtable)
+			pte_free(tlb->mm, pgtable);
 		ret = 1;
 	}
 	return ret;
@@ -1509,7 +1575,9 @@ int move_huge_pmd(struct vm_area_struct *vma, struct vm_area_struct *new_vma,
 		pmd = pmdp_get_and_clear(mm, old_addr, old_pmd);
 		VM_BUG_ON(!pmd_none(*new_pmd));
 
-		if (pmd_move_must_withdraw(new_ptl, old_ptl)) {
+		/* No page table is deposited for page cache */
+		if (pmd_move_must_withdraw(new_ptl, old_ptl) &&
+		    !vma->vm_ops) {
 			pgtable_t pgtable;
 			pgtable = pgtable_trans_huge_withdraw(mm, old_pmd);
 			pgtable_trans_huge_deposit(mm, new_pmd, pgtable);
@@ -1545,7 +1613,9 @@ int change_huge_pmd(struct vm_area_struct *vma, pmd_t *pmd,
 				entry = pmd_mknonnuma(entry);
 			entry = pmd_modify(entry, newprot);
 			ret = HPAGE_PMD_NR;
-			BUG_ON(pmd_write(entry));
+			/* only shared mappings are made writable here */
+			BUG_ON(pmd_write(entry) &&
+			       !(vma->vm_flags & VM_SHARED));
 		} else {
 			struct page *page = pmd_page(*pmd);
 
@@ -1553,9 +1623,10 @@ int change_huge_pmd(struct vm_area_struct *vma, pmd_t *pmd,
 			 * Do not trap faults against the zero page. The
 			 * read-only data is likely to be read-cached on the
 			 * local CPU cache and it is less useful to know about
-			 * local vs remote hits on the zero page.
+			 * local vs remote hits on the zero page.  NUMA hinting
+			 * faults are not handled for page cache huge pages.
 			 */
-			if (!is_huge_zero_page(page) &&
+			if (!is_huge_zero_page(page) && PageAnon(page) &&
 			    !pmd_numa(*pmd)) {
 				entry = *pmd;
 				entry = pmd_mknuma(entry);
@@ -1685,11 +1756,17 @@ static void __split_huge_page_refcount(struct page *page,
 	struct zone *zone = page_zone(page);
 	struct lruvec *lruvec;
 	int tail_count = 0;
+	/* a huge page of the page cache, unless truncated meanwhile */
+	struct address_space *mapping = PageAnon(page) ? NULL : page->mapping;
 
 	/* prevent PageLRU to go away from under us, and freeze lru stats */
 	spin_lock_irq(&zone->lru_lock);
 	lruvec = mem_cgroup_page_lruvec(page, zone);
 
+	/* keep page cache lookups from seeing a half split page */
+	if (mapping)
+		spin_lock(&mapping->tree_lock);
+
 	compound_lock(page);
 	/* complete memcg works before add pages to LRU */
 	mem_cgroup_split_huge_fixup(page);
@@ -1718,6 +1795,9 @@ static void __split_huge_page_refcount(struct page *page,
 		 */
 		atomic_add(page_mapcount(page) + page_mapcount(page_tail) + 1,
 			   &page_tail->_count);
+		/* and takes over the reference of its page cache slot */
+		if (mapping)
+			atomic_inc(&page_tail->_count);
 
 		/* after clearing PageTail the gup refcount can be released */
 		smp_mb();
@@ -1762,20 +1842,37 @@ static void __split_huge_page_refcount(struct page *page,
 		page_tail->index = page->index + i;
 		page_cpupid_xchg_last(page_tail, page_cpupid_last(page));
 
-		BUG_ON(!PageAnon(page_tail));
+		BUG_ON(PageAnon(page_tail) != PageAnon(page));
 		BUG_ON(!PageUptodate(page_tail));
 		BUG_ON(!PageDirty(page_tail));
 		BUG_ON(!PageSwapBacked(page_tail));
 
 		lru_add_page_tail(page, page_tail, lruvec, list);
+
+		if (mapping) {
+			void **slot;
+
+			slot = radix_tree_lookup_slot(&mapping->page_tree,
+						      page_tail->index);
+			VM_BUG_ON_PAGE(radix_tree_deref_slot_protected(slot,
+					&mapping->tree_lock) != page, page);
+			radix_tree_replace_slot(slot, page_tail);
+		}
 	}
 	atomic_sub(tail_count, &page->_count);
+	if (mapping)
+		atomic_sub(HPAGE_PMD_NR - 1, &page->_count);
 	BUG_ON(atomic_read(&page->_count) <= 0);
 
-	__mod_zone_page_state(zone, NR_ANON_TRANSPARENT_HUGEPAGES, -1);
+	if (PageAnon(page))
+		__mod_zone_page_state(zone, NR_ANON_TRANSPARENT_HUGEPAGES, -1);
+	else if (mapping)
+		__mod_zone_page_state(zone, NR_SHMEM_THPS, -1);
 
 	ClearPageCompound(page);
 	compound_unlock(page);
+	if (mapping)
+		spin_unlock(&mapping->tree_lock);
 	spin_unlock_irq(&zone->lru_lock);
 
 	for (i = 1; i < HPAGE_PMD_NR; i++) {
@@ -1920,11 +2017,55 @@ static void __split_huge_page(struct page *page,
 	BUG_ON(mapcount != mapcount2);
 }
 
+/*
+ * A huge page of the page cache is only ever mapped by huge pmds: zap
+ * them, and let the small pages be faulted back in.  The page lock keeps
+ * the huge page from being mapped again meanwhile.
+ */
+static int split_huge_page_cache(struct page *page, struct list_head *list)
+{
+	struct address_space *mapping = page->mapping;
+	int i;
+
+	VM_BUG_ON_PAGE(!PageLocked(page), page);
+	BUG_ON(!PageSwapBacked(page));
+
+	if (!PageCompound(page))
+		return 0;
+
+	if (mapping)
+		unmap_mapping_range(mapping,
+				    (loff_t)page->index << PAGE_CACHE_SHIFT,
+				    HPAGE_PMD_SIZE, 0);
+	if (page_mapped(page))
+		return 1;
+
+	/*
+	 * shmem_fallocate() leaves a new huge page !Uptodate until it is
+	 * first used, and its contents are zeroes then.  The subpages take
+	 * PG_uptodate from the head, so initialize all of it before they
+	 * go their own ways.
+	 */
+	if (!PageUptodate(page)) {
+		for (i = 0; i < HPAGE_PMD_NR; i++) {
+			clear_highpage(page + i);
+			flush_dcache_page(page + i);
+		}
+		SetPageUptodate(page);
+	}
+
+	__split_huge_page_refcount(page, list);
+	count_vm_event(THP_SPLIT);
+	BUG_ON(PageCompound(page));
+	return 0;
+}
+
 /*
  * Split a hugepage into normal pages. This doesn't change the position of head
  * page. If @list is null, tail pages will be added to LRU list, otherwise, to
  * @list. Both head page and tail pages will inherit mapping, flags, and so on
- * from the hugepage.
+ * from the hugepage.  A hugepage of the page cache must be locked by the
+ * caller, and its tail pages take over its page cache slots.
  * Return 0 if the hugepage is split successfully otherwise return 1.
  */
 int split_huge_page_to_list(struct page *page, struct list_head *list)
@@ -1933,7 +2074,8 @@ int split_huge_page_to_list(struct page *page, struct list_head *list)
 	int ret = 1;
 
 	BUG_ON(is_huge_zero_page(page));
-	BUG_ON(!PageAnon(page));
+	if (!PageAnon(page))
+		return split_huge_page_cache(page, list);
 
 	/*
 	 * The caller does not necessarily hold an mmap_sem that would prevent
@@ -1969,13 +2111,18 @@ int hugepage_madvise(struct vm_area_struct *vma,
 		     unsigned long *vm_flags, int advice)
 {
 	struct mm_struct *mm = vma->vm_mm;
+	unsigned long no_thp = VM_NO_THP;
+
+	/* shared page cache can be mapped by huge pmds through ->pmd_fault */
+	if (vma->vm_ops && vma->vm_ops->pmd_fault)
+		no_thp &= ~(VM_SHARED | VM_MAYSHARE);
 
 	switch (advice) {
 	case MADV_HUGEPAGE:
 		/*
 		 * Be somewhat over-protective like KSM for now!
 		 */
-		if (*vm_flags & (VM_HUGEPAGE | VM_NO_THP))
+		if (*vm_flags & (VM_HUGEPAGE | no_thp))
 			return -EINVAL;
 		if (mm->def_flags & VM_NOHUGEPAGE)
 			return -EINVAL;
@@ -1993,7 +2140,7 @@ int hugepage_madvise(struct vm_area_struct *vma,
 		/*
 		 * Be somewhat over-protective like KSM for now!
 		 */
-		if (*vm_flags & (VM_NOHUGEPAGE | VM_NO_THP))
+		if (*vm_flags & (VM_NOHUGEPAGE | no_thp))
 			return -EINVAL;
 		*vm_flags &= ~VM_HUGEPAGE;
 		*vm_flags |= VM_NOHUGEPAGE;
@@ -2167,7 +2314,8 @@ static int __collapse_huge_page_isolate(struct vm_area_struct *vma,
 	     _pte++, address += PAGE_SIZE) {
 		pte_t pteval = *_pte;
 		if (pte_none(pteval)) {
-			if (++none <= khugepaged_max_ptes_none)
+			if (!userfaultfd_armed(vma) &&
+			    ++none <= khugepaged_max_ptes_none)
 				continue;
 			else
 				goto out;
@@ -2466,6 +2614,8 @@ static void collapse_huge_page(struct mm_struct *mm,
 	mmun_start = address;
 	mmun_end   = address + HPAGE_PMD_SIZE;
 	mmu_notifier_invalidate_range_start(mm, mmun_start, mmun_end);
+	/* keep speculative faults off the page table while it is unhooked */
+	vm_write_begin(vma);
 	pmd_ptl = pmd_lock(mm, pmd); /* probably unnecessary */
 	/*
 	 * After this gup_fast can't run anymore. This also removes
@@ -2492,6 +2642,7 @@ static void collapse_huge_page(struct mm_struct *mm,
 		 */
 		pmd_populate(mm, pmd, pmd_pgtable(_pmd));
 		spin_unlock(pmd_ptl);
+		vm_write_end(vma);
 		anon_vma_unlock_write(vma->anon_vma);
 		goto out;
 	}
@@ -2524,6 +2675,7 @@ static void collapse_huge_page(struct mm_struct *mm,
 	set_pmd_at(mm, address, pmd, _pmd);
 	update_mmu_cache_pmd(vma, address, pmd);
 	spin_unlock(pmd_ptl);
+	vm_write_end(vma);
 
 	*hpage = NULL;
 
@@ -2564,7 +2716,8 @@ static int khugepaged_scan_pmd(struct mm_struct *mm,
 	     _pte++, _address += PAGE_SIZE) {
 		pte_t pteval = *_pte;
 		if (pte_none(pteval)) {
-			if (++none <= khugepaged_max_ptes_none)
+			if (!userfaultfd_armed(vma) &&
+			    ++none <= khugepaged_max_ptes_none)
 				continue;
 			else
 				goto out_unmap;
@@ -2849,6 +3002,25 @@ static void __split_huge_zero_page_pmd(struct vm_area_struct *vma,
 	put_huge_zero_page();
 }
 
+/*
+ * Page cache huge pages are never mapped by ptes: just drop the huge pmd,
+ * the small pages are faulted in again as needed.
+ */
+static void __split_huge_file_pmd(struct vm_area_struct *vma,
+		unsigned long haddr, pmd_t *pmd)
+{
+	struct page *page;
+	pmd_t _pmd;
+
+	_pmd = pmdp_clear_flush(vma, haddr, pmd);
+	page = pmd_page(_pmd);
+	if (pmd_dirty(_pmd))
+		set_page_dirty(page);
+	page_remove_rmap(page);
+	add_mm_counter(vma->vm_mm, MM_FILEPAGES, -HPAGE_PMD_NR);
+	put_page(page);
+}
+
 void __split_huge_page_pmd(struct vm_area_struct *vma, unsigned long address,
 		pmd_t *pmd)
 {
@@ -2879,6 +3051,12 @@ again:
 	}
 	page = pmd_page(*pmd);
 	VM_BUG_ON_PAGE(!page_count(page), page);
+	if (!PageAnon(page)) {
+		__split_huge_file_pmd(vma, haddr, pmd);
+		spin_unlock(ptl);
+		mmu_notifier_invalidate_range_end(mm, mmun_start, mmun_end);
+		return;
+	}
 	get_page(page);
 	spin_unlock(ptl);
 	mmu_notifier_invalidate_range_end(mm, mmun_start, mmun_end);
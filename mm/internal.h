@@ -90,10 +90,24 @@ extern bool zone_reclaimable(struct zone *zone);
  */
 extern pmd_t *mm_find_pmd(struct mm_struct *mm, unsigned long address);
 
+/*
+ * in mm/nobootmem.c
+ */
+#ifdef CONFIG_ARCH_DISCARD_MEMBLOCK
+extern unsigned long free_memblock_arrays(void);
+#else
+static inline unsigned long free_memblock_arrays(void)
+{
+	return 0;
+}
+#endif
+
 /*
  * in mm/page_alloc.c
  */
-extern void __free_pages_bootmem(struct page *page, unsigned int order);
+extern void __free_pages_bootmem(struct page *page, unsigned long pfn,
+					unsigned int order);
+extern void reserve_bootmem_region(phys_addr_t start, phys_addr_t end);
 extern void prep_compound_page(struct page *page, unsigned long order);
 #ifdef CONFIG_MEMORY_FAILURE
 extern bool is_free_buddy_page(struct page *page);
@@ -125,6 +139,9 @@ struct compact_control {
 					 * no longer being updated
 					 */
 	bool finished_update_migrate;
+	bool proactive_compaction;	/* kcompactd proactive compaction */
+	unsigned long total_migrate_scanned;
+	unsigned long total_free_scanned;
 
 	int order;			/* order a direct compactor needs */
 	int migratetype;		/* MOVABLE, RECLAIMABLE etc */
@@ -60,6 +60,9 @@
 #include <linux/migrate.h>
 #include <linux/string.h>
 #include <linux/dma-debug.h>
+#include <linux/debugfs.h>
+#include <linux/userfaultfd_k.h>
+#include <linux/srcu.h>
 
 #include <asm/io.h>
 #include <asm/pgalloc.h>
@@ -1219,7 +1222,9 @@ static inline unsigned long zap_pmd_range(struct mmu_gather *tlb,
 		if (pmd_trans_huge(*pmd)) {
 			if (next - addr != HPAGE_PMD_SIZE) {
 #ifdef CONFIG_DEBUG_VM
-				if (!rwsem_is_locked(&tlb->mm->mmap_sem)) {
+				/* page cache is unmapped on truncation too */
+				if (!vma->vm_ops &&
+				    !rwsem_is_locked(&tlb->mm->mmap_sem)) {
 					pr_err("%s: mmap_sem is unlocked! addr=0x%lx end=0x%lx vma->vm_start=0x%lx vma->vm_end=0x%lx\n",
 						__func__, addr, end,
 						vma->vm_start,
@@ -2023,6 +2028,63 @@ long get_user_pages(struct task_struct *tsk, struct mm_struct *mm,
 }
 EXPORT_SYMBOL(get_user_pages);
 
+/**
+ * get_user_pages_unlocked() - pin user pages in memory, taking mmap_sem
+ * @tsk:	the task_struct to use for page fault accounting, or
+ *		NULL if faults are not to be recorded.
+ * @mm:		mm_struct of target mm
+ * @start:	starting user address
+ * @nr_pages:	number of pages from start to pin
+ * @write:	whether pages will be written to by the caller
+ * @force:	whether to force write access even if user mapping is
+ *		readonly.
+ * @pages:	array that receives pointers to the pages pinned, or NULL.
+ *
+ * Like get_user_pages(), but must be called without mmap_sem held. As
+ * the semaphore is taken internally, the page faults are allowed to
+ * drop it and be retried, which lets them block for as long as needed:
+ * a fault in a userfaultfd registered range for instance only
+ * completes once userland has provided the missing page.
+ */
+long get_user_pages_unlocked(struct task_struct *tsk, struct mm_struct *mm,
+			     unsigned long start, unsigned long nr_pages,
+			     int write, int force, struct page **pages)
+{
+	int flags = FOLL_TOUCH;
+	long ret, pages_done = 0;
+	int locked;
+
+	if (pages)
+		flags |= FOLL_GET;
+	if (write)
+		flags |= FOLL_WRITE;
+	if (force)
+		flags |= FOLL_FORCE;
+
+	down_read(&mm->mmap_sem);
+	for (;;) {
+		locked = 1;
+		ret = __get_user_pages(tsk, mm, start, nr_pages, flags, pages,
+				       NULL, &locked);
+		if (ret > 0) {
+			pages_done += ret;
+			nr_pages -= ret;
+			start += ret << PAGE_SHIFT;
+			if (pages)
+				pages += ret;
+		}
+		if (locked || ret < 0 || !nr_pages)
+			break;
+		/* VM_FAULT_RETRY dropped mmap_sem, take it again and go on */
+		down_read(&mm->mmap_sem);
+	}
+	if (locked)
+		up_read(&mm->mmap_sem);
+
+	return pages_done ? pages_done : ret;
+}
+EXPORT_SYMBOL(get_user_pages_unlocked);
+
 /**
  * get_dump_page() - pin user page in memory while writing it to core dump
  * @addr: user address
@@ -3239,6 +3301,12 @@ static int do_anonymous_page(struct mm_struct *mm, struct vm_area_struct *vma,
 		page_table = pte_offset_map_lock(mm, pmd, address, &ptl);
 		if (!pte_none(*page_table))
 			goto unlock;
+		/* Deliver the page fault to userland, check inside PT lock */
+		if (userfaultfd_missing(vma)) {
+			pte_unmap_unlock(page_table, ptl);
+			return handle_userfault(vma, address, flags,
+						VM_UFFD_MISSING);
+		}
 		goto setpte;
 	}
 
@@ -3266,6 +3334,15 @@ static int do_anonymous_page(struct mm_struct *mm, struct vm_area_struct *vma,
 	if (!pte_none(*page_table))
 		goto release;
 
+	/* Deliver the page fault to userland, check inside PT lock */
+	if (userfaultfd_missing(vma)) {
+		pte_unmap_unlock(page_table, ptl);
+		mem_cgroup_uncharge_page(page);
+		page_cache_release(page);
+		return handle_userfault(vma, address, flags,
+					VM_UFFD_MISSING);
+	}
+
 	inc_mm_counter_fast(mm, MM_ANONPAGES);
 	page_add_new_anon_rmap(page, vma, address);
 setpte:
@@ -3286,6 +3363,158 @@ oom:
 	return VM_FAULT_OOM;
 }
 
+/**
+ * do_set_pte - setup new PTE entry for given page and add reverse page mapping.
+ *
+ * @vma: virtual memory area
+ * @address: user virtual address
+ * @page: page to map
+ * @pte: pointer to target page table entry
+ * @write: true, if new entry is writable
+ * @anon: true, if it's anonymous page
+ *
+ * Caller must hold page table lock relevant for @pte.
+ *
+ * Target users are page handler itself and implementations of
+ * vm_ops->map_pages.
+ */
+void do_set_pte(struct vm_area_struct *vma, unsigned long address,
+		struct page *page, pte_t *pte, bool write, bool anon)
+{
+	pte_t entry;
+
+	flush_icache_page(vma, page);
+	entry = mk_pte(page, vma->vm_page_prot);
+	if (write)
+		entry = maybe_mkwrite(pte_mkdirty(entry), vma);
+	else if (pte_file(*pte) && pte_file_soft_dirty(*pte))
+		entry = pte_mksoft_dirty(entry);
+	if (anon) {
+		inc_mm_counter_fast(vma->vm_mm, MM_ANONPAGES);
+		page_add_new_anon_rmap(page, vma, address);
+	} else {
+		inc_mm_counter_fast(vma->vm_mm, MM_FILEPAGES);
+		page_add_file_rmap(page);
+	}
+	set_pte_at(vma->vm_mm, address, pte, entry);
+
+	/* no need to invalidate: a not-present page won't be cached */
+	update_mmu_cache(vma, address, pte);
+}
+
+static unsigned long fault_around_bytes = 65536;
+
+static inline unsigned long fault_around_pages(void)
+{
+	return ACCESS_ONCE(fault_around_bytes) >> PAGE_SHIFT;
+}
+
+static inline unsigned long fault_around_mask(void)
+{
+	return ~(ACCESS_ONCE(fault_around_bytes) - 1) & PAGE_MASK;
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int fault_around_bytes_get(void *data, u64 *val)
+{
+	*val = fault_around_bytes;
+	return 0;
+}
+
+/*
+ * fault_around_pages() and fault_around_mask() expect fault_around_bytes
+ * rounded down to a power of two, and the window must fit in one page
+ * table. PAGE_SIZE (a single page) disables fault-around.
+ */
+static int fault_around_bytes_set(void *data, u64 val)
+{
+	if (val / PAGE_SIZE > PTRS_PER_PTE)
+		return -EINVAL;
+	if (val > PAGE_SIZE)
+		fault_around_bytes = rounddown_pow_of_two(val);
+	else
+		fault_around_bytes = PAGE_SIZE; /* rounddown_pow_of_two(0) is undefined */
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(fault_around_bytes_fops,
+		fault_around_bytes_get, fault_around_bytes_set, "%llu\n");
+
+static int __init fault_around_debugfs(void)
+{
+	void *ret;
+
+	ret = debugfs_create_file("fault_around_bytes", 0644, NULL, NULL,
+			&fault_around_bytes_fops);
+	if (!ret)
+		pr_warn("Failed to create fault_around_bytes in debugfs");
+	return 0;
+}
+late_initcall(fault_around_debugfs);
+#endif
+
+/*
+ * do_fault_around() tries to map few pages around the fault address. The hope
+ * is that the pages will be needed soon and this will lower the number of
+ * faults to handle.
+ *
+ * It uses vm_ops->map_pages() to map the pages, which skips the page if it's
+ * not ready to be mapped: not up-to-date, locked, etc.
+ *
+ * This function is called with the page table lock taken. In the split ptlock
+ * case the page table lock only protects only those entries which belong to
+ * the page table corresponding to the fault address.
+ *
+ * This function doesn't cross the VMA boundaries, in order to call map_pages()
+ * only once.
+ *
+ * fault_around_pages() defines how many pages we'll try to map.
+ * do_fault_around() expects it to return a power of two less than or equal to
+ * PTRS_PER_PTE.
+ *
+ * The virtual address of the area that we map is naturally aligned to the
+ * fault_around_pages() value (and therefore to page order).  This way it's
+ * easier to guarantee that we don't cross page table boundaries.
+ */
+static void do_fault_around(struct vm_area_struct *vma, unsigned long address,
+		pte_t *pte, pgoff_t pgoff, unsigned int flags)
+{
+	unsigned long start_addr;
+	pgoff_t max_pgoff;
+	struct vm_fault vmf;
+	int off;
+
+	start_addr = max(address & fault_around_mask(), vma->vm_start);
+	off = ((address - start_addr) >> PAGE_SHIFT) & (PTRS_PER_PTE - 1);
+	pte -= off;
+	pgoff -= off;
+
+	/*
+	 *  max_pgoff is either end of page table or end of vma
+	 *  or fault_around_pages() from pgoff, depending what is nearest.
+	 */
+	max_pgoff = pgoff - ((start_addr >> PAGE_SHIFT) & (PTRS_PER_PTE - 1)) +
+		PTRS_PER_PTE - 1;
+	max_pgoff = min3(max_pgoff, vma_pages(vma) + vma->vm_pgoff - 1,
+			pgoff + fault_around_pages() - 1);
+
+	/* Check if it makes any sense to call ->map_pages */
+	while (!pte_none(*pte)) {
+		if (++pgoff > max_pgoff)
+			return;
+		start_addr += PAGE_SIZE;
+		if (start_addr >= vma->vm_end)
+			return;
+		pte++;
+	}
+
+	vmf.virtual_address = (void __user *) start_addr;
+	vmf.pte = pte;
+	vmf.pgoff = pgoff;
+	vmf.max_pgoff = max_pgoff;
+	vmf.flags = flags;
+	vma->vm_ops->map_pages(vma, &vmf);
+}
+
 /*
  * __do_fault() tries to create a new page mapping. It aggressively
  * tries to share with existing pages, but makes a separate copy if
@@ -3307,7 +3536,6 @@ static int __do_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 	spinlock_t *ptl;
 	struct page *page;
 	struct page *cow_page;
-	pte_t entry;
 	int anon = 0;
 	struct page *dirty_page = NULL;
 	struct vm_fault vmf;
@@ -3334,6 +3562,23 @@ static int __do_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 	} else
 		cow_page = NULL;
 
+	/*
+	 * On a read fault, let ->map_pages() map the faulting page and its
+	 * neighbours if they are already in the page cache, and use
+	 * ->fault() as fallback if the page is not ready to be mapped
+	 * (cold cache or something).
+	 */
+	if (!(flags & (FAULT_FLAG_WRITE | FAULT_FLAG_NONLINEAR)) &&
+	    vma->vm_ops->map_pages && fault_around_pages() > 1) {
+		page_table = pte_offset_map_lock(mm, pmd, address, &ptl);
+		do_fault_around(vma, address, page_table, pgoff, flags);
+		if (!pte_same(*page_table, orig_pte)) {
+			pte_unmap_unlock(page_table, ptl);
+			return 0;
+		}
+		pte_unmap_unlock(page_table, ptl);
+	}
+
 	vmf.virtual_address = (void __user *)(address & PAGE_MASK);
 	vmf.pgoff = pgoff;
 	vmf.flags = flags;
@@ -3416,27 +3661,12 @@ static int __do_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 	 */
 	/* Only go through if we didn't race with anybody else... */
 	if (likely(pte_same(*page_table, orig_pte))) {
-		flush_icache_page(vma, page);
-		entry = mk_pte(page, vma->vm_page_prot);
-		if (flags & FAULT_FLAG_WRITE)
-			entry = maybe_mkwrite(pte_mkdirty(entry), vma);
-		else if (pte_file(orig_pte) && pte_file_soft_dirty(orig_pte))
-			pte_mksoft_dirty(entry);
-		if (anon) {
-			inc_mm_counter_fast(mm, MM_ANONPAGES);
-			page_add_new_anon_rmap(page, vma, address);
-		} else {
-			inc_mm_counter_fast(mm, MM_FILEPAGES);
-			page_add_file_rmap(page);
-			if (flags & FAULT_FLAG_WRITE) {
-				dirty_page = page;
-				get_page(dirty_page);
-			}
+		do_set_pte(vma, address, page, page_table,
+			   flags & FAULT_FLAG_WRITE, anon);
+		if (!anon && (flags & FAULT_FLAG_WRITE)) {
+			dirty_page = page;
+			get_page(dirty_page);
 		}
-		set_pte_at(mm, address, page_table, entry);
-
-		/* no need to invalidate: a not-present page won't be cached */
-		update_mmu_cache(vma, address, page_table);
 	} else {
 		if (cow_page)
 			mem_cgroup_uncharge_page(cow_page);
@@ -3711,7 +3941,11 @@ retry:
 	pmd = pmd_alloc(mm, pud, address);
 	if (!pmd)
 		return VM_FAULT_OOM;
-	if (pmd_none(*pmd) && transparent_hugepage_enabled(vma)) {
+	if (pmd_none(*pmd) && vma->vm_ops && vma->vm_ops->pmd_fault) {
+		int ret = vma->vm_ops->pmd_fault(vma, address, pmd, flags);
+		if (!(ret & VM_FAULT_FALLBACK))
+			return ret;
+	} else if (pmd_none(*pmd) && transparent_hugepage_enabled(vma)) {
 		int ret = VM_FAULT_FALLBACK;
 		if (!vma->vm_ops)
 			ret = do_huge_pmd_anonymous_page(mm, vma, address,
@@ -3739,6 +3973,14 @@ retry:
 							     orig_pmd, pmd);
 
 			if (dirty && !pmd_write(orig_pmd)) {
+				/*
+				 * Page cache huge pages are not copied on
+				 * write: drop the huge pmd and fault again.
+				 */
+				if (vma->vm_ops) {
+					split_huge_page_pmd(vma, address, pmd);
+					goto retry;
+				}
 				ret = do_huge_pmd_wp_page(mm, vma, address, pmd,
 							  orig_pmd);
 				/*
@@ -3820,6 +4062,180 @@ int handle_mm_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 	return ret;
 }
 
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+/*
+ * Find the pmd covering address, and a copy of its value, if it maps a
+ * page table.  Called with interrupts disabled: as in get_user_pages_fast(),
+ * that holds off the TLB shootdown (or RCU grace period) which must
+ * complete before a page table can be freed.
+ */
+static pmd_t *spf_pmd_offset(struct mm_struct *mm, unsigned long address,
+			     pmd_t *pmdval)
+{
+	pgd_t *pgd;
+	pud_t *pud;
+	pmd_t *pmd;
+
+	pgd = pgd_offset(mm, address);
+	if (pgd_none(*pgd) || unlikely(pgd_bad(*pgd)))
+		return NULL;
+	pud = pud_offset(pgd, address);
+	if (pud_none(*pud) || unlikely(pud_bad(*pud)))
+		return NULL;
+	pmd = pmd_offset(pud, address);
+	*pmdval = *pmd;
+	barrier();
+	if (pmd_none(*pmdval) || pmd_trans_huge(*pmdval) ||
+	    pmd_numa(*pmdval) || unlikely(pmd_bad(*pmdval)))
+		return NULL;
+	return pmd;
+}
+
+/*
+ * Handle a page fault without taking mmap_sem.
+ *
+ * The vma is looked up under vma_srcu, which keeps it from being freed,
+ * and the fields we need are copied out between two reads of its
+ * vm_sequence.  The fault is then prepared from that copy, and the pte
+ * installed only once the page table lock is held and vm_sequence is
+ * found unchanged: any writer which changes or unmaps the vma after that
+ * will take the same page table lock to update or zap our pte.
+ *
+ * Only the first touch of anonymous memory, the commonest fault in a
+ * heap, is handled here; anything else, or any conflict with a writer,
+ * returns VM_FAULT_RETRY and the caller falls back to handle_mm_fault()
+ * under mmap_sem.
+ */
+int handle_speculative_fault(struct mm_struct *mm, unsigned long address,
+			     unsigned int flags)
+{
+	struct vm_area_struct *vma, pvma;
+	struct page *page = NULL;
+	pmd_t *pmd, pmdval;
+	pte_t *pte, entry;
+	spinlock_t *ptl;
+	unsigned int seq;
+	int idx;
+
+	idx = srcu_read_lock(&vma_srcu);
+	vma = find_vma_srcu(mm, address);
+	if (!vma)
+		goto out_abort;
+
+	seq = raw_seqcount_begin(&vma->vm_sequence);
+	pvma = *vma;
+	if (read_seqcount_retry(&vma->vm_sequence, seq))
+		goto out_abort;
+
+	if (address < pvma.vm_start || address >= pvma.vm_end)
+		goto out_abort;
+	if (pvma.vm_ops || vma_policy(&pvma) ||
+	    pvma.vm_userfaultfd_ctx.ctx)
+		goto out_abort;
+	/* stack guard pages and the rest need mmap_sem */
+	if (pvma.vm_flags & (VM_HUGETLB | VM_PFNMAP | VM_MIXEDMAP |
+			     VM_GROWSDOWN | VM_GROWSUP | VM_UFFD_MISSING))
+		goto out_abort;
+	if (flags & FAULT_FLAG_WRITE) {
+		if (!(pvma.vm_flags & VM_WRITE) || !pvma.anon_vma)
+			goto out_abort;
+	} else if (!(pvma.vm_flags & (VM_READ | VM_WRITE | VM_EXEC)))
+		goto out_abort;
+
+	/* Do not allocate a page only to find the fault was not ours */
+	local_irq_disable();
+	pmd = spf_pmd_offset(mm, address, &pmdval);
+	if (pmd) {
+		pte = pte_offset_map(&pmdval, address);
+		entry = *pte;
+		pte_unmap(pte);
+	}
+	local_irq_enable();
+	if (!pmd || !pte_none(entry))
+		goto out_abort;
+
+	if (flags & FAULT_FLAG_WRITE) {
+		page = alloc_zeroed_user_highpage_movable(&pvma, address);
+		if (!page)
+			goto out_abort;
+		/*
+		 * The memory barrier inside __SetPageUptodate makes sure that
+		 * preceeding stores to the page contents become visible before
+		 * the set_pte_at() write.
+		 */
+		__SetPageUptodate(page);
+		if (mem_cgroup_newpage_charge(page, mm, GFP_KERNEL))
+			goto out_free_page;
+		entry = mk_pte(page, pvma.vm_page_prot);
+		entry = pte_mkwrite(pte_mkdirty(entry));
+	} else
+		entry = pte_mkspecial(pfn_pte(my_zero_pfn(address),
+					      pvma.vm_page_prot));
+
+	/*
+	 * The page table lock cannot be waited for with interrupts off, as
+	 * its holder may be waiting for our TLB flush acknowledgement.
+	 */
+	local_irq_disable();
+	pmd = spf_pmd_offset(mm, address, &pmdval);
+	if (!pmd) {
+		local_irq_enable();
+		goto out_uncharge;
+	}
+	ptl = pte_lockptr(mm, &pmdval);
+	pte = pte_offset_map(&pmdval, address);
+	if (!spin_trylock(ptl)) {
+		pte_unmap(pte);
+		local_irq_enable();
+		goto out_uncharge;
+	}
+	if (!pmd_same(*pmd, pmdval) ||
+	    read_seqcount_retry(&vma->vm_sequence, seq)) {
+		pte_unmap_unlock(pte, ptl);
+		local_irq_enable();
+		goto out_uncharge;
+	}
+	local_irq_enable();
+
+	if (!pte_none(*pte)) {
+		/* somebody else faulted it in: nothing left to do */
+		pte_unmap_unlock(pte, ptl);
+		if (page) {
+			mem_cgroup_uncharge_page(page);
+			page_cache_release(page);
+		}
+		goto out;
+	}
+
+	if (page) {
+		inc_mm_counter_fast(mm, MM_ANONPAGES);
+		page_add_new_anon_rmap(page, vma, address);
+	}
+	set_pte_at(mm, address, pte, entry);
+
+	/* No need to invalidate - it was non-present before */
+	update_mmu_cache(vma, address, pte);
+	pte_unmap_unlock(pte, ptl);
+out:
+	srcu_read_unlock(&vma_srcu, idx);
+	count_vm_event(PGFAULT);
+	mem_cgroup_count_vm_event(mm, PGFAULT);
+	count_vm_event(SPF_SUCCESS);
+	return 0;
+
+out_uncharge:
+	if (page)
+		mem_cgroup_uncharge_page(page);
+out_free_page:
+	if (page)
+		page_cache_release(page);
+out_abort:
+	srcu_read_unlock(&vma_srcu, idx);
+	count_vm_event(SPF_ABORT);
+	return VM_FAULT_RETRY;
+}
+#endif /* CONFIG_SPECULATIVE_PAGE_FAULT */
+
 #ifndef __PAGETABLE_PUD_FOLDED
 /*
  * Allocate page upper directory.
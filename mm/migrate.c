@@ -921,9 +921,19 @@ static int unmap_and_move(new_page_t get_new_page, unsigned long private,
 		goto out;
 	}
 
-	if (unlikely(PageTransHuge(page)))
-		if (unlikely(split_huge_page(page)))
+	if (unlikely(PageTransHuge(page))) {
+		int err = 1;
+
+		/* Huge pages of the page cache are split under the page lock */
+		if (PageAnon(page))
+			err = split_huge_page(page);
+		else if (trylock_page(page)) {
+			err = split_huge_page(page);
+			unlock_page(page);
+		}
+		if (unlikely(err))
 			goto out;
+	}
 
 	rc = __unmap_and_move(page, newpage, force, mode);
 
@@ -77,7 +77,7 @@ void __init free_bootmem_late(unsigned long addr, unsigned long size)
 	end = PFN_DOWN(addr + size);
 
 	for (; cursor < end; cursor++) {
-		__free_pages_bootmem(pfn_to_page(cursor), 0);
+		__free_pages_bootmem(pfn_to_page(cursor), cursor, 0);
 		totalram_pages++;
 	}
 }
@@ -92,7 +92,7 @@ static void __init __free_pages_memory(unsigned long start, unsigned long end)
 		while (start + (1UL << order) > end)
 			order--;
 
-		__free_pages_bootmem(pfn_to_page(start), order);
+		__free_pages_bootmem(pfn_to_page(start), start, order);
 
 		start += (1UL << order);
 	}
@@ -113,29 +113,51 @@ static unsigned long __init __free_memory_core(phys_addr_t start,
 	return end_pfn - start_pfn;
 }
 
+#ifdef CONFIG_ARCH_DISCARD_MEMBLOCK
+/*
+ * Release the memblock.reserved and memblock.memory arrays, if they were
+ * allocated.  Returns the number of pages freed.
+ */
+unsigned long __init free_memblock_arrays(void)
+{
+	unsigned long count = 0;
+	phys_addr_t start, size;
+
+	/* Free memblock.reserved array if it was allocated */
+	size = get_allocated_memblock_reserved_regions_info(&start);
+	if (size)
+		count += __free_memory_core(start, start + size);
+
+	/* Free memblock.memory array if it was allocated */
+	size = get_allocated_memblock_memory_regions_info(&start);
+	if (size)
+		count += __free_memory_core(start, start + size);
+
+	return count;
+}
+#endif
+
 static unsigned long __init free_low_memory_core_early(void)
 {
 	unsigned long count = 0;
+	struct memblock_region *r;
 	phys_addr_t start, end;
 	u64 i;
 
+	/* Initialise any struct pages of reserved ranges that were deferred */
+	for_each_memblock(reserved, r)
+		reserve_bootmem_region(r->base, r->base + r->size);
+
 	for_each_free_mem_range(i, NUMA_NO_NODE, &start, &end, NULL)
 		count += __free_memory_core(start, end);
 
-#ifdef CONFIG_ARCH_DISCARD_MEMBLOCK
-	{
-		phys_addr_t size;
-
-		/* Free memblock.reserved array if it was allocated */
-		size = get_allocated_memblock_reserved_regions_info(&start);
-		if (size)
-			count += __free_memory_core(start, start + size);
-
-		/* Free memblock.memory array if it was allocated */
-		size = get_allocated_memblock_memory_regions_info(&start);
-		if (size)
-			count += __free_memory_core(start, start + size);
-	}
+	/*
+	 * With deferred struct page initialisation, memblock.memory is
+	 * walked again after SMP bring-up; page_alloc_init_late() frees
+	 * the arrays then.
+	 */
+#ifndef CONFIG_DEFERRED_STRUCT_PAGE_INIT
+	count += free_memblock_arrays();
 #endif
 
 	return count;
@@ -61,6 +61,7 @@
 #include <linux/page-debug-flags.h>
 #include <linux/hugetlb.h>
 #include <linux/sched/rt.h>
+#include <linux/kthread.h>
 
 #include <asm/sections.h>
 #include <asm/tlbflush.h>
@@ -232,6 +233,60 @@ EXPORT_SYMBOL(nr_online_nodes);
 
 int page_group_by_mobility_disabled __read_mostly;
 
+#ifdef CONFIG_DEFERRED_STRUCT_PAGE_INIT
+static inline void reset_deferred_meminit(pg_data_t *pgdat)
+{
+	pgdat->first_deferred_pfn = ULONG_MAX;
+}
+
+/* Returns true if the struct page for the pfn is uninitialised */
+static inline bool __meminit early_page_uninitialised(unsigned long pfn)
+{
+	int nid = early_pfn_to_nid(pfn);
+
+	return pfn >= NODE_DATA(nid)->first_deferred_pfn;
+}
+
+/*
+ * Returns false when the remaining initialisation should be deferred until
+ * later in the boot cycle when it can be parallelised.
+ */
+static inline bool update_defer_init(pg_data_t *pgdat,
+				unsigned long pfn, unsigned long zone_end,
+				unsigned long *nr_initialised)
+{
+	/* Always populate low zones for address-constrained allocations */
+	if (zone_end < pgdat_end_pfn(pgdat))
+		return true;
+
+	/* Initialise at least 2G of the highest zone */
+	(*nr_initialised)++;
+	if (*nr_initialised > (2UL << (30 - PAGE_SHIFT)) &&
+	    (pfn & (PAGES_PER_SECTION - 1)) == 0) {
+		pgdat->first_deferred_pfn = pfn;
+		return false;
+	}
+
+	return true;
+}
+#else
+static inline void reset_deferred_meminit(pg_data_t *pgdat)
+{
+}
+
+static inline bool early_page_uninitialised(unsigned long pfn)
+{
+	return false;
+}
+
+static inline bool update_defer_init(pg_data_t *pgdat,
+				unsigned long pfn, unsigned long zone_end,
+				unsigned long *nr_initialised)
+{
+	return true;
+}
+#endif
+
 void set_pageblock_migratetype(struct page *page, int migratetype)
 {
 	if (unlikely(page_group_by_mobility_disabled &&
@@ -764,7 +819,8 @@ static void __free_pages_ok(struct page *page, unsigned int order)
 	local_irq_restore(flags);
 }
 
-void __init __free_pages_bootmem(struct page *page, unsigned int order)
+static void __init __free_pages_boot_core(struct page *page,
+					  unsigned int order)
 {
 	unsigned int nr_pages = 1 << order;
 	struct page *p = page;
@@ -784,6 +840,20 @@ void __init __free_pages_bootmem(struct page *page, unsigned int order)
 	__free_pages(page, order);
 }
 
+void __init __free_pages_bootmem(struct page *page, unsigned long pfn,
+				 unsigned int order)
+{
+	/*
+	 * Free pages above first_deferred_pfn have no initialised struct
+	 * page yet; deferred_init_memmap() releases them.  Reserved pages
+	 * there were initialised by reserve_bootmem_region(), so they can
+	 * be freed now and are skipped by the deferred pass.
+	 */
+	if (early_page_uninitialised(pfn) && !page->flags)
+		return;
+	__free_pages_boot_core(page, order);
+}
+
 #ifdef CONFIG_CMA
 /* Free whole pageblock and set its migration type to MIGRATE_CMA. */
 void __init init_cma_reserved_pageblock(struct page *page)
@@ -4007,23 +4077,93 @@ static void setup_zone_migrate_reserve(struct zone *zone)
 	}
 }
 
+static void __meminit __init_single_page(struct page *page, unsigned long pfn,
+				unsigned long zone, int nid)
+{
+	set_page_links(page, zone, nid, pfn);
+	mminit_verify_page_links(page, zone, nid, pfn);
+	init_page_count(page);
+	page_mapcount_reset(page);
+	page_cpupid_reset_last(page);
+
+	INIT_LIST_HEAD(&page->lru);
+#ifdef WANT_PAGE_VIRTUAL
+	/* The shift won't overflow because ZONE_NORMAL is below 4G. */
+	if (!is_highmem_idx(zone))
+		set_page_address(page, __va(pfn << PAGE_SHIFT));
+#endif
+}
+
+#ifdef CONFIG_DEFERRED_STRUCT_PAGE_INIT
+static void __meminit init_reserved_page(unsigned long pfn)
+{
+	pg_data_t *pgdat;
+	int nid, zid;
+
+	if (!early_page_uninitialised(pfn))
+		return;
+
+	nid = early_pfn_to_nid(pfn);
+	pgdat = NODE_DATA(nid);
+
+	for (zid = 0; zid < MAX_NR_ZONES; zid++) {
+		struct zone *zone = &pgdat->node_zones[zid];
+
+		if (pfn >= zone->zone_start_pfn && pfn < zone_end_pfn(zone))
+			break;
+	}
+	__init_single_page(pfn_to_page(pfn), pfn, zid, nid);
+	if (!(pfn & (pageblock_nr_pages - 1)))
+		set_pageblock_migratetype(pfn_to_page(pfn), MIGRATE_MOVABLE);
+}
+#else
+static inline void init_reserved_page(unsigned long pfn)
+{
+}
+#endif /* CONFIG_DEFERRED_STRUCT_PAGE_INIT */
+
+/*
+ * Called for each memblock reserved range before free memory is handed
+ * to the buddy allocator.  Struct pages of reserved ranges above
+ * first_deferred_pfn are initialised here, which also tells
+ * deferred_init_memmap() to leave them alone.
+ */
+void __meminit reserve_bootmem_region(phys_addr_t start, phys_addr_t end)
+{
+	unsigned long start_pfn = PFN_DOWN(start);
+	unsigned long end_pfn = PFN_UP(end);
+
+	for (; start_pfn < end_pfn; start_pfn++) {
+		if (pfn_valid(start_pfn)) {
+			init_reserved_page(start_pfn);
+			SetPageReserved(pfn_to_page(start_pfn));
+		}
+	}
+}
+
 /*
  * Initially all pages are reserved - free ones are freed
  * up by free_all_bootmem() once the early boot process is
  * done. Non-atomic initialization, single-pass.
+ *
+ * With CONFIG_DEFERRED_STRUCT_PAGE_INIT, only the start of the highest
+ * zone of each node is initialised here; the rest is left to
+ * deferred_init_memmap() after SMP bring-up.
  */
 void __meminit memmap_init_zone(unsigned long size, int nid, unsigned long zone,
 		unsigned long start_pfn, enum memmap_context context)
 {
+	pg_data_t *pgdat = NODE_DATA(nid);
 	struct page *page;
 	unsigned long end_pfn = start_pfn + size;
 	unsigned long pfn;
 	struct zone *z;
+	unsigned long nr_initialised = 0;
 
 	if (highest_memmap_pfn < end_pfn - 1)
 		highest_memmap_pfn = end_pfn - 1;
 
-	z = &NODE_DATA(nid)->node_zones[zone];
+	z = &pgdat->node_zones[zone];
 	for (pfn = start_pfn; pfn < end_pfn; pfn++) {
 		/*
 		 * There can be holes in boot-time mem_map[]s
@@ -4035,13 +4175,12 @@ void __meminit memmap_init_zone(unsigned long size, int nid, unsigned long zone,
 				continue;
 			if (!early_pfn_in_nid(pfn, nid))
 				continue;
+			if (!update_defer_init(pgdat, pfn, end_pfn,
+						&nr_initialised))
+				break;
 		}
 		page = pfn_to_page(pfn);
-		set_page_links(page, zone, nid, pfn);
-		mminit_verify_page_links(page, zone, nid, pfn);
-		init_page_count(page);
-		page_mapcount_reset(page);
-		page_cpupid_reset_last(page);
+		__init_single_page(page, pfn, zone, nid);
 		SetPageReserved(page);
 		/*
 		 * Mark the block movable so that blocks are reserved for
@@ -4061,13 +4200,6 @@ void __meminit memmap_init_zone(unsigned long size, int nid, unsigned long zone,
 		    && (pfn < zone_end_pfn(z))
 		    && !(pfn & (pageblock_nr_pages - 1)))
 			set_pageblock_migratetype(page, MIGRATE_MOVABLE);
-
-		INIT_LIST_HEAD(&page->lru);
-#ifdef WANT_PAGE_VIRTUAL
-		/* The shift won't overflow because ZONE_NORMAL is below 4G. */
-		if (!is_highmem_idx(zone))
-			set_page_address(page, __va(pfn << PAGE_SHIFT));
-#endif
 	}
 }
 
@@ -4763,6 +4895,9 @@ static void __paginginit free_area_init_core(struct pglist_data *pgdat,
 #endif
 	init_waitqueue_head(&pgdat->kswapd_wait);
 	init_waitqueue_head(&pgdat->pfmemalloc_wait);
+#ifdef CONFIG_COMPACTION
+	init_waitqueue_head(&pgdat->kcompactd_wait);
+#endif
 	pgdat_page_cgroup_init(pgdat);
 
 	for (j = 0; j < MAX_NR_ZONES; j++) {
@@ -4899,6 +5034,7 @@ void __paginginit free_area_init_node(int nid, unsigned long *zones_size,
 
 	pgdat->node_id = nid;
 	pgdat->node_start_pfn = node_start_pfn;
+	reset_deferred_meminit(pgdat);
 	init_zone_allows_reclaim(nid);
 #ifdef CONFIG_HAVE_MEMBLOCK_NODE_MAP
 	get_pfn_range_for_nid(nid, &start_pfn, &end_pfn);
@@ -5499,6 +5635,150 @@ void __init page_alloc_init(void)
 	hotcpu_notifier(page_alloc_cpu_notify, 0);
 }
 
+#ifdef CONFIG_DEFERRED_STRUCT_PAGE_INIT
+static atomic_t pgdat_init_n_undone __initdata;
+static __initdata DECLARE_COMPLETION(pgdat_init_all_done_comp);
+
+static inline void __init pgdat_init_report_one_done(void)
+{
+	if (atomic_dec_and_test(&pgdat_init_n_undone))
+		complete(&pgdat_init_all_done_comp);
+}
+
+/* Hand a run of initialised pages to the buddy allocator */
+static unsigned long __init deferred_free_range(unsigned long pfn,
+						unsigned long end_pfn)
+{
+	unsigned long nr_pages = 0;
+	int order;
+
+	while (pfn < end_pfn) {
+		order = min(MAX_ORDER - 1UL, __ffs(pfn));
+
+		while (pfn + (1UL << order) > end_pfn)
+			order--;
+
+		__free_pages_boot_core(pfn_to_page(pfn), order);
+		pfn += 1UL << order;
+		nr_pages += 1UL << order;
+	}
+
+	return nr_pages;
+}
+
+/* Initialise and free the struct pages left over by memmap_init_zone() */
+static int __init deferred_init_memmap(void *data)
+{
+	pg_data_t *pgdat = data;
+	int nid = pgdat->node_id;
+	unsigned long first_init_pfn = pgdat->first_deferred_pfn;
+	unsigned long start = jiffies;
+	unsigned long nr_pages = 0;
+	unsigned long spfn, epfn, pfn, free_base;
+	struct zone *zone;
+	int i, zid;
+
+	if (first_init_pfn == ULONG_MAX)
+		goto out;
+
+	/* Sanity check boundaries */
+	BUG_ON(first_init_pfn < pgdat->node_start_pfn);
+	BUG_ON(first_init_pfn > pgdat_end_pfn(pgdat));
+
+	/* Only the highest zone is deferred so find it */
+	for (zid = 0; zid < MAX_NR_ZONES; zid++) {
+		zone = pgdat->node_zones + zid;
+		if (first_init_pfn < zone_end_pfn(zone))
+			break;
+	}
+
+	for_each_mem_pfn_range(i, nid, &spfn, &epfn, NULL) {
+		spfn = max(spfn, first_init_pfn);
+		epfn = min(epfn, zone_end_pfn(zone));
+		if (spfn >= epfn)
+			continue;
+
+		free_base = spfn;
+		for (pfn = spfn; pfn < epfn; pfn++) {
+			struct page *page;
+
+			if (!early_pfn_valid(pfn)) {
+				nr_pages += deferred_free_range(free_base, pfn);
+				free_base = pfn + 1;
+				continue;
+			}
+
+			/*
+			 * Reserved pages were initialised by
+			 * reserve_bootmem_region() and may even have been
+			 * freed already; leave them alone.
+			 */
+			page = pfn_to_page(pfn);
+			if (page->flags) {
+				nr_pages += deferred_free_range(free_base, pfn);
+				free_base = pfn + 1;
+				continue;
+			}
+
+			__init_single_page(page, pfn, zid, nid);
+			if (!(pfn & (pageblock_nr_pages - 1)))
+				set_pageblock_migratetype(page, MIGRATE_MOVABLE);
+
+			/* Free a MAX_ORDER block at a time and let others run */
+			if (!((pfn + 1) & (MAX_ORDER_NR_PAGES - 1))) {
+				nr_pages += deferred_free_range(free_base,
+								pfn + 1);
+				free_base = pfn + 1;
+				cond_resched();
+			}
+		}
+		nr_pages += deferred_free_range(free_base, epfn);
+	}
+
+	/* Sanity check that the next zone really is unpopulated */
+	WARN_ON(++zid < MAX_NR_ZONES && populated_zone(++zone));
+
+	pgdat->first_deferred_pfn = ULONG_MAX;
+	pr_info("node %d initialised, %lu pages in %ums\n", nid, nr_pages,
+		jiffies_to_msecs(jiffies - start));
+out:
+	pgdat_init_report_one_done();
+	return 0;
+}
+
+/*
+ * Called once all cpus are up: initialise the struct pages deferred by
+ * memmap_init_zone() with one thread per node, running on that node's
+ * cpus, and wait until all the memory is in the buddy allocator.
+ */
+void __init page_alloc_init_late(void)
+{
+	struct task_struct *p;
+	int nid;
+
+	atomic_set(&pgdat_init_n_undone, num_node_state(N_MEMORY));
+	for_each_node_state(nid, N_MEMORY) {
+		const struct cpumask *cpumask = cpumask_of_node(nid);
+
+		p = kthread_create_on_node(deferred_init_memmap, NODE_DATA(nid),
+					   nid, "pgdatinit%d", nid);
+		if (IS_ERR(p)) {
+			deferred_init_memmap(NODE_DATA(nid));
+			continue;
+		}
+		if (!cpumask_empty(cpumask))
+			set_cpus_allowed_ptr(p, cpumask);
+		wake_up_process(p);
+	}
+
+	/* Block until all are initialised */
+	wait_for_completion(&pgdat_init_all_done_comp);
+
+	/* memblock.memory was needed by the threads; release it now */
+	totalram_pages += free_memblock_arrays();
+}
+#endif /* CONFIG_DEFERRED_STRUCT_PAGE_INIT */
+
 /*
  * calculate_totalreserve_pages - called when sysctl_lower_zone_reserve_ratio
  *	or min_free_kbytes changes.
@@ -1035,7 +1035,8 @@ void page_add_new_anon_rmap(struct page *page,
  * page_add_file_rmap - add pte mapping to a file page
  * @page: the page to add the mapping to
  *
- * The caller needs to hold the pte lock.
+ * The caller needs to hold the pte lock.  A huge page of the page cache
+ * is mapped only by huge pmds, so its mapping accounts all its subpages.
  */
 void page_add_file_rmap(struct page *page)
 {
@@ -1044,8 +1045,13 @@ void page_add_file_rmap(struct page *page)
 
 	mem_cgroup_begin_update_page_stat(page, &locked, &flags);
 	if (atomic_inc_and_test(&page->_mapcount)) {
-		__inc_zone_page_state(page, NR_FILE_MAPPED);
-		mem_cgroup_inc_page_stat(page, MEM_CGROUP_STAT_FILE_MAPPED);
+		int nr = hpage_nr_pages(page);
+
+		if (PageTransHuge(page))
+			__inc_zone_page_state(page, NR_SHMEM_PMDMAPPED);
+		__mod_zone_page_state(page_zone(page), NR_FILE_MAPPED, nr);
+		mem_cgroup_update_page_stat(page, MEM_CGROUP_STAT_FILE_MAPPED,
+					    nr);
 	}
 	mem_cgroup_end_update_page_stat(page, &locked, &flags);
 }
@@ -1088,8 +1094,13 @@ void page_remove_rmap(struct page *page)
 		__mod_zone_page_state(page_zone(page), NR_ANON_PAGES,
 				-hpage_nr_pages(page));
 	} else {
-		__dec_zone_page_state(page, NR_FILE_MAPPED);
-		mem_cgroup_dec_page_stat(page, MEM_CGROUP_STAT_FILE_MAPPED);
+		int nr = hpage_nr_pages(page);
+
+		if (PageTransHuge(page))
+			__dec_zone_page_state(page, NR_SHMEM_PMDMAPPED);
+		__mod_zone_page_state(page_zone(page), NR_FILE_MAPPED, -nr);
+		mem_cgroup_update_page_stat(page, MEM_CGROUP_STAT_FILE_MAPPED,
+					    -nr);
 		mem_cgroup_end_update_page_stat(page, &locked, &flags);
 	}
 	if (unlikely(PageMlocked(page)))
@@ -1170,6 +1181,15 @@ int try_to_unmap_one(struct page *page, struct vm_area_struct *vma,
 		pte_t swp_pte;
 
 		if (PageSwapCache(page)) {
+			/*
+			 * Neither the page nor its pte is dirty, as after
+			 * MADV_FREE: its contents can be dropped, so remove
+			 * the mapping without storing the swap entry.
+			 */
+			if ((flags & TTU_LZFREE) && !PageDirty(page)) {
+				dec_mm_counter(mm, MM_ANONPAGES);
+				goto discard;
+			}
 			/*
 			 * Store the swap location in the pte.
 			 * See handle_pte_fault() ...
@@ -1210,6 +1230,7 @@ int try_to_unmap_one(struct page *page, struct vm_area_struct *vma,
 	} else
 		dec_mm_counter(mm, MM_FILEPAGES);
 
+discard:
 	page_remove_rmap(page);
 	page_cache_release(page);
 
@@ -66,6 +66,7 @@ static struct vfsmount *shm_mnt;
 #include <linux/highmem.h>
 #include <linux/seq_file.h>
 #include <linux/magic.h>
+#include <linux/kobject.h>
 
 #include <asm/uaccess.h>
 #include <asm/pgtable.h>
@@ -87,6 +88,7 @@ static struct vfsmount *shm_mnt;
 struct shmem_falloc {
 	pgoff_t start;		/* start of range currently being fallocated */
 	pgoff_t next;		/* the next page offset to be fallocated */
+	pgoff_t end;		/* end of range currently being fallocated */
 	pgoff_t nr_falloced;	/* how many new pages have been fallocated */
 	pgoff_t nr_unswapped;	/* how often writepage refused to swap out */
 };
@@ -98,6 +100,8 @@ enum sgp_type {
 	SGP_DIRTY,	/* like SGP_CACHE, but set new page dirty */
 	SGP_WRITE,	/* may exceed i_size, may allocate !Uptodate page */
 	SGP_FALLOC,	/* like SGP_WRITE, but make existing page Uptodate */
+	SGP_NOHUGE,	/* like SGP_CACHE, but split any huge page found */
+	SGP_HUGE,	/* like SGP_CACHE, huge pages preferred */
 };
 
 #ifdef CONFIG_TMPFS
@@ -154,10 +158,12 @@ static inline void shmem_unacct_size(unsigned long flags, loff_t size)
  * shmem_getpage reports shmem_acct_block failure as -ENOSPC not -ENOMEM,
  * so that a failure on a sparse tmpfs mapping will give SIGBUS not OOM.
  */
-static inline int shmem_acct_block(unsigned long flags)
+static inline int shmem_acct_block(unsigned long flags, long pages)
 {
-	return (flags & VM_NORESERVE) ?
-		security_vm_enough_memory_mm(current->mm, VM_ACCT(PAGE_CACHE_SIZE)) : 0;
+	if (!(flags & VM_NORESERVE))
+		return 0;
+	return security_vm_enough_memory_mm(current->mm,
+			pages * VM_ACCT(PAGE_CACHE_SIZE));
 }
 
 static inline void shmem_unacct_blocks(unsigned long flags, long pages)
@@ -207,6 +213,208 @@ static void shmem_free_inode(struct super_block *sb)
 	}
 }
 
+#ifdef CONFIG_TRANSPARENT_HUGE_PAGECACHE
+/*
+ * Whether to allocate huge pages in the page cache, per mount (huge=):
+ *
+ * SHMEM_HUGE_NEVER:
+ *	never allocate huge pages;
+ * SHMEM_HUGE_ALWAYS:
+ *	allocate a huge page whenever its extent of the file is a hole;
+ * SHMEM_HUGE_WITHIN_SIZE:
+ *	only allocate a huge page if it lies entirely within i_size,
+ *	or if the mapping asked for it with madvise(MADV_HUGEPAGE);
+ * SHMEM_HUGE_ADVISE:
+ *	only for mappings with madvise(MADV_HUGEPAGE).
+ */
+#define SHMEM_HUGE_NEVER	0
+#define SHMEM_HUGE_ALWAYS	1
+#define SHMEM_HUGE_WITHIN_SIZE	2
+#define SHMEM_HUGE_ADVISE	3
+
+/*
+ * Special values, only for /sys/kernel/mm/transparent_hugepage/shmem_enabled:
+ *
+ * SHMEM_HUGE_DENY:
+ *	disables huge pages on all mounts, for use in emergencies;
+ * SHMEM_HUGE_FORCE:
+ *	enables huge pages on all mounts, for testing.
+ */
+#define SHMEM_HUGE_DENY		(-1)
+#define SHMEM_HUGE_FORCE	(-2)
+
+/* the huge= policy of the internal mount, unless DENY or FORCE */
+static int shmem_huge __read_mostly;
+
+/*
+ * fallocate only gets a huge page for an extent its range covers, so that
+ * it never allocates beyond what it was asked for.  inode->i_private is
+ * only set by shmem_fallocate(), our caller, under i_mutex.
+ */
+static bool shmem_falloc_covers(struct inode *inode, pgoff_t hindex)
+{
+	struct shmem_falloc *shmem_falloc = inode->i_private;
+
+	return shmem_falloc && hindex >= shmem_falloc->start &&
+	       hindex + HPAGE_PMD_NR <= shmem_falloc->end;
+}
+
+static bool shmem_huge_enabled(struct inode *inode, pgoff_t index,
+			       enum sgp_type sgp)
+{
+	pgoff_t hindex = round_down(index, HPAGE_PMD_NR);
+
+	if (shmem_huge == SHMEM_HUGE_DENY || !S_ISREG(inode->i_mode))
+		return false;
+	if (sgp == SGP_READ || sgp == SGP_NOHUGE)
+		return false;
+	if (sgp == SGP_FALLOC && !shmem_falloc_covers(inode, hindex))
+		return false;
+	if (shmem_huge == SHMEM_HUGE_FORCE)
+		return true;
+
+	switch (SHMEM_SB(inode->i_sb)->huge) {
+	case SHMEM_HUGE_ALWAYS:
+		return true;
+	case SHMEM_HUGE_WITHIN_SIZE:
+		if (i_size_read(inode) >=
+		    (loff_t)(hindex + HPAGE_PMD_NR) << PAGE_CACHE_SHIFT)
+			return true;
+		/* fall through */
+	case SHMEM_HUGE_ADVISE:
+		return sgp == SGP_HUGE;
+	default:
+		return false;
+	}
+}
+
+/*
+ * Whether the extent of a huge page at @hindex is still a hole: a huge
+ * page cannot be inserted over any page or swap entry already there.
+ */
+static bool shmem_huge_extent_empty(struct address_space *mapping,
+				    pgoff_t hindex)
+{
+	void **slot;
+	unsigned long idx;
+	bool empty;
+
+	rcu_read_lock();
+	empty = !radix_tree_gang_lookup_slot(&mapping->page_tree, &slot, &idx,
+					     hindex, 1) ||
+		idx >= hindex + HPAGE_PMD_NR;
+	rcu_read_unlock();
+	return empty;
+}
+
+#if defined(CONFIG_SYSFS) || defined(CONFIG_TMPFS)
+static int shmem_parse_huge(const char *str)
+{
+	if (!strcmp(str, "never"))
+		return SHMEM_HUGE_NEVER;
+	if (!strcmp(str, "always"))
+		return SHMEM_HUGE_ALWAYS;
+	if (!strcmp(str, "within_size"))
+		return SHMEM_HUGE_WITHIN_SIZE;
+	if (!strcmp(str, "advise"))
+		return SHMEM_HUGE_ADVISE;
+	if (!strcmp(str, "deny"))
+		return SHMEM_HUGE_DENY;
+	if (!strcmp(str, "force"))
+		return SHMEM_HUGE_FORCE;
+	return -EINVAL;
+}
+
+static const char *shmem_format_huge(int huge)
+{
+	switch (huge) {
+	case SHMEM_HUGE_NEVER:
+		return "never";
+	case SHMEM_HUGE_ALWAYS:
+		return "always";
+	case SHMEM_HUGE_WITHIN_SIZE:
+		return "within_size";
+	case SHMEM_HUGE_ADVISE:
+		return "advise";
+	case SHMEM_HUGE_DENY:
+		return "deny";
+	case SHMEM_HUGE_FORCE:
+		return "force";
+	default:
+		VM_BUG_ON(1);
+		return "bad_val";
+	}
+}
+#endif
+
+#ifdef CONFIG_SYSFS
+static ssize_t shmem_enabled_show(struct kobject *kobj,
+				  struct kobj_attribute *attr, char *buf)
+{
+	static const int values[] = {
+		SHMEM_HUGE_ALWAYS,
+		SHMEM_HUGE_WITHIN_SIZE,
+		SHMEM_HUGE_ADVISE,
+		SHMEM_HUGE_NEVER,
+		SHMEM_HUGE_DENY,
+		SHMEM_HUGE_FORCE,
+	};
+	int i, count;
+
+	for (i = 0, count = 0; i < ARRAY_SIZE(values); i++) {
+		const char *fmt = shmem_huge == values[i] ? "[%s] " : "%s ";
+
+		count += sprintf(buf + count, fmt,
+				 shmem_format_huge(values[i]));
+	}
+	buf[count - 1] = '\n';
+	return count;
+}
+
+static ssize_t shmem_enabled_store(struct kobject *kobj,
+				   struct kobj_attribute *attr,
+				   const char *buf, size_t count)
+{
+	char tmp[16];
+	int huge;
+
+	if (count + 1 > sizeof(tmp))
+		return -EINVAL;
+	memcpy(tmp, buf, count);
+	tmp[count] = '\0';
+	if (count && tmp[count - 1] == '\n')
+		tmp[count - 1] = '\0';
+
+	huge = shmem_parse_huge(tmp);
+	if (huge == -EINVAL)
+		return -EINVAL;
+	if (!has_transparent_hugepage() &&
+	    huge != SHMEM_HUGE_NEVER && huge != SHMEM_HUGE_DENY)
+		return -EINVAL;
+
+	shmem_huge = huge;
+	if (shmem_huge >= SHMEM_HUGE_NEVER)
+		SHMEM_SB(shm_mnt->mnt_sb)->huge = shmem_huge;
+	return count;
+}
+
+struct kobj_attribute shmem_enabled_attr =
+	__ATTR(shmem_enabled, 0644, shmem_enabled_show, shmem_enabled_store);
+#endif /* CONFIG_SYSFS */
+#else /* !CONFIG_TRANSPARENT_HUGE_PAGECACHE */
+static inline bool shmem_huge_enabled(struct inode *inode, pgoff_t index,
+				      enum sgp_type sgp)
+{
+	return false;
+}
+
+static inline bool shmem_huge_extent_empty(struct address_space *mapping,
+					   pgoff_t hindex)
+{
+	return false;
+}
+#endif /* CONFIG_TRANSPARENT_HUGE_PAGECACHE */
+
 /**
  * shmem_recalc_inode - recalculate the block usage of an inode
  * @inode: inode to recalc
@@ -258,6 +466,15 @@ static int shmem_radix_tree_replace(struct address_space *mapping,
 	return 0;
 }
 
+/*
+ * The page cache lookups in this file return the head of a huge page for
+ * any index it covers: this gives the subpage holding @index.
+ */
+static inline struct page *shmem_subpage(struct page *page, pgoff_t index)
+{
+	return page + (index - page->index);
+}
+
 /*
  * Sometimes, before we decide whether to proceed or to fail, we must check
  * that an entry was not already brought back from swap by a racing thread.
@@ -283,30 +500,46 @@ static int shmem_add_to_page_cache(struct page *page,
 				   struct address_space *mapping,
 				   pgoff_t index, gfp_t gfp, void *expected)
 {
-	int error;
+	int error, nr = hpage_nr_pages(page);
+	int i = 0;
 
 	VM_BUG_ON_PAGE(!PageLocked(page), page);
 	VM_BUG_ON_PAGE(!PageSwapBacked(page), page);
+	VM_BUG_ON(expected && nr > 1);
+	VM_BUG_ON(index & (nr - 1));
 
-	page_cache_get(page);
+	/*
+	 * A huge page occupies the slots of all its subpages, each of
+	 * them holding a reference on the head page.
+	 */
+	atomic_add(nr, &page->_count);
 	page->mapping = mapping;
 	page->index = index;
 
 	spin_lock_irq(&mapping->tree_lock);
-	if (!expected)
-		error = radix_tree_insert(&mapping->page_tree, index, page);
-	else
+	if (!expected) {
+		for (; i < nr; i++) {
+			error = radix_tree_insert(&mapping->page_tree,
+						  index + i, page);
+			if (error)
+				break;
+		}
+	} else
 		error = shmem_radix_tree_replace(mapping, index, expected,
 								 page);
 	if (!error) {
-		mapping->nrpages++;
-		__inc_zone_page_state(page, NR_FILE_PAGES);
-		__inc_zone_page_state(page, NR_SHMEM);
+		mapping->nrpages += nr;
+		if (nr > 1)
+			__inc_zone_page_state(page, NR_SHMEM_THPS);
+		__mod_zone_page_state(page_zone(page), NR_FILE_PAGES, nr);
+		__mod_zone_page_state(page_zone(page), NR_SHMEM, nr);
 		spin_unlock_irq(&mapping->tree_lock);
 	} else {
+		while (i--)
+			radix_tree_delete(&mapping->page_tree, index + i);
 		page->mapping = NULL;
 		spin_unlock_irq(&mapping->tree_lock);
-		page_cache_release(page);
+		atomic_sub(nr, &page->_count);
 	}
 	return error;
 }
@@ -330,56 +563,6 @@ static void shmem_delete_from_page_cache(struct page *page, void *radswap)
 	BUG_ON(error);
 }
 
-/*
- * Like find_get_pages, but collecting swap entries as well as pages.
- */
-static unsigned shmem_find_get_pages_and_swap(struct address_space *mapping,
-					pgoff_t start, unsigned int nr_pages,
-					struct page **pages, pgoff_t *indices)
-{
-	void **slot;
-	unsigned int ret = 0;
-	struct radix_tree_iter iter;
-
-	if (!nr_pages)
-		return 0;
-
-	rcu_read_lock();
-restart:
-	radix_tree_for_each_slot(slot, &mapping->page_tree, &iter, start) {
-		struct page *page;
-repeat:
-		page = radix_tree_deref_slot(slot);
-		if (unlikely(!page))
-			continue;
-		if (radix_tree_exception(page)) {
-			if (radix_tree_deref_retry(page))
-				goto restart;
-			/*
-			 * Otherwise, we must be storing a swap entry
-			 * here as an exceptional entry: so return it
-			 * without attempting to raise page count.
-			 */
-			goto export;
-		}
-		if (!page_cache_get_speculative(page))
-			goto repeat;
-
-		/* Has the page moved? */
-		if (unlikely(page != *slot)) {
-			page_cache_release(page);
-			goto repeat;
-		}
-export:
-		indices[ret] = iter.index;
-		pages[ret] = page;
-		if (++ret == nr_pages)
-			break;
-	}
-	rcu_read_unlock();
-	return ret;
-}
-
 /*
  * Remove swap entry from radix tree, free the swap and its page cache.
  */
@@ -396,19 +579,9 @@ static int shmem_free_swap(struct address_space *mapping,
 	return error;
 }
 
-/*
- * Pagevec may contain swap entries, so shuffle up pages before releasing.
- */
-static void shmem_deswap_pagevec(struct pagevec *pvec)
+bool shmem_mapping(struct address_space *mapping)
 {
-	int i, j;
-
-	for (i = 0, j = 0; i < pagevec_count(pvec); i++) {
-		struct page *page = pvec->pages[i];
-		if (!radix_tree_exceptional_entry(page))
-			pvec->pages[j++] = page;
-	}
-	pvec->nr = j;
+	return mapping->backing_dev_info == &shmem_backing_dev_info;
 }
 
 /*
@@ -429,18 +602,39 @@ void shmem_unlock_mapping(struct address_space *mapping)
 		 * Avoid pagevec_lookup(): find_get_pages() returns 0 as if it
 		 * has finished, if it hits a row of PAGEVEC_SIZE swap entries.
 		 */
-		pvec.nr = shmem_find_get_pages_and_swap(mapping, index,
-					PAGEVEC_SIZE, pvec.pages, indices);
+		pvec.nr = find_get_entries(mapping, index,
+					   PAGEVEC_SIZE, pvec.pages, indices);
 		if (!pvec.nr)
 			break;
 		index = indices[pvec.nr - 1] + 1;
-		shmem_deswap_pagevec(&pvec);
+		pagevec_remove_exceptionals(&pvec);
 		check_move_unevictable_pages(pvec.pages, pvec.nr);
 		pagevec_release(&pvec);
 		cond_resched();
 	}
 }
 
+/*
+ * Truncate a locked page which shmem_undo_range() found at @index, unless
+ * it has been truncated or split meanwhile.  A huge page is found at the
+ * index of each of its subpages: it is truncated whole if [start, end)
+ * covers it, otherwise it is split, and its subpages in the range are
+ * found again on the next pass.
+ */
+static void shmem_undo_page(struct address_space *mapping, struct page *page,
+			    pgoff_t index, pgoff_t start, pgoff_t end)
+{
+	if (page->mapping != mapping ||
+	    (page->index != index && !PageTransHuge(page)))
+		return;
+	VM_BUG_ON_PAGE(PageWriteback(page), page);
+	if (PageTransHuge(page) &&
+	    (page->index < start || page->index + HPAGE_PMD_NR > end))
+		split_huge_page(page);
+	else
+		truncate_inode_page(mapping, page);
+}
+
 /*
  * Remove range of pages and swap entries from radix tree, and free them.
  * If !unfalloc, truncate or punch hole; if unfalloc, undo failed fallocate.
@@ -466,9 +660,9 @@ static void shmem_undo_range(struct inode *inode, loff_t lstart, loff_t lend,
 	pagevec_init(&pvec, 0);
 	index = start;
 	while (index < end) {
-		pvec.nr = shmem_find_get_pages_and_swap(mapping, index,
+		pvec.nr = find_get_entries(mapping, index,
 				min(end - index, (pgoff_t)PAGEVEC_SIZE),
-							pvec.pages, indices);
+				pvec.pages, indices);
 		if (!pvec.nr)
 			break;
 		mem_cgroup_uncharge_start();
@@ -489,15 +683,11 @@ static void shmem_undo_range(struct inode *inode, loff_t lstart, loff_t lend,
 
 			if (!trylock_page(page))
 				continue;
-			if (!unfalloc || !PageUptodate(page)) {
-				if (page->mapping == mapping) {
-					VM_BUG_ON_PAGE(PageWriteback(page), page);
-					truncate_inode_page(mapping, page);
-				}
-			}
+			if (!unfalloc || !PageUptodate(page))
+				shmem_undo_page(mapping, page, index, start, end);
 			unlock_page(page);
 		}
-		shmem_deswap_pagevec(&pvec);
+		pagevec_remove_exceptionals(&pvec);
 		pagevec_release(&pvec);
 		mem_cgroup_uncharge_end();
 		cond_resched();
@@ -513,7 +703,8 @@ static void shmem_undo_range(struct inode *inode, loff_t lstart, loff_t lend,
 				top = partial_end;
 				partial_end = 0;
 			}
-			zero_user_segment(page, partial_start, top);
+			zero_user_segment(shmem_subpage(page, start - 1),
+					  partial_start, top);
 			set_page_dirty(page);
 			unlock_page(page);
 			page_cache_release(page);
@@ -523,7 +714,8 @@ static void shmem_undo_range(struct inode *inode, loff_t lstart, loff_t lend,
 		struct page *page = NULL;
 		shmem_getpage(inode, end, &page, SGP_READ, NULL);
 		if (page) {
-			zero_user_segment(page, 0, partial_end);
+			zero_user_segment(shmem_subpage(page, end),
+					  0, partial_end);
 			set_page_dirty(page);
 			unlock_page(page);
 			page_cache_release(page);
@@ -535,9 +727,9 @@ static void shmem_undo_range(struct inode *inode, loff_t lstart, loff_t lend,
 	index = start;
 	for ( ; ; ) {
 		cond_resched();
-		pvec.nr = shmem_find_get_pages_and_swap(mapping, index,
+		pvec.nr = find_get_entries(mapping, index,
 				min(end - index, (pgoff_t)PAGEVEC_SIZE),
-							pvec.pages, indices);
+				pvec.pages, indices);
 		if (!pvec.nr) {
 			if (index == start || unfalloc)
 				break;
@@ -545,7 +737,7 @@ static void shmem_undo_range(struct inode *inode, loff_t lstart, loff_t lend,
 			continue;
 		}
 		if ((index == start || unfalloc) && indices[0] >= end) {
-			shmem_deswap_pagevec(&pvec);
+			pagevec_remove_exceptionals(&pvec);
 			pagevec_release(&pvec);
 			break;
 		}
@@ -566,15 +758,11 @@ static void shmem_undo_range(struct inode *inode, loff_t lstart, loff_t lend,
 			}
 
 			lock_page(page);
-			if (!unfalloc || !PageUptodate(page)) {
-				if (page->mapping == mapping) {
-					VM_BUG_ON_PAGE(PageWriteback(page), page);
-					truncate_inode_page(mapping, page);
-				}
-			}
+			if (!unfalloc || !PageUptodate(page))
+				shmem_undo_page(mapping, page, index, start, end);
 			unlock_page(page);
 		}
-		shmem_deswap_pagevec(&pvec);
+		pagevec_remove_exceptionals(&pvec);
 		pagevec_release(&pvec);
 		mem_cgroup_uncharge_end();
 		index++;
@@ -786,6 +974,8 @@ static int shmem_writepage(struct page *page, struct writeback_control *wbc)
 	pgoff_t index;
 
 	BUG_ON(!PageLocked(page));
+	/* reclaim splits a huge page before trying to swap it out */
+	VM_BUG_ON_PAGE(PageCompound(page), page);
 	mapping = page->mapping;
 	index = page->index;
 	inode = mapping->host;
@@ -947,6 +1137,32 @@ static struct page *shmem_alloc_page(gfp_t gfp,
 
 	return page;
 }
+
+#ifdef CONFIG_TRANSPARENT_HUGE_PAGECACHE
+static struct page *shmem_alloc_hugepage(gfp_t gfp,
+			struct shmem_inode_info *info, pgoff_t index)
+{
+	struct vm_area_struct pvma;
+	struct page *page;
+	pgoff_t hindex = round_down(index, HPAGE_PMD_NR);
+
+	/* Create a pseudo vma that just contains the policy */
+	pvma.vm_start = 0;
+	/* Bias interleave by inode number to distribute better across nodes */
+	pvma.vm_pgoff = hindex + info->vfs_inode.i_ino;
+	pvma.vm_ops = NULL;
+	pvma.vm_policy = mpol_shared_policy_lookup(&info->policy, hindex);
+
+	page = alloc_pages_vma(gfp, HPAGE_PMD_ORDER, &pvma, 0, numa_node_id());
+
+	/* Drop reference taken by mpol_shared_policy_lookup() */
+	mpol_cond_put(pvma.vm_policy);
+
+	if (page)
+		count_vm_event(THP_FILE_ALLOC);
+	return page;
+}
+#endif
 #else /* !CONFIG_NUMA */
 #ifdef CONFIG_TMPFS
 static inline void shmem_show_mpol(struct seq_file *seq, struct mempolicy *mpol)
@@ -965,8 +1181,29 @@ static inline struct page *shmem_alloc_page(gfp_t gfp,
 {
 	return alloc_page(gfp);
 }
+
+#ifdef CONFIG_TRANSPARENT_HUGE_PAGECACHE
+static inline struct page *shmem_alloc_hugepage(gfp_t gfp,
+			struct shmem_inode_info *info, pgoff_t index)
+{
+	struct page *page;
+
+	page = alloc_pages(gfp, HPAGE_PMD_ORDER);
+	if (page)
+		count_vm_event(THP_FILE_ALLOC);
+	return page;
+}
+#endif
 #endif /* CONFIG_NUMA */
 
+#ifndef CONFIG_TRANSPARENT_HUGE_PAGECACHE
+static inline struct page *shmem_alloc_hugepage(gfp_t gfp,
+			struct shmem_inode_info *info, pgoff_t index)
+{
+	return NULL;
+}
+#endif
+
 #if !defined(CONFIG_NUMA) || !defined(CONFIG_TMPFS)
 static inline struct mempolicy *shmem_get_sbmpol(struct shmem_sb_info *sbinfo)
 {
@@ -1057,6 +1294,59 @@ static int shmem_replace_page(struct page **pagep, gfp_t gfp,
 	return error;
 }
 
+/*
+ * Allocate a page for the file at @index, huge if @huge, and account it
+ * against the memory commitment, the size limit of the mount, and the
+ * memcg.  Returns the page locked, or an ERR_PTR with nothing accounted.
+ */
+static struct page *shmem_alloc_and_acct_page(gfp_t gfp, struct inode *inode,
+					      pgoff_t index, bool huge)
+{
+	struct shmem_inode_info *info = SHMEM_I(inode);
+	struct shmem_sb_info *sbinfo = SHMEM_SB(inode->i_sb);
+	struct page *page;
+	int nr = huge ? HPAGE_PMD_NR : 1;
+	int err = -ENOSPC;
+
+	if (shmem_acct_block(info->flags, nr))
+		goto failed;
+	if (sbinfo->max_blocks) {
+		if (percpu_counter_compare(&sbinfo->used_blocks,
+					   (s64)sbinfo->max_blocks - nr) > 0)
+			goto unacct;
+		percpu_counter_add(&sbinfo->used_blocks, nr);
+	}
+
+	if (huge)
+		page = shmem_alloc_hugepage(gfp | __GFP_COMP | __GFP_NORETRY |
+					    __GFP_NOWARN | __GFP_NO_KSWAPD,
+					    info, index);
+	else
+		page = shmem_alloc_page(gfp, info, index);
+	err = -ENOMEM;
+	if (!page)
+		goto decused;
+
+	SetPageSwapBacked(page);
+	__set_page_locked(page);
+	err = mem_cgroup_cache_charge(page, current->mm,
+				      gfp & GFP_RECLAIM_MASK);
+	if (err) {
+		unlock_page(page);
+		page_cache_release(page);
+		goto decused;
+	}
+	return page;
+
+decused:
+	if (sbinfo->max_blocks)
+		percpu_counter_add(&sbinfo->used_blocks, -nr);
+unacct:
+	shmem_unacct_blocks(info->flags, nr);
+failed:
+	return ERR_PTR(err);
+}
+
 /*
  * shmem_getpage_gfp - find page in cache, or get from swap, or allocate
  *
@@ -1075,17 +1365,29 @@ static int shmem_getpage_gfp(struct inode *inode, pgoff_t index,
 	int error;
 	int once = 0;
 	int alloced = 0;
+	int nr = 1;
 
 	if (index > (MAX_LFS_FILESIZE >> PAGE_CACHE_SHIFT))
 		return -EFBIG;
 repeat:
 	swap.val = 0;
-	page = find_lock_page(mapping, index);
+	page = find_lock_entry(mapping, index);
 	if (radix_tree_exceptional_entry(page)) {
 		swap = radix_to_swp_entry(page);
 		page = NULL;
 	}
 
+	if (page && PageTransHuge(page) && sgp == SGP_NOHUGE) {
+		/* the caller needs a small page: split it, then look again */
+		if (split_huge_page(page)) {
+			error = -EBUSY;
+			goto unlock;
+		}
+		unlock_page(page);
+		page_cache_release(page);
+		goto repeat;
+	}
+
 	if (sgp != SGP_WRITE && sgp != SGP_FALLOC &&
 	    ((loff_t)index << PAGE_CACHE_SHIFT) >= i_size_read(inode)) {
 		error = -EINVAL;
@@ -1178,35 +1480,26 @@ repeat:
 		swap_free(swap);
 
 	} else {
-		if (shmem_acct_block(info->flags)) {
-			error = -ENOSPC;
+		page = ERR_PTR(-ENOMEM);
+		if (shmem_huge_enabled(inode, index, sgp) &&
+		    shmem_huge_extent_empty(mapping,
+					    round_down(index, HPAGE_PMD_NR)))
+			page = shmem_alloc_and_acct_page(gfp, inode, index,
+							 true);
+		if (IS_ERR(page))
+			page = shmem_alloc_and_acct_page(gfp, inode, index,
+							 false);
+		if (IS_ERR(page)) {
+			error = PTR_ERR(page);
+			page = NULL;
 			goto failed;
 		}
-		if (sbinfo->max_blocks) {
-			if (percpu_counter_compare(&sbinfo->used_blocks,
-						sbinfo->max_blocks) >= 0) {
-				error = -ENOSPC;
-				goto unacct;
-			}
-			percpu_counter_inc(&sbinfo->used_blocks);
-		}
-
-		page = shmem_alloc_page(gfp, info, index);
-		if (!page) {
-			error = -ENOMEM;
-			goto decused;
-		}
 
-		SetPageSwapBacked(page);
-		__set_page_locked(page);
-		error = mem_cgroup_cache_charge(page, current->mm,
-						gfp & GFP_RECLAIM_MASK);
-		if (error)
-			goto decused;
+		nr = hpage_nr_pages(page);
 		error = radix_tree_maybe_preload(gfp & GFP_RECLAIM_MASK);
 		if (!error) {
-			error = shmem_add_to_page_cache(page, mapping, index,
-							gfp, NULL);
+			error = shmem_add_to_page_cache(page, mapping,
+					index & ~((pgoff_t)nr - 1), gfp, NULL);
 			radix_tree_preload_end();
 		}
 		if (error) {
@@ -1216,26 +1509,37 @@ repeat:
 		lru_cache_add_anon(page);
 
 		spin_lock(&info->lock);
-		info->alloced++;
-		inode->i_blocks += BLOCKS_PER_PAGE;
+		info->alloced += nr;
+		inode->i_blocks += BLOCKS_PER_PAGE * nr;
 		shmem_recalc_inode(inode);
 		spin_unlock(&info->lock);
 		alloced = true;
 
 		/*
 		 * Let SGP_FALLOC use the SGP_WRITE optimization on a new page.
+		 * A new huge page is left !Uptodate too, for undo on failure:
+		 * shmem_fallocate() steps over all of it, and whatever finds
+		 * it next initializes all of it: below, or split_huge_page()
+		 * before splitting it.
 		 */
-		if (sgp == SGP_FALLOC)
-			sgp = SGP_WRITE;
+		if (sgp == SGP_FALLOC) {
+			*pagep = page;
+			return 0;
+		}
 clear:
 		/*
 		 * Let SGP_WRITE caller clear ends if write does not fill page;
 		 * but SGP_FALLOC on a page fallocated earlier must initialize
 		 * it now, lest undo on failure cancel our earlier guarantee.
 		 */
-		if (sgp != SGP_WRITE) {
-			clear_highpage(page);
-			flush_dcache_page(page);
+		if (sgp != SGP_WRITE || PageTransHuge(page)) {
+			int i;
+
+			/* a huge page is never left partly initialized */
+			for (i = 0; i < hpage_nr_pages(page); i++) {
+				clear_highpage(page + i);
+				flush_dcache_page(page + i);
+			}
 			SetPageUptodate(page);
 		}
 		if (sgp == SGP_DIRTY)
@@ -1262,15 +1566,14 @@ trunc:
 	ClearPageDirty(page);
 	delete_from_page_cache(page);
 	spin_lock(&info->lock);
-	info->alloced--;
-	inode->i_blocks -= BLOCKS_PER_PAGE;
+	info->alloced -= nr;
+	inode->i_blocks -= BLOCKS_PER_PAGE * nr;
 	spin_unlock(&info->lock);
 decused:
 	sbinfo = SHMEM_SB(inode->i_sb);
 	if (sbinfo->max_blocks)
-		percpu_counter_add(&sbinfo->used_blocks, -1);
-unacct:
-	shmem_unacct_blocks(info->flags, 1);
+		percpu_counter_add(&sbinfo->used_blocks, -nr);
+	shmem_unacct_blocks(info->flags, nr);
 failed:
 	if (swap.val && error != -EINVAL &&
 	    !shmem_confirm_swap(mapping, index, swap))
@@ -1292,13 +1595,31 @@ unlock:
 	return error;
 }
 
+/*
+ * Unlock a page returned by shmem_getpage(), and trade the reference on
+ * a huge page for a reference on its subpage at @index: taken with the
+ * huge page locked, it holds the subpage even if the huge page is split.
+ */
+static struct page *shmem_unlock_subpage(struct page *page, pgoff_t index)
+{
+	struct page *subpage = shmem_subpage(page, index);
+
+	if (subpage != page)
+		get_page(subpage);
+	unlock_page(page);
+	if (subpage != page)
+		page_cache_release(page);
+	return subpage;
+}
+
 static int shmem_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
 {
 	struct inode *inode = file_inode(vma->vm_file);
 	int error;
 	int ret = VM_FAULT_LOCKED;
 
-	error = shmem_getpage(inode, vmf->pgoff, &vmf->page, SGP_CACHE, &ret);
+	/* a huge page is only ever mapped by pmd: split it for a pte */
+	error = shmem_getpage(inode, vmf->pgoff, &vmf->page, SGP_NOHUGE, &ret);
 	if (error)
 		return ((error == -ENOMEM) ? VM_FAULT_OOM : VM_FAULT_SIGBUS);
 
@@ -1309,6 +1630,53 @@ static int shmem_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
 	return ret;
 }
 
+#ifdef CONFIG_TRANSPARENT_HUGE_PAGECACHE
+static int shmem_pmd_fault(struct vm_area_struct *vma, unsigned long address,
+			   pmd_t *pmd, unsigned int flags)
+{
+	struct inode *inode = file_inode(vma->vm_file);
+	unsigned long haddr = address & HPAGE_PMD_MASK;
+	pgoff_t hindex = linear_page_index(vma, haddr);
+	enum sgp_type sgp;
+	struct page *page;
+	int ret;
+
+	/* private mappings copy on write into small anonymous pages */
+	if (!(vma->vm_flags & VM_SHARED) ||
+	    (vma->vm_flags & (VM_NONLINEAR | VM_NOHUGEPAGE)))
+		return VM_FAULT_FALLBACK;
+	if (haddr < vma->vm_start || haddr + HPAGE_PMD_SIZE > vma->vm_end)
+		return VM_FAULT_FALLBACK;
+	/* the huge page must be as aligned in the file as in the mapping */
+	if (hindex & (HPAGE_PMD_NR - 1))
+		return VM_FAULT_FALLBACK;
+	/* and must not map anything beyond the end of file */
+	if ((loff_t)(hindex + HPAGE_PMD_NR) << PAGE_CACHE_SHIFT >
+	    i_size_read(inode))
+		return VM_FAULT_FALLBACK;
+
+	/*
+	 * Any error, or a small page found or allocated, is left to
+	 * shmem_fault() to deal with.
+	 */
+	sgp = (vma->vm_flags & VM_HUGEPAGE) ? SGP_HUGE : SGP_CACHE;
+	if (shmem_getpage(inode, linear_page_index(vma, address), &page,
+			  sgp, NULL))
+		return VM_FAULT_FALLBACK;
+	if (!PageTransHuge(page)) {
+		unlock_page(page);
+		page_cache_release(page);
+		return VM_FAULT_FALLBACK;
+	}
+
+	ret = do_set_pmd(vma, address, pmd, page);
+	unlock_page(page);
+	if (ret)
+		page_cache_release(page);
+	return ret;
+}
+#endif
+
 #ifdef CONFIG_NUMA
 static int shmem_set_policy(struct vm_area_struct *vma, struct mempolicy *mpol)
 {
@@ -1434,7 +1802,13 @@ shmem_write_begin(struct file *file, struct address_space *mapping,
 {
 	struct inode *inode = mapping->host;
 	pgoff_t index = pos >> PAGE_CACHE_SHIFT;
-	return shmem_getpage(inode, index, pagep, SGP_WRITE, NULL);
+	int ret;
+
+	ret = shmem_getpage(inode, index, pagep, SGP_WRITE, NULL);
+	/* write into the subpage: shmem_write_end() unlocks the head */
+	if (!ret)
+		*pagep = shmem_subpage(*pagep, index);
+	return ret;
 }
 
 static int
@@ -1443,21 +1817,22 @@ shmem_write_end(struct file *file, struct address_space *mapping,
 			struct page *page, void *fsdata)
 {
 	struct inode *inode = mapping->host;
+	struct page *head = compound_head(page);
 
 	if (pos + copied > inode->i_size)
 		i_size_write(inode, pos + copied);
 
-	if (!PageUptodate(page)) {
+	if (!PageUptodate(head)) {
 		if (copied < PAGE_CACHE_SIZE) {
 			unsigned from = pos & (PAGE_CACHE_SIZE - 1);
 			zero_user_segments(page, 0, from,
 					from + copied, PAGE_CACHE_SIZE);
 		}
-		SetPageUptodate(page);
+		SetPageUptodate(head);
 	}
-	set_page_dirty(page);
-	unlock_page(page);
-	page_cache_release(page);
+	set_page_dirty(head);
+	unlock_page(head);
+	page_cache_release(head);
 
 	return copied;
 }
@@ -1502,8 +1877,14 @@ static void do_shmem_file_read(struct file *filp, loff_t *ppos, read_descriptor_
 				desc->error = 0;
 			break;
 		}
-		if (page)
-			unlock_page(page);
+		if (page) {
+			/*
+			 * Mark the page accessed if we read the beginning.
+			 */
+			if (!offset)
+				mark_page_accessed(page);
+			page = shmem_unlock_subpage(page, index);
+		}
 
 		/*
 		 * We must evaluate after, since reads (unlike writes)
@@ -1530,11 +1911,6 @@ static void do_shmem_file_read(struct file *filp, loff_t *ppos, read_descriptor_
 			 */
 			if (mapping_writably_mapped(mapping))
 				flush_dcache_page(page);
-			/*
-			 * Mark the page accessed if we read the beginning.
-			 */
-			if (!offset)
-				mark_page_accessed(page);
 		} else {
 			page = ZERO_PAGE(0);
 			page_cache_get(page);
@@ -1643,8 +2019,9 @@ static ssize_t shmem_file_splice_read(struct file *in, loff_t *ppos,
 	index += spd.nr_pages;
 	error = 0;
 
+	/* pipe buffers need pages of the page cache: split huge pages */
 	while (spd.nr_pages < nr_pages) {
-		error = shmem_getpage(inode, index, &page, SGP_CACHE, NULL);
+		error = shmem_getpage(inode, index, &page, SGP_NOHUGE, NULL);
 		if (error)
 			break;
 		unlock_page(page);
@@ -1667,7 +2044,7 @@ static ssize_t shmem_file_splice_read(struct file *in, loff_t *ppos,
 
 		if (!PageUptodate(page) || page->mapping != mapping) {
 			error = shmem_getpage(inode, index, &page,
-							SGP_CACHE, NULL);
+							SGP_NOHUGE, NULL);
 			if (error)
 				break;
 			unlock_page(page);
@@ -1729,7 +2106,7 @@ static pgoff_t shmem_seek_hole_data(struct address_space *mapping,
 	pagevec_init(&pvec, 0);
 	pvec.nr = 1;		/* start small: we may be there already */
 	while (!done) {
-		pvec.nr = shmem_find_get_pages_and_swap(mapping, index,
+		pvec.nr = find_get_entries(mapping, index,
 					pvec.nr, pvec.pages, indices);
 		if (!pvec.nr) {
 			if (whence == SEEK_DATA)
@@ -1756,7 +2133,7 @@ static pgoff_t shmem_seek_hole_data(struct address_space *mapping,
 				break;
 			}
 		}
-		shmem_deswap_pagevec(&pvec);
+		pagevec_remove_exceptionals(&pvec);
 		pagevec_release(&pvec);
 		pvec.nr = PAGEVEC_SIZE;
 		cond_resched();
@@ -1842,6 +2219,7 @@ static long shmem_fallocate(struct file *file, int mode, loff_t offset,
 
 	shmem_falloc.start = start;
 	shmem_falloc.next  = start;
+	shmem_falloc.end   = end;
 	shmem_falloc.nr_falloced = 0;
 	shmem_falloc.nr_unswapped = 0;
 	spin_lock(&inode->i_lock);
@@ -1873,10 +2251,14 @@ static long shmem_fallocate(struct file *file, int mode, loff_t offset,
 		/*
 		 * Inform shmem_writepage() how far we have reached.
 		 * No need for lock or barrier: we have the page lock.
+		 * A huge page covers the rest of its extent, step over it.
 		 */
-		shmem_falloc.next++;
+		if (PageTransHuge(page))
+			index = page->index + hpage_nr_pages(page) - 1;
 		if (!PageUptodate(page))
-			shmem_falloc.nr_falloced++;
+			shmem_falloc.nr_falloced += index + 1 -
+						    shmem_falloc.next;
+		shmem_falloc.next = index + 1;
 
 		/*
 		 * If !PageUptodate, leave it that way so that freeable pages
@@ -2484,6 +2866,18 @@ static int shmem_parse_options(char *options, struct shmem_sb_info *sbinfo,
 			mpol = NULL;
 			if (mpol_parse_str(value, &mpol))
 				goto bad_val;
+#ifdef CONFIG_TRANSPARENT_HUGE_PAGECACHE
+		} else if (!strcmp(this_char, "huge")) {
+			int huge;
+
+			huge = shmem_parse_huge(value);
+			if (huge < 0)
+				goto bad_val;
+			if (!has_transparent_hugepage() &&
+			    huge != SHMEM_HUGE_NEVER)
+				goto bad_val;
+			sbinfo->huge = huge;
+#endif
 		} else {
 			printk(KERN_ERR "tmpfs: Bad mount option %s\n",
 			       this_char);
@@ -2530,6 +2924,7 @@ static int shmem_remount_fs(struct super_block *sb, int *flags, char *data)
 		goto out;
 
 	error = 0;
+	sbinfo->huge = config.huge;
 	sbinfo->max_blocks  = config.max_blocks;
 	sbinfo->max_inodes  = config.max_inodes;
 	sbinfo->free_inodes = config.max_inodes - inodes;
@@ -2563,6 +2958,10 @@ static int shmem_show_options(struct seq_file *seq, struct dentry *root)
 	if (!gid_eq(sbinfo->gid, GLOBAL_ROOT_GID))
 		seq_printf(seq, ",gid=%u",
 				from_kgid_munged(&init_user_ns, sbinfo->gid));
+#ifdef CONFIG_TRANSPARENT_HUGE_PAGECACHE
+	if (sbinfo->huge)
+		seq_printf(seq, ",huge=%s", shmem_format_huge(sbinfo->huge));
+#endif
 	shmem_show_mpol(seq, sbinfo->mpol);
 	return 0;
 }
@@ -2783,6 +3182,9 @@ static const struct super_operations shmem_ops = {
 
 static const struct vm_operations_struct shmem_vm_ops = {
 	.fault		= shmem_fault,
+#ifdef CONFIG_TRANSPARENT_HUGE_PAGECACHE
+	.pmd_fault	= shmem_pmd_fault,
+#endif
 #ifdef CONFIG_NUMA
 	.set_policy     = shmem_set_policy,
 	.get_policy     = shmem_get_policy,
@@ -2878,6 +3280,11 @@ int shmem_unuse(swp_entry_t swap, struct page *page)
 	return 0;
 }
 
+bool shmem_mapping(struct address_space *mapping)
+{
+	return false;
+}
+
 int shmem_lock(struct file *file, int lock, struct user_struct *user)
 {
 	return 0;
@@ -3034,7 +3441,8 @@ struct page *shmem_read_mapping_page_gfp(struct address_space *mapping,
 	int error;
 
 	BUG_ON(mapping->a_ops != &shmem_aops);
-	error = shmem_getpage_gfp(inode, index, &page, SGP_CACHE, gfp, NULL);
+	/* drivers map and pin these pages one by one: no huge pages */
+	error = shmem_getpage_gfp(inode, index, &page, SGP_NOHUGE, gfp, NULL);
 	if (error)
 		page = ERR_PTR(error);
 	else
@@ -92,6 +92,13 @@ __kmem_cache_alias(struct mem_cgroup *memcg, const char *name, size_t size,
 
 int __kmem_cache_shutdown(struct kmem_cache *);
 
+/*
+ * Generic implementation of the bulk operations, one object at a time,
+ * for allocators or caches that cannot do better.
+ */
+void __kmem_cache_free_bulk(struct kmem_cache *, size_t, void **);
+int __kmem_cache_alloc_bulk(struct kmem_cache *, gfp_t, size_t, void **);
+
 struct seq_file;
 struct file;
 
@@ -2698,6 +2698,127 @@ void kmem_cache_free(struct kmem_cache *s, void *x)
 }
 EXPORT_SYMBOL(kmem_cache_free);
 
+/*
+ * Bulk free: objects belonging to the current cpu slab go onto the per
+ * cpu freelist with interrupts disabled once for the whole array,
+ * instead of a cmpxchg_double per object.  Anything else takes the
+ * __slab_free() slowpath.
+ */
+void kmem_cache_free_bulk(struct kmem_cache *s, size_t size, void **p)
+{
+	struct kmem_cache_cpu *c;
+	struct kmem_cache *cachep;
+	struct page *page;
+	size_t i;
+
+	local_irq_disable();
+	c = this_cpu_ptr(s->cpu_slab);
+
+	for (i = 0; i < size; i++) {
+		void *object = p[i];
+
+		BUG_ON(!object);
+		cachep = cache_from_obj(s, object);
+		if (unlikely(!cachep))
+			continue;
+		slab_free_hook(cachep, object);
+		trace_kmem_cache_free(_RET_IP_, object);
+
+		page = virt_to_head_page(object);
+
+		if (likely(cachep == s && page == c->page)) {
+			/* Fastpath: local cpu free */
+			set_freepointer(s, object, c->freelist);
+			c->freelist = object;
+			stat(s, FREE_FASTPATH);
+		} else {
+			/*
+			 * Let any lockless fastpath that we interrupted
+			 * notice the changes to the freelist so far.
+			 */
+			c->tid = next_tid(c->tid);
+			local_irq_enable();
+			__slab_free(cachep, page, object, _RET_IP_);
+			local_irq_disable();
+			c = this_cpu_ptr(s->cpu_slab);
+		}
+	}
+	c->tid = next_tid(c->tid);
+	local_irq_enable();
+}
+EXPORT_SYMBOL(kmem_cache_free_bulk);
+
+/*
+ * Bulk alloc: take objects from the per cpu freelist with interrupts
+ * disabled once for the whole array.  When it runs dry, __slab_alloc()
+ * refills it from the freelist of the cpu slab, a partial slab or a new
+ * one.  Returns @size, or 0 if not all objects could be allocated, in
+ * which case none are.
+ */
+int kmem_cache_alloc_bulk(struct kmem_cache *s, gfp_t flags, size_t size,
+								void **p)
+{
+	struct kmem_cache_cpu *c;
+	size_t i;
+
+	/* Debugging fallback to generic bulk */
+	if (kmem_cache_debug(s))
+		return __kmem_cache_alloc_bulk(s, flags, size, p);
+
+	if (slab_pre_alloc_hook(s, flags))
+		return 0;
+
+	s = memcg_kmem_get_cache(s, flags);
+
+	local_irq_disable();
+	c = this_cpu_ptr(s->cpu_slab);
+
+	for (i = 0; i < size; i++) {
+		void *object = c->freelist;
+
+		if (unlikely(!object)) {
+			c->tid = next_tid(c->tid);
+			local_irq_enable();
+			/*
+			 * The slowpath refills the per cpu freelist as a
+			 * side effect, the following objects come from it.
+			 */
+			p[i] = __slab_alloc(s, flags, NUMA_NO_NODE,
+					    _RET_IP_, c);
+			if (unlikely(!p[i]))
+				goto error;
+			local_irq_disable();
+			c = this_cpu_ptr(s->cpu_slab);
+			continue;
+		}
+
+		c->freelist = get_freepointer(s, object);
+		p[i] = object;
+		stat(s, ALLOC_FASTPATH);
+	}
+	c->tid = next_tid(c->tid);
+	local_irq_enable();
+
+	/* Clear memory and run the hooks outside the irq disabled loop */
+	for (i = 0; i < size; i++) {
+		if (unlikely(flags & __GFP_ZERO))
+			memset(p[i], 0, s->object_size);
+		slab_post_alloc_hook(s, flags, p[i]);
+		trace_kmem_cache_alloc(_RET_IP_, p[i], s->object_size,
+				       s->size, flags);
+	}
+
+	return size;
+
+error:
+	size = i;
+	for (i = 0; i < size; i++)
+		slab_post_alloc_hook(s, flags, p[i]);
+	kmem_cache_free_bulk(s, size, p);
+	return 0;
+}
+EXPORT_SYMBOL(kmem_cache_alloc_bulk);
+
 /*
  * Object placement in a slab is made very easy because we always start at
  * offset 0. If we tune the size of the object to the alignment then we can
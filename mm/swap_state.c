@@ -321,6 +321,16 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 		if (found_page)
 			break;
 
+		/*
+		 * Slots freed into the per-cpu swap slots caches keep
+		 * SWAP_HAS_CACHE set until they are returned, which would
+		 * make us spin on -EEXIST below: skip readahead of such
+		 * unused slots.  swapoff disables the caches first, so
+		 * try_to_unuse() still gets to wait for racing swapins.
+		 */
+		if (swap_slot_cache_enabled && !__swp_swapcount(entry))
+			break;
+
 		/*
 		 * Get a new page to read into from swap.
 		 */
@@ -3322,8 +3322,9 @@ static void net_tx_action(struct softirq_action *h)
 				trace_consume_skb(skb);
 			else
 				trace_kfree_skb(skb, net_tx_action);
-			__kfree_skb(skb);
+			__kfree_skb_defer(skb);
 		}
+		__kfree_skb_flush();
 	}
 
 	if (sd->output_queue) {
@@ -39,6 +39,7 @@
 #include <linux/ratelimit.h>
 #include <linux/seccomp.h>
 #include <linux/if_vlan.h>
+#include <net/sock_reuseport.h>
 
 /* No hurry in this branch
  *
@@ -119,10 +120,86 @@ EXPORT_SYMBOL(sk_filter);
  * Because all jumps are guaranteed to be before last instruction,
  * and last instruction guaranteed to be a RET, we dont need to check
  * flen. (We used to pass to this function the length of filter)
+ *
+ * The opcodes have already been translated by sk_chk_filter() into the
+ * dense BPF_S_* space, so dispatch is threaded: every handler jumps
+ * straight to the handler of the next instruction through a table
+ * indexed by opcode instead of going back through a switch. This
+ * removes the bounds check and the shared indirect branch of the switch
+ * and gives the branch predictor one site per opcode.
  */
 unsigned int sk_run_filter(const struct sk_buff *skb,
 			   const struct sock_filter *fentry)
 {
+	static const void *jumptable[BPF_S_ANC_PAY_OFFSET + 1] = {
+		[0 ... BPF_S_ANC_PAY_OFFSET] = &&default_label,
+		[BPF_S_RET_K] = &&RET_K,
+		[BPF_S_RET_A] = &&RET_A,
+		[BPF_S_ALU_ADD_K] = &&ALU_ADD_K,
+		[BPF_S_ALU_ADD_X] = &&ALU_ADD_X,
+		[BPF_S_ALU_SUB_K] = &&ALU_SUB_K,
+		[BPF_S_ALU_SUB_X] = &&ALU_SUB_X,
+		[BPF_S_ALU_MUL_K] = &&ALU_MUL_K,
+		[BPF_S_ALU_MUL_X] = &&ALU_MUL_X,
+		[BPF_S_ALU_DIV_X] = &&ALU_DIV_X,
+		[BPF_S_ALU_MOD_K] = &&ALU_MOD_K,
+		[BPF_S_ALU_MOD_X] = &&ALU_MOD_X,
+		[BPF_S_ALU_AND_K] = &&ALU_AND_K,
+		[BPF_S_ALU_AND_X] = &&ALU_AND_X,
+		[BPF_S_ALU_OR_K] = &&ALU_OR_K,
+		[BPF_S_ALU_OR_X] = &&ALU_OR_X,
+		[BPF_S_ALU_XOR_K] = &&ALU_XOR_K,
+		[BPF_S_ALU_XOR_X] = &&ALU_XOR_X,
+		[BPF_S_ALU_LSH_K] = &&ALU_LSH_K,
+		[BPF_S_ALU_LSH_X] = &&ALU_LSH_X,
+		[BPF_S_ALU_RSH_K] = &&ALU_RSH_K,
+		[BPF_S_ALU_RSH_X] = &&ALU_RSH_X,
+		[BPF_S_ALU_NEG] = &&ALU_NEG,
+		[BPF_S_LD_W_ABS] = &&LD_W_ABS,
+		[BPF_S_LD_H_ABS] = &&LD_H_ABS,
+		[BPF_S_LD_B_ABS] = &&LD_B_ABS,
+		[BPF_S_LD_W_LEN] = &&LD_W_LEN,
+		[BPF_S_LD_W_IND] = &&LD_W_IND,
+		[BPF_S_LD_H_IND] = &&LD_H_IND,
+		[BPF_S_LD_B_IND] = &&LD_B_IND,
+		[BPF_S_LD_IMM] = &&LD_IMM,
+		[BPF_S_LDX_W_LEN] = &&LDX_W_LEN,
+		[BPF_S_LDX_B_MSH] = &&LDX_B_MSH,
+		[BPF_S_LDX_IMM] = &&LDX_IMM,
+		[BPF_S_MISC_TAX] = &&MISC_TAX,
+		[BPF_S_MISC_TXA] = &&MISC_TXA,
+		[BPF_S_ALU_DIV_K] = &&ALU_DIV_K,
+		[BPF_S_LD_MEM] = &&LD_MEM,
+		[BPF_S_LDX_MEM] = &&LDX_MEM,
+		[BPF_S_ST] = &&ST_MEM,
+		[BPF_S_STX] = &&STX_MEM,
+		[BPF_S_JMP_JA] = &&JMP_JA,
+		[BPF_S_JMP_JEQ_K] = &&JMP_JEQ_K,
+		[BPF_S_JMP_JEQ_X] = &&JMP_JEQ_X,
+		[BPF_S_JMP_JGE_K] = &&JMP_JGE_K,
+		[BPF_S_JMP_JGE_X] = &&JMP_JGE_X,
+		[BPF_S_JMP_JGT_K] = &&JMP_JGT_K,
+		[BPF_S_JMP_JGT_X] = &&JMP_JGT_X,
+		[BPF_S_JMP_JSET_K] = &&JMP_JSET_K,
+		[BPF_S_JMP_JSET_X] = &&JMP_JSET_X,
+		[BPF_S_ANC_PROTOCOL] = &&ANC_PROTOCOL,
+		[BPF_S_ANC_PKTTYPE] = &&ANC_PKTTYPE,
+		[BPF_S_ANC_IFINDEX] = &&ANC_IFINDEX,
+		[BPF_S_ANC_NLATTR] = &&ANC_NLATTR,
+		[BPF_S_ANC_NLATTR_NEST] = &&ANC_NLATTR_NEST,
+		[BPF_S_ANC_MARK] = &&ANC_MARK,
+		[BPF_S_ANC_QUEUE] = &&ANC_QUEUE,
+		[BPF_S_ANC_HATYPE] = &&ANC_HATYPE,
+		[BPF_S_ANC_RXHASH] = &&ANC_RXHASH,
+		[BPF_S_ANC_CPU] = &&ANC_CPU,
+		[BPF_S_ANC_ALU_XOR_X] = &&ALU_XOR_X,
+#ifdef CONFIG_SECCOMP_FILTER
+		[BPF_S_ANC_SECCOMP_LD_W] = &&ANC_SECCOMP_LD_W,
+#endif
+		[BPF_S_ANC_VLAN_TAG] = &&ANC_VLAN_TAG,
+		[BPF_S_ANC_VLAN_TAG_PRESENT] = &&ANC_VLAN_TAG_PRESENT,
+		[BPF_S_ANC_PAY_OFFSET] = &&ANC_PAY_OFFSET,
+	};
 	void *ptr;
 	u32 A = 0;			/* Accumulator */
 	u32 X = 0;			/* Index Register */
@@ -130,277 +207,1111 @@ unsigned int sk_run_filter(const struct sk_buff *skb,
 	u32 tmp;
 	int k;
 
+#define K	(fentry->k)
+#define CONT	({ fentry++; goto select_insn; })
+#define CONT_JMP(off)	({ fentry += (off) + 1; goto select_insn; })
+
+select_insn:
+	goto *jumptable[fentry->code];
+
 	/*
 	 * Process array of filter instructions.
 	 */
-	for (;; fentry++) {
-#if defined(CONFIG_X86_32)
-#define	K (fentry->k)
-#else
-		const u32 K = fentry->k;
+ALU_ADD_X:
+	A += X;
+	CONT;
+ALU_ADD_K:
+	A += K;
+	CONT;
+ALU_SUB_X:
+	A -= X;
+	CONT;
+ALU_SUB_K:
+	A -= K;
+	CONT;
+ALU_MUL_X:
+	A *= X;
+	CONT;
+ALU_MUL_K:
+	A *= K;
+	CONT;
+ALU_DIV_X:
+	if (X == 0)
+		return 0;
+	A /= X;
+	CONT;
+ALU_DIV_K:
+	A /= K;
+	CONT;
+ALU_MOD_X:
+	if (X == 0)
+		return 0;
+	A %= X;
+	CONT;
+ALU_MOD_K:
+	A %= K;
+	CONT;
+ALU_AND_X:
+	A &= X;
+	CONT;
+ALU_AND_K:
+	A &= K;
+	CONT;
+ALU_OR_X:
+	A |= X;
+	CONT;
+ALU_OR_K:
+	A |= K;
+	CONT;
+ALU_XOR_X:
+	A ^= X;
+	CONT;
+ALU_XOR_K:
+	A ^= K;
+	CONT;
+ALU_LSH_X:
+	A <<= X;
+	CONT;
+ALU_LSH_K:
+	A <<= K;
+	CONT;
+ALU_RSH_X:
+	A >>= X;
+	CONT;
+ALU_RSH_K:
+	A >>= K;
+	CONT;
+ALU_NEG:
+	A = -A;
+	CONT;
+JMP_JA:
+	CONT_JMP(K);
+JMP_JGT_K:
+	CONT_JMP((A > K) ? fentry->jt : fentry->jf);
+JMP_JGE_K:
+	CONT_JMP((A >= K) ? fentry->jt : fentry->jf);
+JMP_JEQ_K:
+	CONT_JMP((A == K) ? fentry->jt : fentry->jf);
+JMP_JSET_K:
+	CONT_JMP((A & K) ? fentry->jt : fentry->jf);
+JMP_JGT_X:
+	CONT_JMP((A > X) ? fentry->jt : fentry->jf);
+JMP_JGE_X:
+	CONT_JMP((A >= X) ? fentry->jt : fentry->jf);
+JMP_JEQ_X:
+	CONT_JMP((A == X) ? fentry->jt : fentry->jf);
+JMP_JSET_X:
+	CONT_JMP((A & X) ? fentry->jt : fentry->jf);
+LD_W_ABS:
+	k = K;
+load_w:
+	ptr = load_pointer(skb, k, 4, &tmp);
+	if (ptr != NULL) {
+		A = get_unaligned_be32(ptr);
+		CONT;
+	}
+	return 0;
+LD_H_ABS:
+	k = K;
+load_h:
+	ptr = load_pointer(skb, k, 2, &tmp);
+	if (ptr != NULL) {
+		A = get_unaligned_be16(ptr);
+		CONT;
+	}
+	return 0;
+LD_B_ABS:
+	k = K;
+load_b:
+	ptr = load_pointer(skb, k, 1, &tmp);
+	if (ptr != NULL) {
+		A = *(u8 *)ptr;
+		CONT;
+	}
+	return 0;
+LD_W_LEN:
+	A = skb->len;
+	CONT;
+LDX_W_LEN:
+	X = skb->len;
+	CONT;
+LD_W_IND:
+	k = X + K;
+	goto load_w;
+LD_H_IND:
+	k = X + K;
+	goto load_h;
+LD_B_IND:
+	k = X + K;
+	goto load_b;
+LDX_B_MSH:
+	ptr = load_pointer(skb, K, 1, &tmp);
+	if (ptr != NULL) {
+		X = (*(u8 *)ptr & 0xf) << 2;
+		CONT;
+	}
+	return 0;
+LD_IMM:
+	A = K;
+	CONT;
+LDX_IMM:
+	X = K;
+	CONT;
+LD_MEM:
+	A = mem[K];
+	CONT;
+LDX_MEM:
+	X = mem[K];
+	CONT;
+MISC_TAX:
+	X = A;
+	CONT;
+MISC_TXA:
+	A = X;
+	CONT;
+RET_K:
+	return K;
+RET_A:
+	return A;
+ST_MEM:
+	mem[K] = A;
+	CONT;
+STX_MEM:
+	mem[K] = X;
+	CONT;
+ANC_PROTOCOL:
+	A = ntohs(skb->protocol);
+	CONT;
+ANC_PKTTYPE:
+	A = skb->pkt_type;
+	CONT;
+ANC_IFINDEX:
+	if (!skb->dev)
+		return 0;
+	A = skb->dev->ifindex;
+	CONT;
+ANC_MARK:
+	A = skb->mark;
+	CONT;
+ANC_QUEUE:
+	A = skb->queue_mapping;
+	CONT;
+ANC_HATYPE:
+	if (!skb->dev)
+		return 0;
+	A = skb->dev->type;
+	CONT;
+ANC_RXHASH:
+	A = skb->rxhash;
+	CONT;
+ANC_CPU:
+	A = raw_smp_processor_id();
+	CONT;
+ANC_VLAN_TAG:
+	A = vlan_tx_tag_get(skb);
+	CONT;
+ANC_VLAN_TAG_PRESENT:
+	A = !!vlan_tx_tag_present(skb);
+	CONT;
+ANC_PAY_OFFSET:
+	A = __skb_get_poff(skb);
+	CONT;
+ANC_NLATTR: {
+		struct nlattr *nla;
+
+		if (skb_is_nonlinear(skb))
+			return 0;
+		if (A > skb->len - sizeof(struct nlattr))
+			return 0;
+
+		nla = nla_find((struct nlattr *)&skb->data[A],
+			       skb->len - A, X);
+		if (nla)
+			A = (void *)nla - (void *)skb->data;
+		else
+			A = 0;
+		CONT;
+	}
+ANC_NLATTR_NEST: {
+		struct nlattr *nla;
+
+		if (skb_is_nonlinear(skb))
+			return 0;
+		if (A > skb->len - sizeof(struct nlattr))
+			return 0;
+
+		nla = (struct nlattr *)&skb->data[A];
+		if (nla->nla_len > A - skb->len)
+			return 0;
+
+		nla = nla_find_nested(nla, X);
+		if (nla)
+			A = (void *)nla - (void *)skb->data;
+		else
+			A = 0;
+		CONT;
+	}
+#ifdef CONFIG_SECCOMP_FILTER
+ANC_SECCOMP_LD_W:
+	A = seccomp_bpf_load(fentry->k);
+	CONT;
 #endif
+default_label:
+	WARN_RATELIMIT(1, "Unknown code:%u jt:%u tf:%u k:%u\n",
+		       fentry->code, fentry->jt,
+		       fentry->jf, fentry->k);
+	return 0;
 
-		switch (fentry->code) {
-		case BPF_S_ALU_ADD_X:
-			A += X;
-			continue;
-		case BPF_S_ALU_ADD_K:
-			A += K;
-			continue;
-		case BPF_S_ALU_SUB_X:
-			A -= X;
-			continue;
-		case BPF_S_ALU_SUB_K:
-			A -= K;
-			continue;
-		case BPF_S_ALU_MUL_X:
-			A *= X;
-			continue;
-		case BPF_S_ALU_MUL_K:
-			A *= K;
-			continue;
-		case BPF_S_ALU_DIV_X:
-			if (X == 0)
-				return 0;
-			A /= X;
-			continue;
-		case BPF_S_ALU_DIV_K:
-			A /= K;
-			continue;
-		case BPF_S_ALU_MOD_X:
-			if (X == 0)
-				return 0;
-			A %= X;
-			continue;
-		case BPF_S_ALU_MOD_K:
-			A %= K;
-			continue;
-		case BPF_S_ALU_AND_X:
-			A &= X;
-			continue;
-		case BPF_S_ALU_AND_K:
-			A &= K;
-			continue;
-		case BPF_S_ALU_OR_X:
-			A |= X;
-			continue;
-		case BPF_S_ALU_OR_K:
-			A |= K;
-			continue;
-		case BPF_S_ANC_ALU_XOR_X:
+#undef CONT_JMP
+#undef CONT
+#undef K
+}
+EXPORT_SYMBOL(sk_run_filter);
+
+/*
+ * Helpers called from internal programs through BPF_CALL.  The call
+ * passes R1-R5 and the helper's return value lands in R0; the immediate
+ * of the call is the helper's offset from __bpf_call_base().
+ */
+static u64 __bpf_call_base(u64 r1, u64 r2, u64 r3, u64 r4, u64 r5)
+{
+	return 0;
+}
+
+#define BPF_CALL_IMM(fn)	((void *)(fn) - (void *)__bpf_call_base)
+
+/* Ancillary loads that end the program with 0 in the classic interpreter */
+#define BPF_ANC_ABORT	((u64)-1)
+
+static u64 __skb_get_pkt_type(u64 ctx, u64 A, u64 X, u64 r4, u64 r5)
+{
+	return ((struct sk_buff *)(unsigned long)ctx)->pkt_type;
+}
+
+static u64 __skb_get_pay_offset(u64 ctx, u64 A, u64 X, u64 r4, u64 r5)
+{
+	return __skb_get_poff((struct sk_buff *)(unsigned long)ctx);
+}
+
+static u64 __skb_get_nlattr(u64 ctx, u64 A, u64 X, u64 r4, u64 r5)
+{
+	struct sk_buff *skb = (struct sk_buff *)(unsigned long)ctx;
+	struct nlattr *nla;
+
+	if (skb_is_nonlinear(skb))
+		return BPF_ANC_ABORT;
+	if ((u32)A > skb->len - sizeof(struct nlattr))
+		return BPF_ANC_ABORT;
+
+	nla = nla_find((struct nlattr *)&skb->data[(u32)A],
+		       skb->len - (u32)A, (u32)X);
+	if (nla)
+		return (void *)nla - (void *)skb->data;
+	return 0;
+}
+
+static u64 __skb_get_nlattr_nest(u64 ctx, u64 A, u64 X, u64 r4, u64 r5)
+{
+	struct sk_buff *skb = (struct sk_buff *)(unsigned long)ctx;
+	struct nlattr *nla;
+
+	if (skb_is_nonlinear(skb))
+		return BPF_ANC_ABORT;
+	if ((u32)A > skb->len - sizeof(struct nlattr))
+		return BPF_ANC_ABORT;
+
+	nla = (struct nlattr *)&skb->data[(u32)A];
+	if (nla->nla_len > (u32)A - skb->len)
+		return BPF_ANC_ABORT;
+
+	nla = nla_find_nested(nla, (u32)X);
+	if (nla)
+		return (void *)nla - (void *)skb->data;
+	return 0;
+}
+
+static u64 __get_raw_cpu_id(u64 ctx, u64 A, u64 X, u64 r4, u64 r5)
+{
+	return raw_smp_processor_id();
+}
+
+#ifdef CONFIG_SECCOMP_FILTER
+static u64 __seccomp_load(u64 off, u64 r2, u64 r3, u64 r4, u64 r5)
+{
+	return seccomp_bpf_load((int)off);
+}
+#endif
+
+/**
+ *	sk_run_filter_int - run an internal BPF program
+ *	@ctx: context the program was translated for, the skb for socket
+ *	      filters, NULL for seccomp
+ *	@insn: program produced by sk_convert_filter()
+ *
+ * Like sk_run_filter(), dispatch is threaded through a table indexed
+ * by opcode, but the wider instruction set lets sk_convert_filter() fold
+ * operand decoding into the opcode and keep A, X and the scratch memory
+ * in registers and on the stack.  Returns R0 when the program exits.
+ */
+unsigned int sk_run_filter_int(void *ctx, const struct sock_filter_int *insn)
+{
+	u64 stack[MAX_BPF_STACK / sizeof(u64)];
+	u64 regs[MAX_BPF_REG], tmp;
+	void *ptr;
+	int off;
+
+#define K	insn->imm
+#define A	regs[insn->a_reg]
+#define X	regs[insn->x_reg]
+#define R0	regs[BPF_REG_0]
+
+#define CONT	({ insn++; goto select_insn; })
+#define CONT_JMP ({ insn++; goto select_insn; })
+
+	static const void *jumptable[256] = {
+		[0 ... 255] = &&default_label,
+#define DL(A, B, C)	[A|B|C] = &&A##_##B##_##C
+		DL(BPF_ALU, BPF_ADD, BPF_X),
+		DL(BPF_ALU, BPF_ADD, BPF_K),
+		DL(BPF_ALU, BPF_SUB, BPF_X),
+		DL(BPF_ALU, BPF_SUB, BPF_K),
+		DL(BPF_ALU, BPF_AND, BPF_X),
+		DL(BPF_ALU, BPF_AND, BPF_K),
+		DL(BPF_ALU, BPF_OR, BPF_X),
+		DL(BPF_ALU, BPF_OR, BPF_K),
+		DL(BPF_ALU, BPF_LSH, BPF_X),
+		DL(BPF_ALU, BPF_LSH, BPF_K),
+		DL(BPF_ALU, BPF_RSH, BPF_X),
+		DL(BPF_ALU, BPF_RSH, BPF_K),
+		DL(BPF_ALU, BPF_XOR, BPF_X),
+		DL(BPF_ALU, BPF_XOR, BPF_K),
+		DL(BPF_ALU, BPF_MUL, BPF_X),
+		DL(BPF_ALU, BPF_MUL, BPF_K),
+		DL(BPF_ALU, BPF_MOV, BPF_X),
+		DL(BPF_ALU, BPF_MOV, BPF_K),
+		DL(BPF_ALU, BPF_DIV, BPF_X),
+		DL(BPF_ALU, BPF_DIV, BPF_K),
+		DL(BPF_ALU, BPF_MOD, BPF_X),
+		DL(BPF_ALU, BPF_MOD, BPF_K),
+		DL(BPF_ALU, BPF_NEG, 0),
+		DL(BPF_ALU, BPF_END, BPF_TO_BE),
+		DL(BPF_ALU, BPF_END, BPF_TO_LE),
+		DL(BPF_ALU64, BPF_ADD, BPF_X),
+		DL(BPF_ALU64, BPF_ADD, BPF_K),
+		DL(BPF_ALU64, BPF_SUB, BPF_X),
+		DL(BPF_ALU64, BPF_SUB, BPF_K),
+		DL(BPF_ALU64, BPF_AND, BPF_X),
+		DL(BPF_ALU64, BPF_AND, BPF_K),
+		DL(BPF_ALU64, BPF_OR, BPF_X),
+		DL(BPF_ALU64, BPF_OR, BPF_K),
+		DL(BPF_ALU64, BPF_LSH, BPF_X),
+		DL(BPF_ALU64, BPF_LSH, BPF_K),
+		DL(BPF_ALU64, BPF_RSH, BPF_X),
+		DL(BPF_ALU64, BPF_RSH, BPF_K),
+		DL(BPF_ALU64, BPF_XOR, BPF_X),
+		DL(BPF_ALU64, BPF_XOR, BPF_K),
+		DL(BPF_ALU64, BPF_MUL, BPF_X),
+		DL(BPF_ALU64, BPF_MUL, BPF_K),
+		DL(BPF_ALU64, BPF_MOV, BPF_X),
+		DL(BPF_ALU64, BPF_MOV, BPF_K),
+		DL(BPF_ALU64, BPF_ARSH, BPF_X),
+		DL(BPF_ALU64, BPF_ARSH, BPF_K),
+		DL(BPF_ALU64, BPF_DIV, BPF_X),
+		DL(BPF_ALU64, BPF_DIV, BPF_K),
+		DL(BPF_ALU64, BPF_MOD, BPF_X),
+		DL(BPF_ALU64, BPF_MOD, BPF_K),
+		DL(BPF_ALU64, BPF_NEG, 0),
+		DL(BPF_JMP, BPF_CALL, 0),
+		DL(BPF_JMP, BPF_JA, 0),
+		DL(BPF_JMP, BPF_JEQ, BPF_X),
+		DL(BPF_JMP, BPF_JEQ, BPF_K),
+		DL(BPF_JMP, BPF_JNE, BPF_X),
+		DL(BPF_JMP, BPF_JNE, BPF_K),
+		DL(BPF_JMP, BPF_JGT, BPF_X),
+		DL(BPF_JMP, BPF_JGT, BPF_K),
+		DL(BPF_JMP, BPF_JGE, BPF_X),
+		DL(BPF_JMP, BPF_JGE, BPF_K),
+		DL(BPF_JMP, BPF_JSGT, BPF_X),
+		DL(BPF_JMP, BPF_JSGT, BPF_K),
+		DL(BPF_JMP, BPF_JSGE, BPF_X),
+		DL(BPF_JMP, BPF_JSGE, BPF_K),
+		DL(BPF_JMP, BPF_JSET, BPF_X),
+		DL(BPF_JMP, BPF_JSET, BPF_K),
+		DL(BPF_JMP, BPF_EXIT, 0),
+		DL(BPF_STX, BPF_MEM, BPF_B),
+		DL(BPF_STX, BPF_MEM, BPF_H),
+		DL(BPF_STX, BPF_MEM, BPF_W),
+		DL(BPF_STX, BPF_MEM, BPF_DW),
+		DL(BPF_STX, BPF_XADD, BPF_W),
+		DL(BPF_STX, BPF_XADD, BPF_DW),
+		DL(BPF_ST, BPF_MEM, BPF_B),
+		DL(BPF_ST, BPF_MEM, BPF_H),
+		DL(BPF_ST, BPF_MEM, BPF_W),
+		DL(BPF_ST, BPF_MEM, BPF_DW),
+		DL(BPF_LDX, BPF_MEM, BPF_B),
+		DL(BPF_LDX, BPF_MEM, BPF_H),
+		DL(BPF_LDX, BPF_MEM, BPF_W),
+		DL(BPF_LDX, BPF_MEM, BPF_DW),
+		DL(BPF_LD, BPF_ABS, BPF_W),
+		DL(BPF_LD, BPF_ABS, BPF_H),
+		DL(BPF_LD, BPF_ABS, BPF_B),
+		DL(BPF_LD, BPF_IND, BPF_W),
+		DL(BPF_LD, BPF_IND, BPF_H),
+		DL(BPF_LD, BPF_IND, BPF_B),
+#undef DL
+	};
+
+	regs[BPF_REG_10] = (u64)(unsigned long)&stack[ARRAY_SIZE(stack)];
+	regs[BPF_REG_1] = (u64)(unsigned long)ctx;
+
+select_insn:
+	goto *jumptable[insn->code];
+
+	/* ALU */
+#define ALU(OPCODE, OP)				\
+	BPF_ALU64_##OPCODE##_BPF_X:		\
+		A = A OP X;			\
+		CONT;				\
+	BPF_ALU_##OPCODE##_BPF_X:		\
+		A = (u32) A OP (u32) X;		\
+		CONT;				\
+	BPF_ALU64_##OPCODE##_BPF_K:		\
+		A = A OP K;			\
+		CONT;				\
+	BPF_ALU_##OPCODE##_BPF_K:		\
+		A = (u32) A OP (u32) K;		\
+		CONT;
+
+	ALU(BPF_ADD,  +)
+	ALU(BPF_SUB,  -)
+	ALU(BPF_AND,  &)
+	ALU(BPF_OR,   |)
+	ALU(BPF_LSH, <<)
+	ALU(BPF_RSH, >>)
+	ALU(BPF_XOR,  ^)
+	ALU(BPF_MUL,  *)
+#undef ALU
+BPF_ALU_BPF_NEG_0:
+	A = (u32) -A;
+	CONT;
+BPF_ALU64_BPF_NEG_0:
+	A = -A;
+	CONT;
+BPF_ALU_BPF_MOV_BPF_X:
+	A = (u32) X;
+	CONT;
+BPF_ALU_BPF_MOV_BPF_K:
+	A = (u32) K;
+	CONT;
+BPF_ALU64_BPF_MOV_BPF_X:
+	A = X;
+	CONT;
+BPF_ALU64_BPF_MOV_BPF_K:
+	A = K;
+	CONT;
+BPF_ALU64_BPF_ARSH_BPF_X:
+	A = (s64) A >> X;
+	CONT;
+BPF_ALU64_BPF_ARSH_BPF_K:
+	A = (s64) A >> K;
+	CONT;
+BPF_ALU64_BPF_MOD_BPF_X:
+	if (unlikely(X == 0))
+		return 0;
+	div64_u64_rem(A, X, &tmp);
+	A = tmp;
+	CONT;
+BPF_ALU_BPF_MOD_BPF_X:
+	if (unlikely((u32) X == 0))
+		return 0;
+	A = (u32) A % (u32) X;
+	CONT;
+BPF_ALU64_BPF_MOD_BPF_K:
+	div64_u64_rem(A, (u64) K, &tmp);
+	A = tmp;
+	CONT;
+BPF_ALU_BPF_MOD_BPF_K:
+	A = (u32) A % (u32) K;
+	CONT;
+BPF_ALU64_BPF_DIV_BPF_X:
+	if (unlikely(X == 0))
+		return 0;
+	A = div64_u64(A, X);
+	CONT;
+BPF_ALU_BPF_DIV_BPF_X:
+	if (unlikely((u32) X == 0))
+		return 0;
+	A = (u32) A / (u32) X;
+	CONT;
+BPF_ALU64_BPF_DIV_BPF_K:
+	A = div64_u64(A, (u64) K);
+	CONT;
+BPF_ALU_BPF_DIV_BPF_K:
+	A = (u32) A / (u32) K;
+	CONT;
+BPF_ALU_BPF_END_BPF_TO_BE:
+	switch (K) {
+	case 16:
+		A = (__force u16) cpu_to_be16(A);
+		break;
+	case 32:
+		A = (__force u32) cpu_to_be32(A);
+		break;
+	case 64:
+		A = (__force u64) cpu_to_be64(A);
+		break;
+	}
+	CONT;
+BPF_ALU_BPF_END_BPF_TO_LE:
+	switch (K) {
+	case 16:
+		A = (__force u16) cpu_to_le16(A);
+		break;
+	case 32:
+		A = (__force u32) cpu_to_le32(A);
+		break;
+	case 64:
+		A = (__force u64) cpu_to_le64(A);
+		break;
+	}
+	CONT;
+
+	/* CALL */
+BPF_JMP_BPF_CALL_0:
+	/*
+	 * The call clobbers R1-R5 for the JITs' sake, preserves R6-R9 and
+	 * returns in R0.
+	 */
+	R0 = (__bpf_call_base + insn->imm)(regs[1], regs[2], regs[3],
+					   regs[4], regs[5]);
+	CONT;
+
+	/* JMP */
+BPF_JMP_BPF_JA_0:
+	insn += insn->off;
+	CONT;
+#define JMP(OPCODE, COND_X, COND_K)		\
+	BPF_JMP_##OPCODE##_BPF_X:		\
+		if (COND_X) {			\
+			insn += insn->off;	\
+			CONT_JMP;		\
+		}				\
+		CONT;				\
+	BPF_JMP_##OPCODE##_BPF_K:		\
+		if (COND_K) {			\
+			insn += insn->off;	\
+			CONT_JMP;		\
+		}				\
+		CONT;
+
+	JMP(BPF_JEQ, A == X, A == K)
+	JMP(BPF_JNE, A != X, A != K)
+	JMP(BPF_JGT, A > X, A > K)
+	JMP(BPF_JGE, A >= X, A >= K)
+	JMP(BPF_JSGT, (s64) A > (s64) X, (s64) A > (s64) K)
+	JMP(BPF_JSGE, (s64) A >= (s64) X, (s64) A >= (s64) K)
+	JMP(BPF_JSET, A & X, A & K)
+#undef JMP
+BPF_JMP_BPF_EXIT_0:
+	return R0;
+
+	/* STX, ST and LDX */
+#define LDST(SIZEOP, SIZE)					\
+	BPF_STX_BPF_MEM_##SIZEOP:				\
+		*(SIZE *)(unsigned long) (A + insn->off) = X;	\
+		CONT;						\
+	BPF_ST_BPF_MEM_##SIZEOP:				\
+		*(SIZE *)(unsigned long) (A + insn->off) = K;	\
+		CONT;						\
+	BPF_LDX_BPF_MEM_##SIZEOP:				\
+		A = *(SIZE *)(unsigned long) (X + insn->off);	\
+		CONT;
+
+	LDST(BPF_B,   u8)
+	LDST(BPF_H,  u16)
+	LDST(BPF_W,  u32)
+	LDST(BPF_DW, u64)
+#undef LDST
+BPF_STX_BPF_XADD_BPF_W:
+	atomic_add((u32) X, (atomic_t *)(unsigned long) (A + insn->off));
+	CONT;
+BPF_STX_BPF_XADD_BPF_DW:
+	atomic64_add((u64) X, (atomic64_t *)(unsigned long) (A + insn->off));
+	CONT;
+
+	/*
+	 * Packet loads, only found in programs whose context is an skb.
+	 * As with calls, the result is in R0 and a failed load ends the
+	 * program with 0, like in the classic interpreter.
+	 */
+BPF_LD_BPF_ABS_BPF_W:
+	off = K;
+load_word:
+	ptr = load_pointer((struct sk_buff *)ctx, off, 4, &tmp);
+	if (likely(ptr != NULL)) {
+		R0 = get_unaligned_be32(ptr);
+		CONT;
+	}
+	return 0;
+BPF_LD_BPF_ABS_BPF_H:
+	off = K;
+load_half:
+	ptr = load_pointer((struct sk_buff *)ctx, off, 2, &tmp);
+	if (likely(ptr != NULL)) {
+		R0 = get_unaligned_be16(ptr);
+		CONT;
+	}
+	return 0;
+BPF_LD_BPF_ABS_BPF_B:
+	off = K;
+load_byte:
+	ptr = load_pointer((struct sk_buff *)ctx, off, 1, &tmp);
+	if (likely(ptr != NULL)) {
+		R0 = *(u8 *)ptr;
+		CONT;
+	}
+	return 0;
+BPF_LD_BPF_IND_BPF_W:
+	off = K + X;
+	goto load_word;
+BPF_LD_BPF_IND_BPF_H:
+	off = K + X;
+	goto load_half;
+BPF_LD_BPF_IND_BPF_B:
+	off = K + X;
+	goto load_byte;
+
+default_label:
+	/* sk_convert_filter() never emits anything else */
+	WARN_RATELIMIT(1, "unknown opcode %02x\n", insn->code);
+	return 0;
+
+#undef CONT_JMP
+#undef CONT
+#undef R0
+#undef X
+#undef A
+#undef K
+}
+EXPORT_SYMBOL_GPL(sk_run_filter_int);
+
+/* Socket filters run in bpf_func, which is handed the classic program */
+static unsigned int sk_run_filter_int_skb(const struct sk_buff *skb,
+					  const struct sock_filter *insns)
+{
+	const struct sk_filter *fp = container_of(insns, struct sk_filter,
+						  insns[0]);
+
+	return sk_run_filter_int((void *)skb, fp->insnsi);
+}
+
+/**
+ *	sk_convert_filter - translate a checked classic program
+ *	@prog: program in the BPF_S_* codes left by sk_chk_filter()
+ *	@len: number of instructions in @prog
+ *	@new_prog: buffer for the internal program, or NULL
+ *	@new_len: length of the internal program
+ *
+ * Called with @new_prog NULL, only computes @new_len, the size of the
+ * buffer to pass in the second call, which does the translation.
+ *
+ * A lives in R0, X in R7, the scratch memory in the stack below R10, and
+ * the skb, or whatever context the program is run with, in R6.
+ * Ancillary loads become plain loads from the skb or calls.  Returns
+ * -EINVAL for instructions that cannot be translated, in which case the
+ * caller keeps running the classic program.
+ */
+int sk_convert_filter(struct sock_filter *prog, int len,
+		      struct sock_filter_int *new_prog, int *new_len)
+{
+	int new_flen = 0, pass = 0, target, i;
+	struct sock_filter_int *new_insn;
+	struct sock_filter *fp;
+	int *addrs = NULL;
+	u8 bpf_op, bpf_src, src_reg;
+
+	BUILD_BUG_ON(BPF_MEMWORDS * sizeof(u32) > MAX_BPF_STACK);
+	BUILD_BUG_ON(BPF_REG_10 + 1 != MAX_BPF_REG);
+	BUILD_BUG_ON(FIELD_SIZEOF(struct sk_buff, len) != 4);
+	BUILD_BUG_ON(FIELD_SIZEOF(struct sk_buff, protocol) != 2);
+	BUILD_BUG_ON(FIELD_SIZEOF(struct sk_buff, mark) != 4);
+	BUILD_BUG_ON(FIELD_SIZEOF(struct sk_buff, queue_mapping) != 2);
+	BUILD_BUG_ON(FIELD_SIZEOF(struct sk_buff, rxhash) != 4);
+	BUILD_BUG_ON(FIELD_SIZEOF(struct sk_buff, vlan_tci) != 2);
+	BUILD_BUG_ON(FIELD_SIZEOF(struct net_device, ifindex) != 4);
+	BUILD_BUG_ON(FIELD_SIZEOF(struct net_device, type) != 2);
+	BUILD_BUG_ON(VLAN_TAG_PRESENT != 0x1000);
+
+	if (len <= 0 || len > BPF_MAXINSNS)
+		return -EINVAL;
+
+	if (new_prog) {
+		addrs = kcalloc(len, sizeof(*addrs), GFP_KERNEL);
+		if (!addrs)
+			return -ENOMEM;
+	}
+
+do_pass:
+	new_insn = new_prog;
+	fp = prog;
+
+	/* ctx to R6, and A and X start out as 0 */
+	if (new_insn) {
+		new_insn[0] = (struct sock_filter_int) {
+			.code = BPF_ALU64 | BPF_MOV | BPF_X,
+			.a_reg = BPF_REG_6, .x_reg = BPF_REG_1,
+		};
+		new_insn[1] = (struct sock_filter_int) {
+			.code = BPF_ALU | BPF_MOV | BPF_K, .a_reg = BPF_REG_0,
+		};
+		new_insn[2] = (struct sock_filter_int) {
+			.code = BPF_ALU | BPF_MOV | BPF_K, .a_reg = BPF_REG_7,
+		};
+	}
+	new_insn += 3;
+
+	for (i = 0; i < len; fp++, i++) {
+		struct sock_filter_int tmp_insns[8] = { };
+		struct sock_filter_int *insn = tmp_insns;
+
+		if (addrs)
+			addrs[i] = new_insn - new_prog;
+
+#define EMIT(CODE, DST, SRC, OFF, IMM)				\
+	(*insn++ = (struct sock_filter_int) {			\
+		.code = (CODE), .a_reg = (DST), .x_reg = (SRC),	\
+		.off = (OFF), .imm = (IMM) })
+/* pc relative offset of the internal target of classic insn @target */
+#define EMIT_JMP(CODE, DST, SRC, IMM)					\
+	do {								\
+		int off = 0;						\
+									\
+		if (target >= len || target < 0)			\
+			goto err;					\
+		if (addrs)						\
+			off = addrs[target] - addrs[i] -		\
+			      (insn - tmp_insns) - 1;			\
+		EMIT(CODE, DST, SRC, off, IMM);				\
+	} while (0)
+#define EMIT_CALL(FN)							\
+	do {								\
+		EMIT(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_1, BPF_REG_6, 0, 0); \
+		EMIT(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_2, BPF_REG_0, 0, 0); \
+		EMIT(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_3, BPF_REG_7, 0, 0); \
+		EMIT(BPF_JMP | BPF_CALL, 0, 0, 0, BPF_CALL_IMM(FN));	\
+	} while (0)
+/* off from the frame pointer of scratch memory word @k */
+#define MEM_OFF(k)	(-(BPF_MEMWORDS - (int)(k)) * 4)
+#define SKB_OFF(field)	offsetof(struct sk_buff, field)
+
+		switch (fp->code) {
+		case BPF_S_ALU_ADD_X: bpf_op = BPF_ADD; goto alu_x;
+		case BPF_S_ALU_SUB_X: bpf_op = BPF_SUB; goto alu_x;
+		case BPF_S_ALU_MUL_X: bpf_op = BPF_MUL; goto alu_x;
+		case BPF_S_ALU_DIV_X: bpf_op = BPF_DIV; goto alu_x;
+		case BPF_S_ALU_MOD_X: bpf_op = BPF_MOD; goto alu_x;
+		case BPF_S_ALU_AND_X: bpf_op = BPF_AND; goto alu_x;
+		case BPF_S_ALU_OR_X: bpf_op = BPF_OR; goto alu_x;
 		case BPF_S_ALU_XOR_X:
-			A ^= X;
-			continue;
-		case BPF_S_ALU_XOR_K:
-			A ^= K;
-			continue;
-		case BPF_S_ALU_LSH_X:
-			A <<= X;
-			continue;
-		case BPF_S_ALU_LSH_K:
-			A <<= K;
-			continue;
-		case BPF_S_ALU_RSH_X:
-			A >>= X;
-			continue;
-		case BPF_S_ALU_RSH_K:
-			A >>= K;
-			continue;
+		case BPF_S_ANC_ALU_XOR_X: bpf_op = BPF_XOR; goto alu_x;
+		case BPF_S_ALU_LSH_X: bpf_op = BPF_LSH; goto alu_x;
+		case BPF_S_ALU_RSH_X: bpf_op = BPF_RSH;
+alu_x:
+			EMIT(BPF_ALU | bpf_op | BPF_X, BPF_REG_0, BPF_REG_7,
+			     0, 0);
+			break;
+		case BPF_S_ALU_ADD_K: bpf_op = BPF_ADD; goto alu_k;
+		case BPF_S_ALU_SUB_K: bpf_op = BPF_SUB; goto alu_k;
+		case BPF_S_ALU_MUL_K: bpf_op = BPF_MUL; goto alu_k;
+		case BPF_S_ALU_DIV_K: bpf_op = BPF_DIV; goto alu_k;
+		case BPF_S_ALU_MOD_K: bpf_op = BPF_MOD; goto alu_k;
+		case BPF_S_ALU_AND_K: bpf_op = BPF_AND; goto alu_k;
+		case BPF_S_ALU_OR_K: bpf_op = BPF_OR; goto alu_k;
+		case BPF_S_ALU_XOR_K: bpf_op = BPF_XOR; goto alu_k;
+		case BPF_S_ALU_LSH_K: bpf_op = BPF_LSH; goto alu_k;
+		case BPF_S_ALU_RSH_K: bpf_op = BPF_RSH;
+alu_k:
+			EMIT(BPF_ALU | bpf_op | BPF_K, BPF_REG_0, 0, 0, fp->k);
+			break;
 		case BPF_S_ALU_NEG:
-			A = -A;
-			continue;
-		case BPF_S_JMP_JA:
-			fentry += K;
-			continue;
-		case BPF_S_JMP_JGT_K:
-			fentry += (A > K) ? fentry->jt : fentry->jf;
-			continue;
-		case BPF_S_JMP_JGE_K:
-			fentry += (A >= K) ? fentry->jt : fentry->jf;
-			continue;
-		case BPF_S_JMP_JEQ_K:
-			fentry += (A == K) ? fentry->jt : fentry->jf;
-			continue;
-		case BPF_S_JMP_JSET_K:
-			fentry += (A & K) ? fentry->jt : fentry->jf;
-			continue;
-		case BPF_S_JMP_JGT_X:
-			fentry += (A > X) ? fentry->jt : fentry->jf;
-			continue;
-		case BPF_S_JMP_JGE_X:
-			fentry += (A >= X) ? fentry->jt : fentry->jf;
-			continue;
-		case BPF_S_JMP_JEQ_X:
-			fentry += (A == X) ? fentry->jt : fentry->jf;
-			continue;
-		case BPF_S_JMP_JSET_X:
-			fentry += (A & X) ? fentry->jt : fentry->jf;
-			continue;
+			EMIT(BPF_ALU | BPF_NEG, BPF_REG_0, 0, 0, 0);
+			break;
+
 		case BPF_S_LD_W_ABS:
-			k = K;
-load_w:
-			ptr = load_pointer(skb, k, 4, &tmp);
-			if (ptr != NULL) {
-				A = get_unaligned_be32(ptr);
-				continue;
-			}
-			return 0;
+			EMIT(BPF_LD | BPF_ABS | BPF_W, 0, 0, 0, fp->k);
+			break;
 		case BPF_S_LD_H_ABS:
-			k = K;
-load_h:
-			ptr = load_pointer(skb, k, 2, &tmp);
-			if (ptr != NULL) {
-				A = get_unaligned_be16(ptr);
-				continue;
-			}
-			return 0;
+			EMIT(BPF_LD | BPF_ABS | BPF_H, 0, 0, 0, fp->k);
+			break;
 		case BPF_S_LD_B_ABS:
-			k = K;
-load_b:
-			ptr = load_pointer(skb, k, 1, &tmp);
-			if (ptr != NULL) {
-				A = *(u8 *)ptr;
-				continue;
-			}
-			return 0;
-		case BPF_S_LD_W_LEN:
-			A = skb->len;
-			continue;
-		case BPF_S_LDX_W_LEN:
-			X = skb->len;
-			continue;
+			EMIT(BPF_LD | BPF_ABS | BPF_B, 0, 0, 0, fp->k);
+			break;
 		case BPF_S_LD_W_IND:
-			k = X + K;
-			goto load_w;
+			EMIT(BPF_LD | BPF_IND | BPF_W, 0, BPF_REG_7, 0, fp->k);
+			break;
 		case BPF_S_LD_H_IND:
-			k = X + K;
-			goto load_h;
+			EMIT(BPF_LD | BPF_IND | BPF_H, 0, BPF_REG_7, 0, fp->k);
+			break;
 		case BPF_S_LD_B_IND:
-			k = X + K;
-			goto load_b;
-		case BPF_S_LDX_B_MSH:
-			ptr = load_pointer(skb, K, 1, &tmp);
-			if (ptr != NULL) {
-				X = (*(u8 *)ptr & 0xf) << 2;
-				continue;
-			}
-			return 0;
+			EMIT(BPF_LD | BPF_IND | BPF_B, 0, BPF_REG_7, 0, fp->k);
+			break;
+		case BPF_S_LD_W_LEN:
+			EMIT(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_0, BPF_REG_6,
+			     SKB_OFF(len), 0);
+			break;
+		case BPF_S_LDX_W_LEN:
+			EMIT(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_7, BPF_REG_6,
+			     SKB_OFF(len), 0);
+			break;
 		case BPF_S_LD_IMM:
-			A = K;
-			continue;
+			EMIT(BPF_ALU | BPF_MOV | BPF_K, BPF_REG_0, 0, 0, fp->k);
+			break;
 		case BPF_S_LDX_IMM:
-			X = K;
-			continue;
-		case BPF_S_LD_MEM:
-			A = mem[K];
-			continue;
-		case BPF_S_LDX_MEM:
-			X = mem[K];
-			continue;
+			EMIT(BPF_ALU | BPF_MOV | BPF_K, BPF_REG_7, 0, 0, fp->k);
+			break;
+		case BPF_S_LDX_B_MSH:
+			/* X = (P[k:1] & 0xf) << 2, through R0, saving A */
+			EMIT(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_8, BPF_REG_0,
+			     0, 0);
+			EMIT(BPF_LD | BPF_ABS | BPF_B, 0, 0, 0, fp->k);
+			EMIT(BPF_ALU | BPF_AND | BPF_K, BPF_REG_0, 0, 0, 0xf);
+			EMIT(BPF_ALU | BPF_LSH | BPF_K, BPF_REG_0, 0, 0, 2);
+			EMIT(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_7, BPF_REG_0,
+			     0, 0);
+			EMIT(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_0, BPF_REG_8,
+			     0, 0);
+			break;
 		case BPF_S_MISC_TAX:
-			X = A;
-			continue;
+			EMIT(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_7, BPF_REG_0,
+			     0, 0);
+			break;
 		case BPF_S_MISC_TXA:
-			A = X;
-			continue;
-		case BPF_S_RET_K:
-			return K;
-		case BPF_S_RET_A:
-			return A;
+			EMIT(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_0, BPF_REG_7,
+			     0, 0);
+			break;
+
+		case BPF_S_LD_MEM:
+			EMIT(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_0, BPF_REG_10,
+			     MEM_OFF(fp->k), 0);
+			break;
+		case BPF_S_LDX_MEM:
+			EMIT(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_7, BPF_REG_10,
+			     MEM_OFF(fp->k), 0);
+			break;
 		case BPF_S_ST:
-			mem[K] = A;
-			continue;
+			EMIT(BPF_STX | BPF_MEM | BPF_W, BPF_REG_10, BPF_REG_0,
+			     MEM_OFF(fp->k), 0);
+			break;
 		case BPF_S_STX:
-			mem[K] = X;
-			continue;
+			EMIT(BPF_STX | BPF_MEM | BPF_W, BPF_REG_10, BPF_REG_7,
+			     MEM_OFF(fp->k), 0);
+			break;
+
+		case BPF_S_RET_K:
+			EMIT(BPF_ALU | BPF_MOV | BPF_K, BPF_REG_0, 0, 0, fp->k);
+			EMIT(BPF_JMP | BPF_EXIT, 0, 0, 0, 0);
+			break;
+		case BPF_S_RET_A:
+			EMIT(BPF_JMP | BPF_EXIT, 0, 0, 0, 0);
+			break;
+
+		case BPF_S_JMP_JA:
+			target = i + fp->k + 1;
+			EMIT_JMP(BPF_JMP | BPF_JA, 0, 0, 0);
+			break;
+		case BPF_S_JMP_JEQ_K: bpf_op = BPF_JEQ; goto jmp_k;
+		case BPF_S_JMP_JGE_K: bpf_op = BPF_JGE; goto jmp_k;
+		case BPF_S_JMP_JGT_K: bpf_op = BPF_JGT; goto jmp_k;
+		case BPF_S_JMP_JSET_K: bpf_op = BPF_JSET;
+jmp_k:
+			bpf_src = BPF_K;
+			src_reg = 0;
+			/*
+			 * Immediates are sign extended to 64 bits, A is not:
+			 * compare against a zero extended copy in R8.
+			 */
+			if ((int)fp->k < 0) {
+				EMIT(BPF_ALU | BPF_MOV | BPF_K, BPF_REG_8, 0, 0,
+				     fp->k);
+				bpf_src = BPF_X;
+				src_reg = BPF_REG_8;
+			}
+			goto jmp;
+		case BPF_S_JMP_JEQ_X: bpf_op = BPF_JEQ; goto jmp_x;
+		case BPF_S_JMP_JGE_X: bpf_op = BPF_JGE; goto jmp_x;
+		case BPF_S_JMP_JGT_X: bpf_op = BPF_JGT; goto jmp_x;
+		case BPF_S_JMP_JSET_X: bpf_op = BPF_JSET;
+jmp_x:
+			bpf_src = BPF_X;
+			src_reg = BPF_REG_7;
+jmp:
+			/* the common case: jump if true, else fall through */
+			if (fp->jf == 0) {
+				target = i + fp->jt + 1;
+				EMIT_JMP(BPF_JMP | bpf_op | bpf_src, BPF_REG_0,
+					 src_reg, fp->k);
+				break;
+			}
+			/* jump if false, else fall through */
+			if (fp->jt == 0 && bpf_op == BPF_JEQ) {
+				target = i + fp->jf + 1;
+				EMIT_JMP(BPF_JMP | BPF_JNE | bpf_src, BPF_REG_0,
+					 src_reg, fp->k);
+				break;
+			}
+			/* otherwise a conditional and an unconditional jump */
+			target = i + fp->jt + 1;
+			EMIT_JMP(BPF_JMP | bpf_op | bpf_src, BPF_REG_0, src_reg,
+				 fp->k);
+			target = i + fp->jf + 1;
+			EMIT_JMP(BPF_JMP | BPF_JA, 0, 0, 0);
+			break;
+
 		case BPF_S_ANC_PROTOCOL:
-			A = ntohs(skb->protocol);
-			continue;
-		case BPF_S_ANC_PKTTYPE:
-			A = skb->pkt_type;
-			continue;
-		case BPF_S_ANC_IFINDEX:
-			if (!skb->dev)
-				return 0;
-			A = skb->dev->ifindex;
-			continue;
+			/* A = ntohs(skb->protocol) */
+			EMIT(BPF_LDX | BPF_MEM | BPF_H, BPF_REG_0, BPF_REG_6,
+			     SKB_OFF(protocol), 0);
+			EMIT(BPF_ALU | BPF_END | BPF_FROM_BE, BPF_REG_0, 0, 0, 16);
+			break;
 		case BPF_S_ANC_MARK:
-			A = skb->mark;
-			continue;
-		case BPF_S_ANC_QUEUE:
-			A = skb->queue_mapping;
-			continue;
-		case BPF_S_ANC_HATYPE:
-			if (!skb->dev)
-				return 0;
-			A = skb->dev->type;
-			continue;
+			EMIT(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_0, BPF_REG_6,
+			     SKB_OFF(mark), 0);
+			break;
 		case BPF_S_ANC_RXHASH:
-			A = skb->rxhash;
-			continue;
-		case BPF_S_ANC_CPU:
-			A = raw_smp_processor_id();
-			continue;
+			EMIT(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_0, BPF_REG_6,
+			     SKB_OFF(rxhash), 0);
+			break;
+		case BPF_S_ANC_QUEUE:
+			EMIT(BPF_LDX | BPF_MEM | BPF_H, BPF_REG_0, BPF_REG_6,
+			     SKB_OFF(queue_mapping), 0);
+			break;
 		case BPF_S_ANC_VLAN_TAG:
-			A = vlan_tx_tag_get(skb);
-			continue;
+			EMIT(BPF_LDX | BPF_MEM | BPF_H, BPF_REG_0, BPF_REG_6,
+			     SKB_OFF(vlan_tci), 0);
+			EMIT(BPF_ALU | BPF_AND | BPF_K, BPF_REG_0, 0, 0,
+			     ~VLAN_TAG_PRESENT);
+			break;
 		case BPF_S_ANC_VLAN_TAG_PRESENT:
-			A = !!vlan_tx_tag_present(skb);
-			continue;
-		case BPF_S_ANC_PAY_OFFSET:
-			A = __skb_get_poff(skb);
-			continue;
-		case BPF_S_ANC_NLATTR: {
-			struct nlattr *nla;
-
-			if (skb_is_nonlinear(skb))
-				return 0;
-			if (A > skb->len - sizeof(struct nlattr))
-				return 0;
-
-			nla = nla_find((struct nlattr *)&skb->data[A],
-				       skb->len - A, X);
-			if (nla)
-				A = (void *)nla - (void *)skb->data;
+			EMIT(BPF_LDX | BPF_MEM | BPF_H, BPF_REG_0, BPF_REG_6,
+			     SKB_OFF(vlan_tci), 0);
+			EMIT(BPF_ALU | BPF_RSH | BPF_K, BPF_REG_0, 0, 0, 12);
+			EMIT(BPF_ALU | BPF_AND | BPF_K, BPF_REG_0, 0, 0, 1);
+			break;
+		case BPF_S_ANC_IFINDEX:
+		case BPF_S_ANC_HATYPE:
+			/* no device ends the program with 0 */
+			EMIT(BPF_LDX | BPF_MEM |
+			     (sizeof(void *) == 8 ? BPF_DW : BPF_W),
+			     BPF_REG_8, BPF_REG_6, SKB_OFF(dev), 0);
+			EMIT(BPF_JMP | BPF_JNE | BPF_K, BPF_REG_8, 0, 2, 0);
+			EMIT(BPF_ALU | BPF_MOV | BPF_K, BPF_REG_0, 0, 0, 0);
+			EMIT(BPF_JMP | BPF_EXIT, 0, 0, 0, 0);
+			if (fp->code == BPF_S_ANC_IFINDEX)
+				EMIT(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_0,
+				     BPF_REG_8,
+				     offsetof(struct net_device, ifindex), 0);
 			else
-				A = 0;
-			continue;
-		}
-		case BPF_S_ANC_NLATTR_NEST: {
-			struct nlattr *nla;
-
-			if (skb_is_nonlinear(skb))
-				return 0;
-			if (A > skb->len - sizeof(struct nlattr))
-				return 0;
-
-			nla = (struct nlattr *)&skb->data[A];
-			if (nla->nla_len > A - skb->len)
-				return 0;
-
-			nla = nla_find_nested(nla, X);
-			if (nla)
-				A = (void *)nla - (void *)skb->data;
+				EMIT(BPF_LDX | BPF_MEM | BPF_H, BPF_REG_0,
+				     BPF_REG_8,
+				     offsetof(struct net_device, type), 0);
+			break;
+		case BPF_S_ANC_PKTTYPE:
+			/* a bitfield, so not a plain load */
+			EMIT_CALL(__skb_get_pkt_type);
+			break;
+		case BPF_S_ANC_PAY_OFFSET:
+			EMIT_CALL(__skb_get_pay_offset);
+			break;
+		case BPF_S_ANC_CPU:
+			EMIT_CALL(__get_raw_cpu_id);
+			break;
+		case BPF_S_ANC_NLATTR:
+		case BPF_S_ANC_NLATTR_NEST:
+			if (fp->code == BPF_S_ANC_NLATTR)
+				EMIT_CALL(__skb_get_nlattr);
 			else
-				A = 0;
-			continue;
-		}
+				EMIT_CALL(__skb_get_nlattr_nest);
+			/* BPF_ANC_ABORT ends the program with 0 */
+			EMIT(BPF_JMP | BPF_JNE | BPF_K, BPF_REG_0, 0, 2,
+			     (s32)BPF_ANC_ABORT);
+			EMIT(BPF_ALU | BPF_MOV | BPF_K, BPF_REG_0, 0, 0, 0);
+			EMIT(BPF_JMP | BPF_EXIT, 0, 0, 0, 0);
+			break;
 #ifdef CONFIG_SECCOMP_FILTER
 		case BPF_S_ANC_SECCOMP_LD_W:
-			A = seccomp_bpf_load(fentry->k);
-			continue;
+			EMIT(BPF_ALU | BPF_MOV | BPF_K, BPF_REG_1, 0, 0, fp->k);
+			EMIT(BPF_JMP | BPF_CALL, 0, 0, 0,
+			     BPF_CALL_IMM(__seccomp_load));
+			break;
 #endif
 		default:
-			WARN_RATELIMIT(1, "Unknown code:%u jt:%u tf:%u k:%u\n",
-				       fentry->code, fentry->jt,
-				       fentry->jf, fentry->k);
-			return 0;
+			goto err;
 		}
+
+		if (new_prog)
+			memcpy(new_insn, tmp_insns,
+			       sizeof(*insn) * (insn - tmp_insns));
+		new_insn += insn - tmp_insns;
+	}
+
+#undef SKB_OFF
+#undef MEM_OFF
+#undef EMIT_CALL
+#undef EMIT_JMP
+#undef EMIT
+
+	if (!new_prog) {
+		/* only computing the length */
+		*new_len = new_insn - new_prog;
+		return 0;
 	}
 
+	/* the first pass filled addrs[], the second one uses it */
+	pass++;
+	if (new_flen != new_insn - new_prog) {
+		new_flen = new_insn - new_prog;
+		if (pass > 2)
+			goto err;
+		goto do_pass;
+	}
+
+	kfree(addrs);
+	BUG_ON(*new_len != new_flen);
 	return 0;
+err:
+	kfree(addrs);
+	return -EINVAL;
 }
-EXPORT_SYMBOL(sk_run_filter);
+EXPORT_SYMBOL_GPL(sk_convert_filter);
+
+/**
+ *	sk_convert_filter_alloc - translate a checked classic program
+ *	@prog: program in the BPF_S_* codes left by sk_chk_filter()
+ *	@len: number of instructions in @prog
+ *
+ * Returns the internal program, to be freed with kfree(), or NULL if
+ * @prog cannot be translated or there is no memory for it.
+ */
+struct sock_filter_int *sk_convert_filter_alloc(struct sock_filter *prog,
+						int len)
+{
+	struct sock_filter_int *insnsi;
+	int new_len;
+
+	if (sk_convert_filter(prog, len, NULL, &new_len))
+		return NULL;
+
+	insnsi = kmalloc(new_len * sizeof(*insnsi), GFP_KERNEL | __GFP_NOWARN);
+	if (!insnsi)
+		return NULL;
+
+	if (sk_convert_filter(prog, len, insnsi, &new_len)) {
+		kfree(insnsi);
+		return NULL;
+	}
+	return insnsi;
+}
+EXPORT_SYMBOL_GPL(sk_convert_filter_alloc);
 
 /*
  * Security :
@@ -637,6 +1548,11 @@ void sk_filter_release_rcu(struct rcu_head *rcu)
 {
 	struct sk_filter *fp = container_of(rcu, struct sk_filter, rcu);
 
+	if (fp->insnsi) {
+		kfree(fp->insnsi);
+		/* the JITs take anything else for an image of theirs */
+		fp->bpf_func = sk_run_filter;
+	}
 	bpf_jit_free(fp);
 }
 EXPORT_SYMBOL(sk_filter_release_rcu);
@@ -646,12 +1562,20 @@ static int __sk_prepare_filter(struct sk_filter *fp)
 	int err;
 
 	fp->bpf_func = sk_run_filter;
+	fp->insnsi = NULL;
 
 	err = sk_chk_filter(fp->insns, fp->len);
 	if (err)
 		return err;
 
 	bpf_jit_compile(fp);
+
+	/* Without a JIT image, run the internal translation if possible */
+	if (fp->bpf_func == sk_run_filter) {
+		fp->insnsi = sk_convert_filter_alloc(fp->insns, fp->len);
+		if (fp->insnsi)
+			fp->bpf_func = sk_run_filter_int_skb;
+	}
 	return 0;
 }
 
@@ -753,6 +1677,66 @@ int sk_attach_filter(struct sock_fprog *fprog, struct sock *sk)
 }
 EXPORT_SYMBOL_GPL(sk_attach_filter);
 
+/**
+ *	sk_reuseport_attach_filter - attach a reuseport selection filter
+ *	@fprog: the filter program
+ *	@sk: the socket to use
+ *
+ * Attach the user's filter code to the SO_REUSEPORT group @sk belongs
+ * to. The filter's return value is used as the index of the socket in
+ * the group that receives the packet; out of range values fall back to
+ * the flow hash. If @sk is not hashed yet, a group is created for it and
+ * later merged into the group of the sockets it is bound alongside.
+ */
+int sk_reuseport_attach_filter(struct sock_fprog *fprog, struct sock *sk)
+{
+	struct sk_filter *fp, *old_fp;
+	unsigned int fsize = sizeof(struct sock_filter) * fprog->len;
+	unsigned int sk_fsize = sk_filter_size(fprog->len);
+	int err;
+
+	if (sock_flag(sk, SOCK_FILTER_LOCKED))
+		return -EPERM;
+
+	/* Make sure new filter is there and in the right amounts. */
+	if (fprog->filter == NULL)
+		return -EINVAL;
+
+	if (sk_fsize > sysctl_optmem_max)
+		return -ENOMEM;
+
+	if (sk_unhashed(sk) && sk->sk_reuseport) {
+		err = reuseport_alloc(sk);
+		if (err)
+			return err;
+	} else if (!rcu_access_pointer(sk->sk_reuseport_cb)) {
+		/* The socket wasn't bound with SO_REUSEPORT */
+		return -EINVAL;
+	}
+
+	fp = kmalloc(sk_fsize, GFP_KERNEL);
+	if (!fp)
+		return -ENOMEM;
+	if (copy_from_user(fp->insns, fprog->filter, fsize)) {
+		kfree(fp);
+		return -EFAULT;
+	}
+
+	atomic_set(&fp->refcnt, 1);
+	fp->len = fprog->len;
+
+	err = __sk_prepare_filter(fp);
+	if (err) {
+		kfree(fp);
+		return err;
+	}
+
+	old_fp = reuseport_attach_prog(sk, fp);
+	if (old_fp)
+		sk_filter_release(old_fp);
+	return 0;
+}
+
 int sk_detach_filter(struct sock *sk)
 {
 	int ret = -ENOENT;
@@ -601,6 +601,62 @@ void __kfree_skb(struct sk_buff *skb)
 }
 EXPORT_SYMBOL(__kfree_skb);
 
+#define SKB_FREE_CACHE_SIZE	64
+
+/* sk_buff shells waiting to be returned to skbuff_head_cache in bulk */
+struct skb_free_cache {
+	size_t	skb_count;
+	void	*skb_cache[SKB_FREE_CACHE_SIZE];
+};
+
+static DEFINE_PER_CPU(struct skb_free_cache, skb_free_cache);
+
+/**
+ *	__kfree_skb_defer - free an sk_buff from softirq context
+ *	@skb: buffer
+ *
+ *	Like __kfree_skb(), but the sk_buff shell itself is only queued on
+ *	a per cpu array and handed back to the slab allocator in bulk,
+ *	once the array is full or at the next __kfree_skb_flush().  Must
+ *	be called with bottom halves disabled, and followed by
+ *	__kfree_skb_flush() before leaving softirq context.
+ */
+void __kfree_skb_defer(struct sk_buff *skb)
+{
+	struct skb_free_cache *fc;
+
+	/* fast clones live in skbuff_fclone_cache */
+	if (skb->fclone != SKB_FCLONE_UNAVAILABLE) {
+		__kfree_skb(skb);
+		return;
+	}
+
+	/* drop skb->head and call any destructors for packet */
+	skb_release_all(skb);
+
+	fc = &__get_cpu_var(skb_free_cache);
+	fc->skb_cache[fc->skb_count++] = skb;
+	if (unlikely(fc->skb_count == SKB_FREE_CACHE_SIZE)) {
+		kmem_cache_free_bulk(skbuff_head_cache, SKB_FREE_CACHE_SIZE,
+				     fc->skb_cache);
+		fc->skb_count = 0;
+	}
+}
+
+/**
+ *	__kfree_skb_flush - free the sk_buffs queued by __kfree_skb_defer()
+ */
+void __kfree_skb_flush(void)
+{
+	struct skb_free_cache *fc = &__get_cpu_var(skb_free_cache);
+
+	if (fc->skb_count) {
+		kmem_cache_free_bulk(skbuff_head_cache, fc->skb_count,
+				     fc->skb_cache);
+		fc->skb_count = 0;
+	}
+}
+
 /**
  *	kfree_skb - free an sk_buff
  *	@skb: buffer to free
@@ -1785,15 +1841,44 @@ static bool __skb_splice_bits(struct sk_buff *skb, struct pipe_inode_info *pipe,
 	return false;
 }
 
+ssize_t skb_socket_splice(struct sock *sk,
+			  struct pipe_inode_info *pipe,
+			  struct splice_pipe_desc *spd)
+{
+	int ret;
+
+	/* Drop the socket lock, otherwise we have reverse
+	 * locking dependencies between sk_lock and i_mutex
+	 * here as compared to sendfile(). We enter here
+	 * with the socket lock held, and splice_to_pipe() will
+	 * grab the pipe inode lock. For sendfile() emulation,
+	 * we call into ->sendpage() with the i_mutex lock held
+	 * and networking will grab the socket lock.
+	 */
+	release_sock(sk);
+	ret = splice_to_pipe(pipe, spd);
+	lock_sock(sk);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(skb_socket_splice);
+
 /*
  * Map data from the skb to a pipe. Should handle both the linear part,
  * the fragments, and the frag list. It does NOT handle frag lists within
  * the frag list, if such a thing exists. We'd probably need to recurse to
  * handle that cleanly.
+ *
+ * @sk is the socket the data is read from; @splice_cb is called to move
+ * the collected pages into the pipe and is responsible for whatever
+ * locking the protocol needs around splice_to_pipe().
  */
-int skb_splice_bits(struct sk_buff *skb, unsigned int offset,
+int skb_splice_bits(struct sk_buff *skb, struct sock *sk, unsigned int offset,
 		    struct pipe_inode_info *pipe, unsigned int tlen,
-		    unsigned int flags)
+		    unsigned int flags,
+		    ssize_t (*splice_cb)(struct sock *,
+					 struct pipe_inode_info *,
+					 struct splice_pipe_desc *))
 {
 	struct partial_page partial[MAX_SKB_FRAGS];
 	struct page *pages[MAX_SKB_FRAGS];
@@ -1806,7 +1891,6 @@ int skb_splice_bits(struct sk_buff *skb, unsigned int offset,
 		.spd_release = sock_spd_release,
 	};
 	struct sk_buff *frag_iter;
-	struct sock *sk = skb->sk;
 	int ret = 0;
 
 	/*
@@ -1829,20 +1913,8 @@ int skb_splice_bits(struct sk_buff *skb, unsigned int offset,
 	}
 
 done:
-	if (spd.nr_pages) {
-		/*
-		 * Drop the socket lock, otherwise we have reverse
-		 * locking dependencies between sk_lock and i_mutex
-		 * here as compared to sendfile(). We enter here
-		 * with the socket lock held, and splice_to_pipe() will
-		 * grab the pipe inode lock. For sendfile() emulation,
-		 * we call into ->sendpage() with the i_mutex lock held
-		 * and networking will grab the socket lock.
-		 */
-		release_sock(sk);
-		ret = splice_to_pipe(pipe, &spd);
-		lock_sock(sk);
-	}
+	if (spd.nr_pages)
+		ret = splice_cb(sk, pipe, &spd);
 
 	return ret;
 }
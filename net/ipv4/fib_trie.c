@@ -72,6 +72,8 @@
 #include <linux/list.h>
 #include <linux/slab.h>
 #include <linux/export.h>
+#include <linux/hash.h>
+#include <linux/percpu.h>
 #include <net/net_namespace.h>
 #include <net/ip.h>
 #include <net/protocol.h>
@@ -150,11 +152,51 @@ struct trie_stat {
 	unsigned int nodesizes[MAX_STAT_DEPTH];
 };
 
+#ifdef CONFIG_IP_FIB_TRIE_CACHE
+/*
+ * Per-CPU, direct mapped cache of recent lookup results, including
+ * misses. Entries are tagged with the routing generation of the
+ * namespace (rt_genid_ipv4()), which is bumped by rt_cache_flush() on
+ * every table change and nexthop state change, so a stale entry is
+ * simply never matched again. fib_info and fa_head pointers of a
+ * matching entry are safe under rcu_read_lock(): they are only freed
+ * after an RCU grace period, and only after the generation was bumped.
+ */
+#define TRIE_CACHE_BITS	7
+#define TRIE_CACHE_SIZE	(1 << TRIE_CACHE_BITS)
+
+struct trie_cache_entry {
+	t_key key;
+	int genid;
+	int oif;
+	u8 tos;
+	u8 scope;
+	u8 valid;
+	int ret;
+	unsigned char prefixlen;
+	unsigned char nh_sel;
+	unsigned char type;
+	unsigned char res_scope;
+	struct fib_info *fi;
+	struct list_head *fa_head;
+};
+
+struct trie_cache {
+	struct trie_cache_entry entries[TRIE_CACHE_SIZE];
+	unsigned long hits;
+	unsigned long misses;
+};
+#endif
+
 struct trie {
 	struct rt_trie_node __rcu *trie;
 #ifdef CONFIG_IP_FIB_TRIE_STATS
 	struct trie_use_stats stats;
 #endif
+#ifdef CONFIG_IP_FIB_TRIE_CACHE
+	struct net *net;
+	struct trie_cache __percpu *cache;
+#endif
 };
 
 static void tnode_put_child_reorg(struct tnode *tn, int i, struct rt_trie_node *n,
@@ -1394,6 +1436,95 @@ static int check_leaf(struct fib_table *tb, struct trie *t, struct leaf *l,
 	return 1;
 }
 
+#ifdef CONFIG_IP_FIB_TRIE_CACHE
+static inline struct trie_cache_entry *
+trie_cache_slot(struct trie_cache *tc, t_key key, const struct flowi4 *flp)
+{
+	u32 hash = key ^ flp->flowi4_oif ^ (flp->flowi4_tos << 24);
+
+	return &tc->entries[hash_32(hash, TRIE_CACHE_BITS)];
+}
+
+/*
+ * The cache serves the receive and forwarding path. It is only used with
+ * bottom halves disabled, which excludes every other user of this CPU's
+ * copy, so no further locking is needed. Process context bypasses it.
+ */
+static inline struct trie_cache *trie_cache_this_cpu(struct trie *t)
+{
+	if (!t->cache || !in_softirq() || in_irq())
+		return NULL;
+	return this_cpu_ptr(t->cache);
+}
+
+/* should be called with rcu_read_lock */
+static bool trie_cache_get(struct fib_table *tb, t_key key,
+			   const struct flowi4 *flp, struct fib_result *res,
+			   int fib_flags, int genid, int *ret)
+{
+	struct trie *t = (struct trie *) tb->tb_data;
+	struct trie_cache_entry *e;
+	struct trie_cache *tc;
+
+	tc = trie_cache_this_cpu(t);
+	if (!tc)
+		return false;
+
+	e = trie_cache_slot(tc, key, flp);
+	if (e->valid && e->genid == genid && e->key == key &&
+	    e->oif == flp->flowi4_oif && e->tos == flp->flowi4_tos &&
+	    e->scope == flp->flowi4_scope) {
+		*ret = e->ret;
+		if (!e->ret) {
+			res->prefixlen = e->prefixlen;
+			res->nh_sel = e->nh_sel;
+			res->type = e->type;
+			res->scope = e->res_scope;
+			res->fi = e->fi;
+			res->table = tb;
+			res->fa_head = e->fa_head;
+			if (!(fib_flags & FIB_LOOKUP_NOREF))
+				atomic_inc(&e->fi->fib_clntref);
+		}
+		tc->hits++;
+		return true;
+	}
+
+	tc->misses++;
+	return false;
+}
+
+static void trie_cache_put(struct fib_table *tb, t_key key,
+			   const struct flowi4 *flp,
+			   const struct fib_result *res, int genid, int ret)
+{
+	struct trie *t = (struct trie *) tb->tb_data;
+	struct trie_cache *tc;
+	struct trie_cache_entry *e;
+
+	tc = trie_cache_this_cpu(t);
+	if (!tc)
+		return;
+
+	e = trie_cache_slot(tc, key, flp);
+	e->key = key;
+	e->genid = genid;
+	e->oif = flp->flowi4_oif;
+	e->tos = flp->flowi4_tos;
+	e->scope = flp->flowi4_scope;
+	e->ret = ret;
+	if (!ret) {
+		e->prefixlen = res->prefixlen;
+		e->nh_sel = res->nh_sel;
+		e->type = res->type;
+		e->res_scope = res->scope;
+		e->fi = res->fi;
+		e->fa_head = res->fa_head;
+	}
+	e->valid = 1;
+}
+#endif
+
 int fib_table_lookup(struct fib_table *tb, const struct flowi4 *flp,
 		     struct fib_result *res, int fib_flags)
 {
@@ -1408,9 +1539,20 @@ int fib_table_lookup(struct fib_table *tb, const struct flowi4 *flp,
 	unsigned int current_prefix_length = KEYLENGTH;
 	struct tnode *cn;
 	t_key pref_mismatch;
+#ifdef CONFIG_IP_FIB_TRIE_CACHE
+	int genid;
+#endif
 
 	rcu_read_lock();
 
+#ifdef CONFIG_IP_FIB_TRIE_CACHE
+	genid = rt_genid_ipv4(t->net);
+	/* pairs with smp_wmb() in rt_cache_flush() */
+	smp_rmb();
+	if (trie_cache_get(tb, key, flp, res, fib_flags, genid, &ret))
+		goto cached;
+#endif
+
 	n = rcu_dereference(t->trie);
 	if (!n)
 		goto failed;
@@ -1583,6 +1725,10 @@ backtrace:
 failed:
 	ret = 1;
 found:
+#ifdef CONFIG_IP_FIB_TRIE_CACHE
+	trie_cache_put(tb, key, flp, res, genid, ret);
+cached:
+#endif
 	rcu_read_unlock();
 	return ret;
 }
@@ -1829,6 +1975,11 @@ int fib_table_flush(struct fib_table *tb)
 
 void fib_free_table(struct fib_table *tb)
 {
+#ifdef CONFIG_IP_FIB_TRIE_CACHE
+	struct trie *t = (struct trie *) tb->tb_data;
+
+	free_percpu(t->cache);
+#endif
 	kfree(tb);
 }
 
@@ -1957,7 +2108,7 @@ void __init fib_trie_init(void)
 }
 
 
-struct fib_table *fib_trie_table(u32 id)
+struct fib_table *fib_trie_table(struct net *net, u32 id)
 {
 	struct fib_table *tb;
 	struct trie *t;
@@ -1974,6 +2125,12 @@ struct fib_table *fib_trie_table(u32 id)
 	t = (struct trie *) tb->tb_data;
 	memset(t, 0, sizeof(*t));
 
+#ifdef CONFIG_IP_FIB_TRIE_CACHE
+	/* The table still works without its cache, just slower. */
+	t->net = net;
+	t->cache = alloc_percpu(struct trie_cache);
+#endif
+
 	return tb;
 }
 
@@ -2153,6 +2310,29 @@ static void trie_show_usage(struct seq_file *seq,
 }
 #endif /*  CONFIG_IP_FIB_TRIE_STATS */
 
+#ifdef CONFIG_IP_FIB_TRIE_CACHE
+static void trie_show_cache(struct seq_file *seq, const struct trie *t)
+{
+	unsigned long hits = 0, misses = 0;
+	int cpu;
+
+	if (!t->cache)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		const struct trie_cache *tc = per_cpu_ptr(t->cache, cpu);
+
+		hits += tc->hits;
+		misses += tc->misses;
+	}
+
+	seq_printf(seq, "\tCache hits:     %lu\n", hits);
+	seq_printf(seq, "\tCache misses:   %lu\n", misses);
+	seq_printf(seq, "\tCache hit rate: %lu%%\n",
+		   hits + misses ? hits * 100 / (hits + misses) : 0);
+}
+#endif
+
 static void fib_table_print(struct seq_file *seq, struct fib_table *tb)
 {
 	if (tb->tb_id == RT_TABLE_LOCAL)
@@ -2189,6 +2369,9 @@ static int fib_triestat_seq_show(struct seq_file *seq, void *v)
 
 			trie_collect_stats(t, &stat);
 			trie_show_stats(seq, &stat);
+#ifdef CONFIG_IP_FIB_TRIE_CACHE
+			trie_show_cache(seq, t);
+#endif
 #ifdef CONFIG_IP_FIB_TRIE_STATS
 			trie_show_usage(seq, &t->stats);
 #endif
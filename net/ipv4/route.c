@@ -438,6 +438,10 @@ static inline bool rt_is_expired(const struct rtable *rth)
 
 void rt_cache_flush(struct net *net)
 {
+	/* Order the table or nexthop update before the new generation, the
+	 * fib_trie lookup cache checks the generation before walking the trie.
+	 */
+	smp_wmb();
 	rt_genid_bump_ipv4(net);
 }
 
@@ -8,6 +8,9 @@
  *	2 of the License, or (at your option) any later version.
  *
  *	UDPv4 GSO support
+ *
+ *	Address family independent UDP GRO for encapsulation protocols
+ *	registered with udp_add_offload().
  */
 
 #include <linux/skbuff.h>
@@ -148,7 +151,14 @@ unlock:
 }
 EXPORT_SYMBOL(udp_del_offload);
 
-static struct sk_buff **udp_gro_receive(struct sk_buff **head, struct sk_buff *skb)
+/*
+ * Aggregate packets of an encapsulation protocol registered for the
+ * destination port: outer UDP ports must match, the protocol's own
+ * gro_receive then keys on its header and hands the inner packet to the
+ * inner protocol's GRO. Shared by the IPv4 and IPv6 UDP offloads; the
+ * outer IP headers have already been compared by the caller.
+ */
+struct sk_buff **udp_gro_receive(struct sk_buff **head, struct sk_buff *skb)
 {
 	struct udp_offload_priv *uo_priv;
 	struct sk_buff *p, **pp = NULL;
@@ -205,7 +215,9 @@ out:
 	return pp;
 }
 
-static int udp_gro_complete(struct sk_buff *skb, int nhoff)
+EXPORT_SYMBOL(udp_gro_receive);
+
+int udp_gro_complete(struct sk_buff *skb, int nhoff)
 {
 	struct udp_offload_priv *uo_priv;
 	__be16 newlen = htons(skb->len - nhoff);
@@ -229,13 +241,27 @@ static int udp_gro_complete(struct sk_buff *skb, int nhoff)
 	rcu_read_unlock();
 	return err;
 }
+EXPORT_SYMBOL(udp_gro_complete);
+
+static int udp4_gro_complete(struct sk_buff *skb, int nhoff)
+{
+	const struct iphdr *iph = ip_hdr(skb);
+	struct udphdr *uh = (struct udphdr *)(skb->data + nhoff);
+
+	/* The merged packet carries the pseudo header sum of its new length */
+	if (uh->check)
+		uh->check = ~csum_tcpudp_magic(iph->saddr, iph->daddr,
+					       skb->len - nhoff, IPPROTO_UDP, 0);
+
+	return udp_gro_complete(skb, nhoff);
+}
 
 static const struct net_offload udpv4_offload = {
 	.callbacks = {
 		.gso_send_check = udp4_ufo_send_check,
 		.gso_segment = udp4_ufo_fragment,
 		.gro_receive  =	udp_gro_receive,
-		.gro_complete =	udp_gro_complete,
+		.gro_complete =	udp4_gro_complete,
 	},
 };
 
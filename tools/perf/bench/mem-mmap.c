@@ -0,0 +1,143 @@
+/*
+ * mem-mmap.c
+ *
+ * mmap: Benchmark for concurrent mmap()/munmap() in one address space
+ *
+ * Every thread repeatedly maps an anonymous region, touches its first
+ * page and unmaps it again. mmap() and munmap() take mmap_sem for
+ * writing and the page fault takes it for reading, so with several
+ * threads this mostly measures mmap_sem write contention.
+ */
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+
+struct thread_data {
+	pthread_t		pthread;
+	unsigned long		ops;
+};
+
+static int		nr_threads;
+static int		loops		= 100000;
+static const char	*length_str	= "64KB";
+
+static const struct option options[] = {
+	OPT_INTEGER('t', "threads",	&nr_threads,
+		    "Specify number of threads (default: number of CPUs)"),
+	OPT_INTEGER('l', "loop",	&loops,
+		    "Specify number of mmap/munmap loops per thread"),
+	OPT_STRING('s', "size",		&length_str, "64KB",
+		    "Specify the size of each mapping (e.g. 4KB, 1MB)"),
+	OPT_END()
+};
+
+static const char * const bench_mem_mmap_usage[] = {
+	"perf bench mem mmap <options>",
+	NULL
+};
+
+static size_t		length;
+static pthread_barrier_t barrier;
+
+static void *worker_thread(void *__tdata)
+{
+	struct thread_data *td = __tdata;
+	int i;
+
+	pthread_barrier_wait(&barrier);
+
+	for (i = 0; i < loops; i++) {
+		char *p = mmap(NULL, length, PROT_READ | PROT_WRITE,
+			       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+		BUG_ON(p == MAP_FAILED);
+		p[0] = 1;
+		BUG_ON(munmap(p, length));
+		td->ops++;
+	}
+
+	return NULL;
+}
+
+int bench_mem_mmap(int argc, const char **argv,
+		   const char *prefix __maybe_unused)
+{
+	struct thread_data *threads;
+	struct timeval start, stop, diff;
+	unsigned long long result_usec, ops = 0;
+	double ops_per_sec;
+	int t, ret;
+
+	argc = parse_options(argc, argv, options, bench_mem_mmap_usage, 0);
+
+	length = (size_t)perf_atoll((char *)length_str);
+	if ((s64)length <= 0) {
+		fprintf(stderr, "Invalid length:%s\n", length_str);
+		return 1;
+	}
+
+	if (nr_threads <= 0)
+		nr_threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+	threads = zalloc(sizeof(*threads) * nr_threads);
+	BUG_ON(!threads);
+	BUG_ON(pthread_barrier_init(&barrier, NULL, nr_threads + 1));
+
+	for (t = 0; t < nr_threads; t++) {
+		ret = pthread_create(&threads[t].pthread, NULL,
+				     worker_thread, &threads[t]);
+		BUG_ON(ret);
+	}
+
+	gettimeofday(&start, NULL);
+	pthread_barrier_wait(&barrier);
+
+	for (t = 0; t < nr_threads; t++) {
+		ret = pthread_join(threads[t].pthread, NULL);
+		BUG_ON(ret);
+		ops += threads[t].ops;
+	}
+
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+
+	result_usec = diff.tv_sec * 1000000ULL + diff.tv_usec;
+	ops_per_sec = (double)ops / ((double)result_usec / 1000000.0);
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %d threads doing %d mmap/munmap loops of %s each\n\n",
+		       nr_threads, loops, length_str);
+
+		printf(" %14s: %lu.%03lu [sec]\n\n", "Total time",
+		       diff.tv_sec, (unsigned long)(diff.tv_usec / 1000));
+
+		printf(" %14lf usecs/op\n", (double)result_usec / (double)ops);
+		printf(" %14.0lf ops/sec\n", ops_per_sec);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%.0lf\n", ops_per_sec);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	pthread_barrier_destroy(&barrier);
+	free(threads);
+	return 0;
+}
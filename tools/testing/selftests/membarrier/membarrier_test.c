@@ -0,0 +1,71 @@
+/*
+ * Test the membarrier() system call: the query command must report
+ * MEMBARRIER_CMD_SHARED, the shared command must succeed, and invalid
+ * commands or flags must be rejected with EINVAL.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <linux/membarrier.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifdef __NR_membarrier
+static int sys_membarrier(int cmd, int flags)
+{
+	return syscall(__NR_membarrier, cmd, flags);
+}
+
+static int expect_einval(int cmd, int flags, const char *what)
+{
+	if (sys_membarrier(cmd, flags) != -1 || errno != EINVAL) {
+		fprintf(stderr, "membarrier %s: expected EINVAL, got %s\n",
+			what, strerror(errno));
+		return 1;
+	}
+	return 0;
+}
+
+int main(void)
+{
+	int ret, err = 0;
+
+	ret = sys_membarrier(MEMBARRIER_CMD_QUERY, 0);
+	if (ret < 0) {
+		if (errno == ENOSYS) {
+			printf("membarrier not supported, skipping\n");
+			return 0;
+		}
+		perror("membarrier query");
+		return 1;
+	}
+	if (!(ret & MEMBARRIER_CMD_SHARED)) {
+		fprintf(stderr, "membarrier query: shared command missing\n");
+		err = 1;
+	}
+
+	if (sys_membarrier(MEMBARRIER_CMD_SHARED, 0) != 0) {
+		perror("membarrier shared");
+		err = 1;
+	}
+
+	err |= expect_einval(MEMBARRIER_CMD_QUERY, 1, "query with flags");
+	err |= expect_einval(MEMBARRIER_CMD_SHARED, 1, "shared with flags");
+	err |= expect_einval(1 << 30, 0, "unknown command");
+
+	fprintf(stderr, err ? "[FAIL]\n" : "[PASS]\n");
+	return err;
+}
+#else
+int main(void)
+{
+	printf("__NR_membarrier not defined, skipping\n");
+	return 0;
+}
+#endif
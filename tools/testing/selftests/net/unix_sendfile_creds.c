@@ -0,0 +1,130 @@
+/*
+ * Test that data queued on an AF_UNIX stream socket by sendfile(), which
+ * goes through ->sendpage(), carries the same SCM_CREDENTIALS as data
+ * queued by write(), so that the reader sees the sender's credentials
+ * and glues both into a single read.
+ *
+ * License (GPLv2):
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define CHUNK	"0123456789"
+#define CHUNK_LEN	(sizeof(CHUNK) - 1)
+
+static void error(const char *msg)
+{
+	perror(msg);
+	exit(1);
+}
+
+static void send_chunk(int sock, int file, int use_sendfile)
+{
+	off_t off = 0;
+	ssize_t ret;
+
+	if (use_sendfile)
+		ret = sendfile(sock, file, &off, CHUNK_LEN);
+	else
+		ret = write(sock, CHUNK, CHUNK_LEN);
+	if (ret != CHUNK_LEN)
+		error(use_sendfile ? "sendfile" : "write");
+}
+
+/* Read what is queued and check the credentials attached to it */
+static int recv_check(int sock, size_t expected)
+{
+	char buf[4 * CHUNK_LEN];
+	char control[CMSG_SPACE(sizeof(struct ucred))];
+	struct iovec iov = { .iov_base = buf, .iov_len = sizeof(buf) };
+	struct msghdr msg = {
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = control,
+		.msg_controllen = sizeof(control),
+	};
+	struct cmsghdr *cmsg;
+	struct ucred *cred;
+	ssize_t ret;
+
+	ret = recvmsg(sock, &msg, MSG_DONTWAIT);
+	if (ret < 0)
+		error("recvmsg");
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	if (!cmsg || cmsg->cmsg_level != SOL_SOCKET ||
+	    cmsg->cmsg_type != SCM_CREDENTIALS) {
+		fprintf(stderr, "no SCM_CREDENTIALS\n");
+		return 1;
+	}
+	cred = (struct ucred *)CMSG_DATA(cmsg);
+	if (cred->pid != getpid() || cred->uid != getuid() ||
+	    cred->gid != getgid()) {
+		fprintf(stderr, "credentials %d/%d/%d, expected %d/%d/%d\n",
+			cred->pid, cred->uid, cred->gid,
+			getpid(), getuid(), getgid());
+		return 1;
+	}
+	if ((size_t)ret != expected) {
+		fprintf(stderr, "read %zd bytes, expected %zu\n",
+			ret, expected);
+		return 1;
+	}
+	return 0;
+}
+
+static int test(int file, int first_sendfile)
+{
+	int one = 1;
+	int fds[2];
+	int err;
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds))
+		error("socketpair");
+	if (setsockopt(fds[1], SOL_SOCKET, SO_PASSCRED, &one, sizeof(one)))
+		error("setsockopt SO_PASSCRED");
+
+	send_chunk(fds[0], file, first_sendfile);
+	send_chunk(fds[0], file, !first_sendfile);
+	err = recv_check(fds[1], 2 * CHUNK_LEN);
+
+	close(fds[0]);
+	close(fds[1]);
+	return err;
+}
+
+int main(void)
+{
+	char path[] = "/tmp/unix_sendfile_creds.XXXXXX";
+	int file, err = 0;
+
+	file = mkstemp(path);
+	if (file < 0)
+		error("mkstemp");
+	unlink(path);
+	if (write(file, CHUNK, CHUNK_LEN) != CHUNK_LEN)
+		error("write file");
+
+	fprintf(stderr, "---- write, sendfile ----\n");
+	err |= test(file, 0);
+	fprintf(stderr, "---- sendfile, write ----\n");
+	err |= test(file, 1);
+
+	close(file);
+	fprintf(stderr, err ? "[FAIL]\n" : "[PASS]\n");
+	return err;
+}
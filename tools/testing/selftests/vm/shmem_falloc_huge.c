@@ -0,0 +1,257 @@
+/*
+ * Check that fallocate() on a huge=always tmpfs gets huge pages for the
+ * aligned extents its range covers, and only for those: ShmemHugePages in
+ * /proc/meminfo must grow by exactly the covered extents.
+ *
+ * Then check that the fallocated huge pages read back as zeroes through
+ * read(), splice(), private and misaligned shared mappings, and after a
+ * hole is punched in them: all but read() split the huge page.
+ *
+ * Must be run as root, to mount the tmpfs.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/mount.h>
+
+static unsigned long read_meminfo(const char *field)
+{
+	char name[64];
+	unsigned long val, ret = 0;
+	FILE *f;
+
+	f = fopen("/proc/meminfo", "r");
+	if (!f) {
+		perror("/proc/meminfo");
+		exit(1);
+	}
+	while (fscanf(f, "%63s %lu%*[^\n]", name, &val) == 2) {
+		if (!strcmp(name, field)) {
+			ret = val;
+			break;
+		}
+	}
+	fclose(f);
+	return ret;
+}
+
+/* fallocate [offset, offset + len) and check the huge pages it got */
+static int test_falloc(const char *dir, off_t offset, off_t len,
+		       unsigned long expected_kb)
+{
+	char path[256];
+	unsigned long before, after;
+	int fd, ret = 0;
+
+	snprintf(path, sizeof(path), "%s/file", dir);
+	fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (fd < 0) {
+		perror("open");
+		return 1;
+	}
+
+	before = read_meminfo("ShmemHugePages:");
+	if (fallocate(fd, 0, offset, len)) {
+		perror("fallocate");
+		ret = 1;
+		goto out;
+	}
+	after = read_meminfo("ShmemHugePages:");
+
+	printf("fallocate(%#lx, %#lx): ShmemHugePages %lu -> %lu kB, expected +%lu kB\n",
+	       (unsigned long)offset, (unsigned long)len, before, after,
+	       expected_kb);
+	if (after - before != expected_kb)
+		ret = 1;
+out:
+	close(fd);
+	unlink(path);
+	return ret;
+}
+
+enum access {
+	ACCESS_READ,
+	ACCESS_SPLICE,
+	ACCESS_MMAP_PRIVATE,
+	ACCESS_MMAP_MISALIGNED,
+	ACCESS_PUNCH_HOLE,
+};
+
+static const char * const access_names[] = {
+	[ACCESS_READ]		= "read",
+	[ACCESS_SPLICE]		= "splice",
+	[ACCESS_MMAP_PRIVATE]	= "private mmap",
+	[ACCESS_MMAP_MISALIGNED] = "misaligned mmap",
+	[ACCESS_PUNCH_HOLE]	= "punch hole",
+};
+
+static int check_zero(const char *buf, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		if (buf[i])
+			return 1;
+	return 0;
+}
+
+/* read len bytes at offset through a pipe, into buf */
+static int splice_read(int fd, off_t offset, char *buf, size_t len)
+{
+	loff_t off = offset;
+	size_t done = 0;
+	int pipefd[2];
+	ssize_t ret;
+
+	if (pipe(pipefd)) {
+		perror("pipe");
+		return 1;
+	}
+	while (done < len) {
+		ret = splice(fd, &off, pipefd[1], NULL, len - done, 0);
+		if (ret <= 0)
+			break;
+		if (read(pipefd[0], buf + done, ret) != ret)
+			break;
+		done += ret;
+	}
+	close(pipefd[0]);
+	close(pipefd[1]);
+	if (done != len) {
+		perror("splice");
+		return 1;
+	}
+	return 0;
+}
+
+/* fallocate two aligned extents, and check they read back as zeroes */
+static int test_access(const char *dir, off_t hpage, enum access access)
+{
+	size_t page = getpagesize();
+	size_t len = 2 * hpage;
+	char path[256];
+	char *buf, *map;
+	int fd, ret = 1;
+
+	buf = malloc(len);
+	if (!buf) {
+		perror("malloc");
+		return 1;
+	}
+	snprintf(path, sizeof(path), "%s/file", dir);
+	fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (fd < 0) {
+		perror("open");
+		goto out_free;
+	}
+	if (fallocate(fd, 0, 0, len)) {
+		perror("fallocate");
+		goto out;
+	}
+
+	switch (access) {
+	case ACCESS_READ:
+		if (pread(fd, buf, len, 0) != (ssize_t)len) {
+			perror("pread");
+			goto out;
+		}
+		ret = check_zero(buf, len);
+		break;
+	case ACCESS_SPLICE:
+		/* start inside the first extent, so it needs small pages */
+		if (splice_read(fd, page, buf, len - page))
+			goto out;
+		ret = check_zero(buf, len - page);
+		break;
+	case ACCESS_MMAP_PRIVATE:
+		map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+			   fd, 0);
+		if (map == MAP_FAILED) {
+			perror("mmap");
+			goto out;
+		}
+		ret = check_zero(map, len);
+		map[0] = 1;
+		munmap(map, len);
+		break;
+	case ACCESS_MMAP_MISALIGNED:
+		map = mmap(NULL, len - page, PROT_READ, MAP_SHARED, fd, page);
+		if (map == MAP_FAILED) {
+			perror("mmap");
+			goto out;
+		}
+		ret = check_zero(map, len - page);
+		munmap(map, len - page);
+		break;
+	case ACCESS_PUNCH_HOLE:
+		if (fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+			      page, page)) {
+			perror("fallocate punch hole");
+			goto out;
+		}
+		if (pread(fd, buf, len, 0) != (ssize_t)len) {
+			perror("pread");
+			goto out;
+		}
+		ret = check_zero(buf, len);
+		break;
+	}
+
+	printf("fallocate, then %s: %s\n", access_names[access],
+	       ret ? "not zeroes" : "zeroes");
+out:
+	close(fd);
+	unlink(path);
+out_free:
+	free(buf);
+	return ret;
+}
+
+int main(void)
+{
+	char dir[] = "/tmp/shmem_falloc_huge.XXXXXX";
+	unsigned long hpage_kb;
+	off_t hpage;
+	int ret = 0;
+
+	hpage_kb = read_meminfo("Hugepagesize:");
+	if (!hpage_kb) {
+		fprintf(stderr, "no Hugepagesize in /proc/meminfo\n");
+		return 1;
+	}
+	hpage = (off_t)hpage_kb << 10;
+
+	if (!mkdtemp(dir)) {
+		perror("mkdtemp");
+		return 1;
+	}
+	if (mount("tmpfs", dir, "tmpfs", 0, "huge=always")) {
+		perror("mount tmpfs huge=always");
+		rmdir(dir);
+		return 1;
+	}
+
+	/* two aligned extents */
+	ret |= test_falloc(dir, 0, 2 * hpage, 2 * hpage_kb);
+	/* misaligned: covers no whole extent */
+	ret |= test_falloc(dir, 4096, hpage, 0);
+	/* only the middle one of three partly covered extents is whole */
+	ret |= test_falloc(dir, hpage / 2, 2 * hpage, hpage_kb);
+
+	ret |= test_access(dir, hpage, ACCESS_READ);
+	ret |= test_access(dir, hpage, ACCESS_SPLICE);
+	ret |= test_access(dir, hpage, ACCESS_MMAP_PRIVATE);
+	ret |= test_access(dir, hpage, ACCESS_MMAP_MISALIGNED);
+	ret |= test_access(dir, hpage, ACCESS_PUNCH_HOLE);
+
+	umount(dir);
+	rmdir(dir);
+
+	printf(ret ? "[FAIL]\n" : "[PASS]\n");
+	return ret;
+}
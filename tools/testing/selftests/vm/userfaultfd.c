@@ -0,0 +1,283 @@
+/*
+ * Stress the userfaultfd: a set of threads touch every page of a
+ * registered anonymous area in random order, while a monitor thread
+ * reads the userfaults and resolves them with UFFDIO_COPY, filling each
+ * page with a pattern that depends on its index. The faulting threads
+ * must find the right pattern once their fault is resolved. A second
+ * pass checks UFFDIO_ZEROPAGE on read faults.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * Usage: ./userfaultfd <MiB>
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/userfaultfd.h>
+
+#ifdef __NR_userfaultfd
+
+#define NR_FAULTERS	4
+
+static unsigned long nr_pages, page_size;
+static char *area_dst, *area_src;
+static int uffd;
+static volatile int finished;
+
+static unsigned long pattern(unsigned long nr)
+{
+	return nr * 0x9e3779b97f4a7c15UL + 1;
+}
+
+static int copy_page(unsigned long offset)
+{
+	struct uffdio_copy uffdio_copy;
+	struct uffdio_range range;
+
+	uffdio_copy.dst = (unsigned long) area_dst + offset;
+	uffdio_copy.src = (unsigned long) area_src + offset;
+	uffdio_copy.len = page_size;
+	uffdio_copy.mode = 0;
+	uffdio_copy.copy = 0;
+	if (ioctl(uffd, UFFDIO_COPY, &uffdio_copy)) {
+		/* another thread may have resolved it already */
+		if (uffdio_copy.copy != -EEXIST) {
+			fprintf(stderr, "UFFDIO_COPY error %lld\n",
+				(long long) uffdio_copy.copy);
+			return 1;
+		}
+		/* harmless, the fault is retried on a wakeup */
+		range.start = uffdio_copy.dst;
+		range.len = page_size;
+		if (ioctl(uffd, UFFDIO_WAKE, &range)) {
+			perror("UFFDIO_WAKE");
+			return 1;
+		}
+	} else if (uffdio_copy.copy != page_size) {
+		fprintf(stderr, "UFFDIO_COPY unexpected copy %lld\n",
+			(long long) uffdio_copy.copy);
+		return 1;
+	}
+	return 0;
+}
+
+static int zero_page(unsigned long offset)
+{
+	struct uffdio_zeropage uffdio_zeropage;
+
+	uffdio_zeropage.range.start = (unsigned long) area_dst + offset;
+	uffdio_zeropage.range.len = page_size;
+	uffdio_zeropage.mode = 0;
+	if (ioctl(uffd, UFFDIO_ZEROPAGE, &uffdio_zeropage) &&
+	    uffdio_zeropage.zeropage != -EEXIST) {
+		fprintf(stderr, "UFFDIO_ZEROPAGE error %lld\n",
+			(long long) uffdio_zeropage.zeropage);
+		return 1;
+	}
+	return 0;
+}
+
+static void *monitor_thread(void *arg)
+{
+	int zeropage = (long) arg;
+	struct pollfd pollfd;
+	struct uffd_msg msg;
+	unsigned long offset;
+	long err = 0;
+
+	pollfd.fd = uffd;
+	pollfd.events = POLLIN;
+	while (!finished) {
+		if (poll(&pollfd, 1, 100) <= 0)
+			continue;
+		if (read(uffd, &msg, sizeof(msg)) != sizeof(msg)) {
+			if (errno == EAGAIN)
+				continue;
+			perror("userfaultfd read");
+			err = 1;
+			break;
+		}
+		if (msg.event != UFFD_EVENT_PAGEFAULT) {
+			fprintf(stderr, "unexpected event %u\n", msg.event);
+			err = 1;
+			break;
+		}
+		offset = (msg.arg.pagefault.address - (unsigned long) area_dst) &
+			~(page_size - 1);
+		if (offset >= nr_pages * page_size) {
+			fprintf(stderr, "fault out of range\n");
+			err = 1;
+			break;
+		}
+		if (zeropage)
+			err = zero_page(offset);
+		else
+			err = copy_page(offset);
+		if (err)
+			break;
+	}
+	return (void *) err;
+}
+
+static void *faulting_thread(void *arg)
+{
+	unsigned int seed = (unsigned long) arg;
+	unsigned long i, nr;
+	long err = 0;
+
+	for (i = 0; i < nr_pages; i++) {
+		nr = rand_r(&seed) % nr_pages;
+		if (*(unsigned long *)(area_dst + nr * page_size) !=
+		    pattern(nr)) {
+			fprintf(stderr, "page %lu has a wrong pattern\n", nr);
+			err = 1;
+			break;
+		}
+	}
+	return (void *) err;
+}
+
+static int register_area(void)
+{
+	struct uffdio_register uffdio_register;
+
+	uffdio_register.range.start = (unsigned long) area_dst;
+	uffdio_register.range.len = nr_pages * page_size;
+	uffdio_register.mode = UFFDIO_REGISTER_MODE_MISSING;
+	if (ioctl(uffd, UFFDIO_REGISTER, &uffdio_register)) {
+		perror("UFFDIO_REGISTER");
+		return 1;
+	}
+	if ((uffdio_register.ioctls & UFFD_API_RANGE_IOCTLS) !=
+	    UFFD_API_RANGE_IOCTLS) {
+		fprintf(stderr, "unexpected missing ioctl for range\n");
+		return 1;
+	}
+	return 0;
+}
+
+static int run_pass(int zeropage)
+{
+	pthread_t monitor, faulters[NR_FAULTERS];
+	void *ret;
+	unsigned long i;
+	long err = 0;
+
+	if (munmap(area_dst, nr_pages * page_size) ||
+	    mmap(area_dst, nr_pages * page_size, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) != area_dst) {
+		perror("remap dst area");
+		return 1;
+	}
+	if (register_area())
+		return 1;
+
+	finished = 0;
+	if (pthread_create(&monitor, NULL, monitor_thread,
+			   (void *)(long) zeropage))
+		return 1;
+
+	if (zeropage) {
+		/* every read fault must be resolved with a zero page */
+		for (i = 0; i < nr_pages; i++) {
+			if (*(volatile unsigned long *)(area_dst +
+							i * page_size)) {
+				fprintf(stderr, "page %lu not zero\n", i);
+				err = 1;
+				break;
+			}
+		}
+	} else {
+		for (i = 0; i < NR_FAULTERS; i++)
+			if (pthread_create(&faulters[i], NULL, faulting_thread,
+					   (void *) i))
+				return 1;
+		for (i = 0; i < NR_FAULTERS; i++) {
+			pthread_join(faulters[i], &ret);
+			err |= (long) ret;
+		}
+	}
+
+	finished = 1;
+	pthread_join(monitor, &ret);
+	err |= (long) ret;
+
+	printf("%s pass: %s\n", zeropage ? "zeropage" : "copy",
+	       err ? "FAIL" : "ok");
+	return err;
+}
+
+int main(int argc, char **argv)
+{
+	struct uffdio_api uffdio_api;
+	unsigned long i;
+	int err;
+
+	if (argc < 2) {
+		fprintf(stderr, "Usage: %s <MiB>\n", argv[0]);
+		return 1;
+	}
+
+	page_size = sysconf(_SC_PAGE_SIZE);
+	nr_pages = atol(argv[1]) * 1024 * 1024 / page_size;
+	if (!nr_pages)
+		nr_pages = 1;
+
+	uffd = syscall(__NR_userfaultfd, O_CLOEXEC | O_NONBLOCK);
+	if (uffd < 0) {
+		if (errno == ENOSYS) {
+			printf("userfaultfd not supported, skipping\n");
+			return 0;
+		}
+		perror("userfaultfd syscall");
+		return 1;
+	}
+	uffdio_api.api = UFFD_API;
+	uffdio_api.features = 0;
+	if (ioctl(uffd, UFFDIO_API, &uffdio_api)) {
+		perror("UFFDIO_API");
+		return 1;
+	}
+	if (uffdio_api.api != UFFD_API) {
+		fprintf(stderr, "UFFDIO_API error %llu\n",
+			(unsigned long long) uffdio_api.api);
+		return 1;
+	}
+
+	area_src = mmap(NULL, nr_pages * page_size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	area_dst = mmap(NULL, nr_pages * page_size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (area_src == MAP_FAILED || area_dst == MAP_FAILED) {
+		perror("mmap");
+		return 1;
+	}
+	for (i = 0; i < nr_pages; i++)
+		*(unsigned long *)(area_src + i * page_size) = pattern(i);
+
+	printf("nr_pages: %lu\n", nr_pages);
+	err = run_pass(0);
+	err |= run_pass(1);
+
+	fprintf(stderr, err ? "[FAIL]\n" : "[PASS]\n");
+	return err;
+}
+#else
+int main(void)
+{
+	printf("__NR_userfaultfd not defined, skipping\n");
+	return 0;
+}
+#endif
@@ -66,9 +66,13 @@ static void async_pf_execute(struct work_struct *work)
 	might_sleep();
 
 	use_mm(mm);
-	down_read(&mm->mmap_sem);
-	get_user_pages(current, mm, addr, 1, 1, 0, NULL, NULL);
-	up_read(&mm->mmap_sem);
+	/*
+	 * This work is run asynchronously to the task which owns mm and
+	 * might be done in another context, so we must use the unlocked
+	 * variant to let the fault drop mmap_sem and wait (e.g. for
+	 * userfaultfd) as long as it needs.
+	 */
+	get_user_pages_unlocked(current, mm, addr, 1, 1, 0, NULL);
 	unuse_mm(mm);
 
 	spin_lock(&vcpu->async_pf.lock);